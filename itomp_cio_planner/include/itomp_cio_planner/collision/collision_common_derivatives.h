@@ -9,15 +9,104 @@
 #define COLLISION_COMMON_DERIVATIVES_H_
 
 #include <moveit/collision_detection_fcl/collision_common.h>
+#include <algorithm>
+#include <vector>
 
 namespace itomp_cio_planner
 {
 
+// returns true if the contact should be ignored
+typedef bool (*ContactFilterFn)(const collision_detection::CollisionGeometryData* cd1,
+								const collision_detection::CollisionGeometryData* cd2,
+								const fcl::Contact& contact);
+
 struct CollisionDataDerivatives
 {
+	CollisionDataDerivatives()
+		: cd(NULL), accumulate_cost(false), depth_threshold(0.0), penetration_cost(0.0),
+		  contact_filter(NULL), fcl_result(NULL), contact_pairs(NULL)
+	{
+	}
+
 	collision_detection::CollisionData* cd;
+
+	// if accumulate_cost is set, contacts are not stored in the collision result.
+	// (depth - depth_threshold)^2 of the contacts deeper than depth_threshold is added to penetration_cost
+	bool accumulate_cost;
+	double depth_threshold;
+	double penetration_cost;
+	ContactFilterFn contact_filter;
+	// reused for the narrow phase queries in accumulate_cost mode
+	fcl::CollisionResult* fcl_result;
+	// object pairs with an accumulated contact, sorted. the contact map keeps one contact per object name pair,
+	// objects of several shapes add the cost of their first colliding shape pair only
+	std::vector<std::pair<const void*, const void*> >* contact_pairs;
+};
+
+// collision query objects of an evaluation manager, reused across the obstacle cost evaluations
+struct CollisionScratch
+{
+	CollisionScratch()
+	{
+		request.verbose = false;
+		request.contacts = false;
+		request.distance = false;
+	}
+
+	collision_detection::CollisionRequest request;
+	collision_detection::CollisionResult result;
+	fcl::CollisionResult fcl_result;
+	std::vector<std::pair<const void*, const void*> > contact_pairs;
 };
 
+// narrow phase of the collision callbacks in accumulate_cost mode
+inline bool accumulatePenetrationCost(fcl::CollisionObject *o1, fcl::CollisionObject *o2,
+									  const collision_detection::CollisionGeometryData *cd1,
+									  const collision_detection::CollisionGeometryData *cd2,
+									  const collision_detection::DecideContactFn& dcf,
+									  CollisionDataDerivatives *cdd)
+{
+	fcl::CollisionResult local_result;
+	fcl::CollisionResult& col_result = (cdd->fcl_result != NULL) ? *cdd->fcl_result : local_result;
+	col_result.clear();
+
+	// a single contact per pair, as the contact map stores at most max_contacts_per_pair (= 1) contacts
+	int num_contacts = fcl::collide(o1, o2, fcl::CollisionRequest(1, true), col_result);
+	for (int i = 0; i < num_contacts; ++i)
+	{
+		const fcl::Contact& contact = col_result.getContact(i);
+		if (dcf)
+		{
+			collision_detection::Contact c;
+			collision_detection::fcl2contact(contact, c);
+			if (dcf(c))
+				continue;
+		}
+
+		cdd->cd->res_->collision = true;
+		if (cdd->contact_pairs != NULL)
+		{
+			// the shapes of an object share the object pointer (link, attached body or world object) of the name
+			std::pair<const void*, const void*> contact_pair = (cd1->ptr.raw < cd2->ptr.raw) ?
+					std::make_pair(cd1->ptr.raw, cd2->ptr.raw) : std::make_pair(cd2->ptr.raw, cd1->ptr.raw);
+			std::vector<std::pair<const void*, const void*> >::iterator it =
+				std::lower_bound(cdd->contact_pairs->begin(), cdd->contact_pairs->end(), contact_pair);
+			if (it != cdd->contact_pairs->end() && *it == contact_pair)
+				continue;
+			cdd->contact_pairs->insert(it, contact_pair);
+		}
+
+		if (cdd->contact_filter != NULL && cdd->contact_filter(cd1, cd2, contact))
+			continue;
+		if (contact.penetration_depth > cdd->depth_threshold)
+		{
+			double depth = contact.penetration_depth - cdd->depth_threshold;
+			cdd->penetration_cost += depth * depth;
+		}
+	}
+	return false;
+}
+
 }
 
 
@@ -10,6 +10,7 @@
 
 #include <itomp_cio_planner/common.h>
 #include <moveit/collision_detection_fcl/collision_robot_fcl.h>
+#include <itomp_cio_planner/collision/collision_common_derivatives.h>
 
 namespace itomp_cio_planner
 {
@@ -25,6 +26,8 @@ public:
 
 	virtual void checkSelfCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const robot_state::RobotState &state) const;
 	virtual void checkSelfCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm) const;
+	// contacts are handled as specified in cdd (e.g. penetration cost accumulation)
+	void checkSelfCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm, CollisionDataDerivatives &cdd) const;
 	virtual double distanceSelf(const robot_state::RobotState &state) const;
 	virtual double distanceSelf(const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm) const;
 
@@ -45,7 +48,7 @@ public:
 	virtual double distanceOther(const robot_state::RobotState &state, const collision_detection::CollisionRobot &other_robot,
 								 const robot_state::RobotState &other_state, const collision_detection::AllowedCollisionMatrix &acm) const;
 protected:
-	void checkSelfCollisionDerivativesHelper(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm) const;
+	void checkSelfCollisionDerivativesHelper(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm, CollisionDataDerivatives &cdd) const;
 	double distanceSelfDerivativesHelper(const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm) const;
 
 	static bool collisionCallback(fcl::CollisionObject *o1, fcl::CollisionObject *o2, void *data);
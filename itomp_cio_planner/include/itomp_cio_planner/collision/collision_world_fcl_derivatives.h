@@ -10,6 +10,7 @@
 
 #include <itomp_cio_planner/common.h>
 #include <moveit/collision_detection_fcl/collision_world_fcl.h>
+#include <itomp_cio_planner/collision/collision_common_derivatives.h>
 
 namespace itomp_cio_planner
 {
@@ -22,6 +23,8 @@ public:
 
 	virtual void checkRobotCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state) const;
 	virtual void checkRobotCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm) const;
+	// contacts are handled as specified in cdd (e.g. penetration cost accumulation)
+	void checkRobotCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm, CollisionDataDerivatives &cdd) const;
 	virtual double distanceRobot(const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state) const;
 	virtual double distanceRobot(const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix &acm) const;
 
@@ -33,7 +36,7 @@ public:
 	virtual double distanceWorld(const collision_detection::CollisionWorld &world, const collision_detection::AllowedCollisionMatrix &acm) const;
 
 protected:
-	void checkRobotCollisionDerivativesHelper(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm) const;
+	void checkRobotCollisionDerivativesHelper(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res, const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm, CollisionDataDerivatives &cdd) const;
 	double distanceRobotDerivativesHelper(const collision_detection::CollisionRobot &robot, const robot_state::RobotState &state, const collision_detection::AllowedCollisionMatrix *acm) const;
 
 	static bool collisionCallback(fcl::CollisionObject *o1, fcl::CollisionObject *o2, void *data);
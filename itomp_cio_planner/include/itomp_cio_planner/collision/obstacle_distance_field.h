@@ -0,0 +1,62 @@
+#ifndef OBSTACLE_DISTANCE_FIELD_H_
+#define OBSTACLE_DISTANCE_FIELD_H_
+
+#include <itomp_cio_planner/common.h>
+#include <moveit/distance_field/propagation_distance_field.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_state/robot_state.h>
+
+namespace itomp_cio_planner
+{
+
+// signed distance field of the static world geometry of a planning scene.
+// the robot links are approximated by sets of spheres, so the obstacle cost and its gradient
+// are computed by distance field lookups at the sphere centers
+class ObstacleDistanceField
+{
+public:
+    struct CollisionSphere
+    {
+        const robot_model::LinkModel* link_model_;
+        Eigen::Vector3d center_; // in the link frame
+        double radius_;
+    };
+
+    ObstacleDistanceField(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                          const robot_model::RobotModelConstPtr& robot_model,
+                          double resolution, double margin);
+    virtual ~ObstacleDistanceField();
+
+    // sum of the squared penetrations of the spheres into the margin around the obstacles.
+    // in_collision is set if a sphere touches an obstacle (signed distance <= 0), which is not implied by a cost > 0.
+    // the link transforms of robot_state should be up to date
+    double getCost(const robot_state::RobotState& robot_state, bool* in_collision = NULL) const;
+
+    // d(getCost) / d(position of the robot state variable)
+    double getCostDerivative(const robot_state::RobotState& robot_state, int variable_index) const;
+
+    const std::vector<CollisionSphere>& getCollisionSpheres() const;
+
+protected:
+    void createCollisionSpheres(const robot_model::RobotModelConstPtr& robot_model);
+    void createDistanceField(const planning_scene::PlanningSceneConstPtr& planning_scene, double resolution);
+
+    double getSphereCost(const Eigen::Vector3d& position, double radius, Eigen::Vector3d* gradient,
+                         bool* in_collision = NULL) const;
+
+    boost::shared_ptr<distance_field::PropagationDistanceField> distance_field_;
+    std::vector<CollisionSphere> collision_spheres_;
+    double margin_;
+};
+ITOMP_DEFINE_SHARED_POINTERS(ObstacleDistanceField)
+
+///////////////////////// inline functions follow //////////////////////
+
+inline const std::vector<ObstacleDistanceField::CollisionSphere>& ObstacleDistanceField::getCollisionSpheres() const
+{
+    return collision_spheres_;
+}
+
+}
+
+#endif /* OBSTACLE_DISTANCE_FIELD_H_ */
@@ -27,6 +27,17 @@ public:
     double d_;
 };
 
+// node of the bounding volume hierarchy over the contact surface triangles
+class TriangleBVHNode
+{
+public:
+    Eigen::Vector3d min_;
+    Eigen::Vector3d max_;
+    int children_[2]; // -1 for leaf nodes
+    int begin_; // range of bvh_triangle_indices_ for leaf nodes
+    int end_;
+};
+
 class GroundManager: public Singleton<GroundManager>
 {
 public:
@@ -46,6 +57,8 @@ public:
 
 private:
 	void initializeContactSurfaces();
+    void buildBVH();
+    int buildBVHNode(int begin, int end);
 
     bool getNearestMeshPosition(const Eigen::Vector3d& position_in,
                                 Eigen::Vector3d& position_out, const Eigen::Vector3d& normal_in,
@@ -55,6 +68,9 @@ private:
 	planning_scene::PlanningSceneConstPtr planning_scene_;
 	std::vector<Triangle> triangles_;
     std::vector<Plane> planes_;
+
+    std::vector<TriangleBVHNode> bvh_nodes_;
+    std::vector<int> bvh_triangle_indices_;
 };
 
 }
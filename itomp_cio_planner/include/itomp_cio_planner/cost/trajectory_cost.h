@@ -4,6 +4,7 @@
 #include <itomp_cio_planner/common.h>
 #include <itomp_cio_planner/optimization/new_eval_manager.h>
 #include <itomp_cio_planner/cost/trajectory_cost_helper.h>
+#include <itomp_cio_planner/rom/ROM.h>
 
 namespace itomp_cio_planner
 {
@@ -25,11 +26,25 @@ public:
 		return false;
 	}
 
+    // analytic derivative interface
+    // derivative[COMPONENT_TYPE_NUM] receives the partial derivatives of the (unweighted) cost at the point
+    // w.r.t. the position/velocity/acceleration of the trajectory element given by index
+    virtual bool hasAnalyticDerivative() const
+    {
+        return false;
+    }
+    virtual void computeDerivative(const NewEvalManager* evaluation_manager, int point,
+                                   const ItompTrajectoryIndex& index, double* derivative) const {}
+
 	int getIndex() const;
 	const std::string& getName() const;
 	double getWeight() const;
 
 protected:
+    // name lookups for the binding step in initialize(). unknown names are reported
+    int bindJointIndex(const NewEvalManager* evaluation_manager, const std::string& joint_name) const;
+    const robot_model::JointModelGroup* bindJointModelGroup(const NewEvalManager* evaluation_manager, const std::string& group_name) const;
+
 	int index_;
 	std::string name_;
 	double weight_;
@@ -52,7 +67,7 @@ inline double TrajectoryCost::getWeight() const
 	return weight_;
 }
 
-ITOMP_TRAJECTORY_COST_DECL(Smoothness)
+ITOMP_TRAJECTORY_COST_DECL_WITH_ANALYTIC_DERIVATIVE(Smoothness)
 //ITOMP_TRAJECTORY_COST_DECL(Obstacle)
 ITOMP_TRAJECTORY_COST_DECL(Validity)
 ITOMP_TRAJECTORY_COST_DECL(ContactInvariant)
@@ -62,8 +77,20 @@ ITOMP_TRAJECTORY_COST_DECL(COM)
 ITOMP_TRAJECTORY_COST_DECL(EndeffectorVelocity)
 ITOMP_TRAJECTORY_COST_DECL(Torque)
 ITOMP_TRAJECTORY_COST_DECL(RVO)
-ITOMP_TRAJECTORY_COST_DECL(FTR)
-ITOMP_TRAJECTORY_COST_DECL(ROM)
+ITOMP_TRAJECTORY_COST_DECL_BEGIN(FTR)
+    std::vector<const robot_model::JointModelGroup*> endeffector_chain_groups_;
+ITOMP_TRAJECTORY_COST_DECL_END
+ITOMP_TRAJECTORY_COST_DECL_WITH_PRE_POST_EVALUATION_BEGIN(ROM)
+    std::vector<rom::ROM> roms_;
+    // rbdl joint indices of the (z, y, x) rotation joints for each rom
+    std::vector<int> rom_joint_indices_;
+    // costs of the dirty points computed in preEvaluate, valid for batch_evaluation_manager_ only
+    Eigen::VectorXd batch_costs_;
+    std::vector<int> batch_points_;
+    Eigen::MatrixXd batch_angles_;
+    Eigen::VectorXd batch_residuals_;
+    const NewEvalManager* batch_evaluation_manager_;
+ITOMP_TRAJECTORY_COST_DECL_END
 ITOMP_TRAJECTORY_COST_DECL(CartesianTrajectory)
 ITOMP_TRAJECTORY_COST_DECL(Singularity)
 ITOMP_TRAJECTORY_COST_DECL(FrictionCone)
@@ -83,6 +110,14 @@ public:
 	virtual bool evaluate(const NewEvalManager* evaluation_manager,
 						  int point, double& cost) const;
     virtual bool isInvariant(const NewEvalManager* evaluation_manager, const ItompTrajectoryIndex& index) const;
+
+    // analytic derivatives are available with the distance field backend only
+    virtual bool hasAnalyticDerivative() const;
+    virtual void computeDerivative(const NewEvalManager* evaluation_manager, int point,
+                                   const ItompTrajectoryIndex& index, double* derivative) const;
+
+protected:
+    bool evaluateDistanceField(const NewEvalManager* evaluation_manager, int point, double& cost) const;
 };
 
 }
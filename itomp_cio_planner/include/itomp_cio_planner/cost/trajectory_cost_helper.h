@@ -33,6 +33,62 @@ class TrajectoryCost##C : public TrajectoryCost \
 								int point, double& cost) const;\
 };
 
+#define ITOMP_TRAJECTORY_COST_DECL_WITH_ANALYTIC_DERIVATIVE(C) \
+class TrajectoryCost##C : public TrajectoryCost \
+{\
+	public:\
+		TrajectoryCost##C(int index, std::string name, double weight,\
+						  const NewEvalManager* evaluation_manager) : TrajectoryCost(index, name, weight)\
+		{ \
+			initialize(evaluation_manager); \
+		} \
+		virtual ~TrajectoryCost##C() {} \
+		virtual void initialize(const NewEvalManager* evaluation_manager);\
+		virtual bool evaluate(const NewEvalManager* evaluation_manager, \
+								int point, double& cost) const;\
+		virtual bool hasAnalyticDerivative() const { return true; }\
+		virtual void computeDerivative(const NewEvalManager* evaluation_manager, int point, \
+								const ItompTrajectoryIndex& index, double* derivative) const;\
+};
+
+// declares a cost with members which are bound once in initialize(),
+// e.g. joint/body/group indices resolved from names. the members are declared between
+// ITOMP_TRAJECTORY_COST_DECL_BEGIN(C) and ITOMP_TRAJECTORY_COST_DECL_END
+#define ITOMP_TRAJECTORY_COST_DECL_BEGIN(C) \
+class TrajectoryCost##C : public TrajectoryCost \
+{\
+	public:\
+		TrajectoryCost##C(int index, std::string name, double weight,\
+						  const NewEvalManager* evaluation_manager) : TrajectoryCost(index, name, weight)\
+		{ \
+			initialize(evaluation_manager); \
+		} \
+		virtual ~TrajectoryCost##C() {} \
+		virtual void initialize(const NewEvalManager* evaluation_manager);\
+		virtual bool evaluate(const NewEvalManager* evaluation_manager, \
+								int point, double& cost) const;\
+	protected:
+
+#define ITOMP_TRAJECTORY_COST_DECL_WITH_PRE_POST_EVALUATION_BEGIN(C) \
+class TrajectoryCost##C : public TrajectoryCost \
+{\
+	public:\
+		TrajectoryCost##C(int index, std::string name, double weight,\
+						  const NewEvalManager* evaluation_manager) : TrajectoryCost(index, name, weight)\
+		{ \
+			initialize(evaluation_manager); \
+		} \
+		virtual ~TrajectoryCost##C() {} \
+		virtual void initialize(const NewEvalManager* evaluation_manager);\
+		virtual void preEvaluate(const NewEvalManager* evaluation_manager);\
+		virtual void postEvaluate(const NewEvalManager* evaluation_manager);\
+		virtual bool evaluate(const NewEvalManager* evaluation_manager, \
+								int point, double& cost) const;\
+	protected:
+
+#define ITOMP_TRAJECTORY_COST_DECL_END \
+};
+
 #define ITOMP_TRAJECTORY_COST_ADD(C) \
 if (PlanningParameters::getInstance()->get##C##CostWeight() > 0.0) \
 { \
@@ -40,7 +96,7 @@ if (PlanningParameters::getInstance()->get##C##CostWeight() > 0.0) \
 				boost::make_shared<TrajectoryCost##C >(index++, #C, \
 						PlanningParameters::getInstance()->get##C##CostWeight(), \
 						evaluation_manager)); \
-		TIME_PROFILER_ADD_ENTRY(C) \
+		TIME_PROFILER_ADD_ENTRY(evaluation_manager->getPerformanceProfiler(), C) \
 }
 
 #define ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(C) \
@@ -2,12 +2,11 @@
 #define TRAJECTORY_COST_BUILDER_H_
 
 #include <itomp_cio_planner/common.h>
-#include <itomp_cio_planner/util/singleton.h>
 #include <itomp_cio_planner/cost/trajectory_cost.h>
 
 namespace itomp_cio_planner
 {
-class TrajectoryCostManager: public Singleton<TrajectoryCostManager>
+class TrajectoryCostManager
 {
 public:
 	TrajectoryCostManager();
@@ -21,6 +20,7 @@ public:
 protected:
 	std::vector<TrajectoryCostPtr> cost_function_vector_;
 };
+ITOMP_DEFINE_SHARED_POINTERS(TrajectoryCostManager)
 
 inline std::vector<TrajectoryCostPtr>& TrajectoryCostManager::getCostFunctionVector()
 {
@@ -26,6 +26,13 @@ public:
 	 */
 	bool init(const robot_model::RobotModelConstPtr& robot_model);
 
+	/**
+	 * \brief Initializes the robot models with the given urdf instead of the robot_description parameter
+	 *
+	 * \return true if successful, false if not
+	 */
+	bool init(const robot_model::RobotModelConstPtr& robot_model, const std::string& urdf_string);
+
 	/**
 	 * \brief Gets the planning group corresponding to the group name
 	 */
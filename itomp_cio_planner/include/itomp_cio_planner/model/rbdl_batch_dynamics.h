@@ -0,0 +1,104 @@
+#ifndef RBDL_BATCH_DYNAMICS_H_
+#define RBDL_BATCH_DYNAMICS_H_
+
+#include <itomp_cio_planner/common.h>
+#include <rbdl/rbdl.h>
+
+namespace itomp_cio_planner
+{
+
+// updateFullKinematicsAndDynamics() of consecutive trajectory points in a single traversal of the tree.
+// the spatial quantities are stored as structure of arrays, one array over the points per scalar,
+// so that each operation of the RNEA is vectorized over the points.
+// the results are written back to the models, the models are identical except the state.
+// only 1-dof joints (revolute, prismatic) are supported, isSupported() is false for the other models
+class BatchKinematicsAndDynamics
+{
+public:
+    BatchKinematicsAndDynamics();
+    virtual ~BatchKinematicsAndDynamics();
+
+    // the arrays are allocated once for max_num_points
+    void initialize(const RigidBodyDynamics::Model& model, int max_num_points);
+    bool isInitialized() const;
+    bool isSupported() const;
+
+    // Q, QDot, QDDot : at least (point_end - point_begin) rows x dofs. the row k is the state of the point point_begin + k.
+    // point_end - point_begin must not exceed max_num_points.
+    // models, Tau, f_ext and joint_forces are indexed by the points
+    void update(std::vector<RigidBodyDynamics::Model>& models, int point_begin, int point_end,
+                const Eigen::MatrixXd& Q, const Eigen::MatrixXd& QDot, const Eigen::MatrixXd& QDDot,
+                std::vector<Eigen::VectorXd>& Tau,
+                const std::vector<std::vector<RigidBodyDynamics::Math::SpatialVector> >* f_ext,
+                const std::vector<std::vector<double> >* joint_forces);
+
+private:
+    // the column k has the k-th scalar of the quantity of all points
+    typedef Eigen::Array<double, Eigen::Dynamic, 6> SpatialVectorArray;
+    // E in row-major order (0 - 8) and r (9 - 11)
+    typedef Eigen::Array<double, Eigen::Dynamic, 12> SpatialTransformArray;
+    // the rows of the points updated by a call
+    typedef SpatialVectorArray::RowsBlockXpr SpatialVectorBlock;
+    typedef SpatialTransformArray::RowsBlockXpr SpatialTransformBlock;
+
+    // constant data of a body
+    struct BodyData
+    {
+        unsigned int lambda;
+        unsigned int q_index;
+        bool is_virtual;
+        bool is_revolute;
+        double S[6];
+        // X_lambda = X_J * X_T : E = E_P + cos(q) * E_C + sin(q) * E_K, r = r_T + q * r_q
+        RigidBodyDynamics::Math::Matrix3d E_P, E_C, E_K;
+        RigidBodyDynamics::Math::Vector3d r_T, r_q;
+        RigidBodyDynamics::Math::SpatialRigidBodyInertia I;
+    };
+
+    void writeBack(std::vector<RigidBodyDynamics::Model>& models, int point_begin, int point_end,
+                   std::vector<Eigen::VectorXd>& Tau) const;
+
+    // operations of all points. out must not be one of the inputs
+    void apply(const SpatialTransformBlock& X, const SpatialVectorBlock& v, SpatialVectorBlock out);
+    void addApplyTranspose(const SpatialTransformBlock& X, const SpatialVectorBlock& f, SpatialVectorBlock out);
+    void addApplyAdjoint(const SpatialTransformBlock& X, const SpatialVectorBlock& f, SpatialVectorBlock out);
+    void multiply(const SpatialTransformBlock& X1, const SpatialTransformBlock& X2, SpatialTransformBlock out);
+    // out = I * a + crossf(v, I * v)
+    void computeBodyForce(const RigidBodyDynamics::Math::SpatialRigidBodyInertia& I,
+                          const SpatialVectorBlock& v, const SpatialVectorBlock& a, SpatialVectorBlock out);
+
+    bool is_initialized_;
+    bool is_supported_;
+    int max_num_points_;
+    RigidBodyDynamics::Math::Vector3d gravity_;
+    std::vector<BodyData> bodies_;
+
+    // per-body arrays
+    std::vector<SpatialTransformArray> X_lambda_;
+    std::vector<SpatialTransformArray> X_base_;
+    std::vector<SpatialVectorArray> v_;
+    std::vector<SpatialVectorArray> c_;
+    std::vector<SpatialVectorArray> a_;
+    std::vector<SpatialVectorArray> f_;
+    Eigen::MatrixXd tau_;
+
+    // buffers
+    Eigen::Array<double, Eigen::Dynamic, 2> cos_sin_q_;
+    SpatialVectorArray temp_;
+    SpatialVectorArray force_;
+    Eigen::ArrayXd load_;
+};
+
+inline bool BatchKinematicsAndDynamics::isInitialized() const
+{
+    return is_initialized_;
+}
+
+inline bool BatchKinematicsAndDynamics::isSupported() const
+{
+    return is_supported_;
+}
+
+}
+
+#endif /* RBDL_BATCH_DYNAMICS_H_ */
@@ -37,6 +37,29 @@ void UpdatePartialKinematics(RigidBodyDynamics::Model & model,
 							 const RigidBodyDynamics::Math::VectorNd& QDDot,
 							 const std::vector<unsigned int>& body_ids);
 
+// preallocated buffers of InverseKinematics6D. a workspace is used by a single thread at a time
+class InverseKinematics6DWorkspace
+{
+public:
+    void resize(unsigned int num_bodies, unsigned int qdot_size);
+
+    RigidBodyDynamics::Math::MatrixNd J;
+    RigidBodyDynamics::Math::MatrixNd G;
+    RigidBodyDynamics::Math::VectorNd e;
+    RigidBodyDynamics::Math::MatrixNd JJT_lambda2_I;
+    RigidBodyDynamics::Math::VectorNd z;
+    RigidBodyDynamics::Math::VectorNd delta_theta;
+    std::vector<RigidBodyDynamics::Math::Vector3d> target_euler;
+};
+
+// targets of the bodies for the IK of a trajectory point
+struct InverseKinematics6DProblem
+{
+    std::vector<unsigned int> body_ids;
+    std::vector<RigidBodyDynamics::Math::Vector3d> target_positions;
+    std::vector<RigidBodyDynamics::Math::Matrix3d> target_orientations;
+};
+
 bool InverseKinematics6D(RigidBodyDynamics::Model &model,
                          const RigidBodyDynamics::Math::VectorNd &Qinit,
                          const std::vector<unsigned int>& body_id,
@@ -48,6 +71,30 @@ bool InverseKinematics6D(RigidBodyDynamics::Model &model,
                          unsigned int max_iter = 50
                         );
 
+bool InverseKinematics6D(RigidBodyDynamics::Model &model,
+                         const RigidBodyDynamics::Math::VectorNd &Qinit,
+                         const std::vector<unsigned int>& body_id,
+                         const std::vector<RigidBodyDynamics::Math::Vector3d>& target_pos,
+                         const std::vector<RigidBodyDynamics::Math::Matrix3d>& target_ori,
+                         RigidBodyDynamics::Math::VectorNd &Qres,
+                         InverseKinematics6DWorkspace& workspace,
+                         double step_tol = 1.0e-12,
+                         double lambda = 0.01,
+                         unsigned int max_iter = 50
+                        );
+
+// solves the IK problems of several trajectory points in parallel. problems[i] is solved with models[points[i]],
+// starting from Q[i]. the solution is returned in Q[i] and results[i] is set to 1 if the IK converged
+void InverseKinematics6DBatch(std::vector<RigidBodyDynamics::Model> &models,
+                              const std::vector<unsigned int>& points,
+                              const std::vector<InverseKinematics6DProblem>& problems,
+                              std::vector<RigidBodyDynamics::Math::VectorNd>& Q,
+                              std::vector<int>& results,
+                              double step_tol = 1.0e-12,
+                              double lambda = 0.01,
+                              unsigned int max_iter = 50
+                             );
+
 void CalcPointJacobian6D (
         RigidBodyDynamics::Model &model,
         const RigidBodyDynamics::Math::VectorNd &Q,
@@ -0,0 +1,79 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <itomp_cio_planner/common.h>
+#include <boost/thread.hpp>
+#include <deque>
+
+namespace itomp_cio_planner
+{
+ITOMP_FORWARD_DECL(NewEvalManager)
+ITOMP_FORWARD_DECL(Checkpoint)
+
+// optimization state at the end of a phase, stored in a binary file.
+// the matrices are written column-major in the native byte order
+class Checkpoint
+{
+public:
+    // per contact : serialized position (7), serialized forces (12),
+    // projected position (3), projected orientation (3), projected point positions (4 * 3)
+    static const int CONTACT_VARIABLES_SIZE = 7 + NUM_ENDEFFECTOR_CONTACT_POINTS * 3 + 3 + 3 + NUM_ENDEFFECTOR_CONTACT_POINTS * 3;
+
+    Checkpoint();
+    virtual ~Checkpoint();
+
+    void capture(const NewEvalManager& evaluation_manager, int phase);
+    // restores the parameters and the trajectory. the contact variables and the costs are recomputed in the next evaluate()
+    bool restore(NewEvalManager& evaluation_manager) const;
+
+    bool write(const std::string& file_name) const;
+    bool read(const std::string& file_name);
+
+    void printText(std::ostream& out_stream) const;
+    // one value per line : section,name,row,column,value
+    void printCSV(std::ostream& out_stream) const;
+
+    static std::string getFileName(int phase, int trial_index);
+
+    int phase_;
+    int trial_index_;
+    Eigen::VectorXd parameters_;
+
+    // element trajectories in [component][sub_component] order, points x elements
+    std::vector<std::string> trajectory_names_;
+    std::vector<Eigen::MatrixXd> trajectories_;
+
+    // rows of the contacts of each point, CONTACT_VARIABLES_SIZE columns
+    int num_contacts_;
+    Eigen::MatrixXd contact_variables_;
+
+    // points x cost functions
+    std::vector<std::string> cost_names_;
+    Eigen::MatrixXd cost_matrix_;
+};
+
+// writes the checkpoints in a background thread in the order they are requested
+class CheckpointWriter : public Singleton<CheckpointWriter>
+{
+public:
+    CheckpointWriter();
+    virtual ~CheckpointWriter();
+
+    void write(const CheckpointConstPtr& checkpoint, const std::string& file_name);
+    // blocks until all requested checkpoints are written
+    void flush();
+
+private:
+    void writeThread();
+
+    boost::thread write_thread_;
+    boost::mutex write_mutex_;
+    boost::condition_variable write_condition_;
+    std::deque<std::pair<CheckpointConstPtr, std::string> > write_queue_;
+    bool is_writing_;
+    bool stop_write_thread_;
+};
+
+}
+
+#endif /* CHECKPOINT_H_ */
@@ -0,0 +1,65 @@
+#ifndef DERIVATIVE_SCHEDULER_H_
+#define DERIVATIVE_SCHEDULER_H_
+
+#include <itomp_cio_planner/common.h>
+#include <itomp_cio_planner/trajectory/itomp_trajectory.h>
+#include <omp.h>
+
+namespace itomp_cio_planner
+{
+
+// distributes the derivative evaluations of the parameters to the threads.
+// the parameters are assigned by their estimated costs (longest first to the least loaded thread),
+// a thread whose queue is empty steals the cheapest remaining parameters of the other threads.
+// the cost estimates are learned from the evaluation times of the previous iterations
+class DerivativeScheduler
+{
+public:
+    DerivativeScheduler();
+    virtual ~DerivativeScheduler();
+
+    void initialize(const ItompTrajectoryConstPtr& trajectory, int num_threads);
+
+    // not thread-safe. called before the parallel loop
+    void schedule(const std::vector<long>& parameters);
+
+    // thread-safe. returns false if no parameter is left in any queue
+    bool getNextParameter(int thread_index, long& parameter);
+    // thread-safe for different parameters
+    void updateCost(long parameter, double elapsed);
+
+private:
+    struct Queue
+    {
+        Queue();
+        ~Queue();
+
+        // the queues of two threads are not on the same cache line
+        char front_padding_[64];
+        omp_lock_t lock_;
+        std::vector<long> parameters_;
+        int begin_;
+        int end_;
+        double load_;
+        char back_padding_[64];
+    };
+    typedef boost::shared_ptr<Queue> QueuePtr;
+
+    struct CostGreater
+    {
+        CostGreater(const std::vector<double>& costs) : costs_(costs) {}
+        bool operator()(long a, long b) const
+        {
+            return costs_[a] > costs_[b];
+        }
+        const std::vector<double>& costs_;
+    };
+
+    std::vector<QueuePtr> queues_;
+    std::vector<double> cost_estimates_;
+    std::vector<long> sorted_parameters_;
+};
+
+}
+
+#endif /* DERIVATIVE_SCHEDULER_H_ */
@@ -4,6 +4,8 @@
 #include <itomp_cio_planner/optimization/improvement_manager.h>
 #include <itomp_cio_planner/common.h>
 #include <itomp_cio_planner/optimization/new_eval_manager.h>
+#include <itomp_cio_planner/util/jacobian.h>
+#include <itomp_cio_planner/optimization/derivative_scheduler.h>
 #include "dlib/optimization.h"
 
 namespace itomp_cio_planner
@@ -24,16 +26,20 @@ public:
 protected:
 	void addNoiseToVariables(column_vector& variables);
 
+	// variables of evaluate/derivative are the active parameters of the phase
 	double evaluate(const column_vector& variables);
 	column_vector derivative(const column_vector& variables);
 	column_vector derivative_ref(const column_vector& variables);
+	void validateDerivative(const column_vector& variables, const column_vector& der);
 
 	void optimize(int iteration, column_vector& variables);
 
-    void computeEvaluationOrder(long variable_size);
+    void computeActiveParameters();
+    void scatterActiveParameters(const column_vector& variables);
 
 	int num_threads_;
 	std::vector<NewEvalManagerPtr> derivatives_evaluation_manager_;
+    NullSpaceProjector null_space_projector_;
 
 	std::vector<Eigen::MatrixXd> evaluation_cost_matrices_;
 
@@ -45,7 +51,13 @@ protected:
 	ros::Time start_time_;
 	int evaluation_count_;
 
-    std::vector<long> evaluation_order_;
+    DerivativeScheduler derivative_scheduler_;
+
+    // indices of the parameters updated in the current phase. dlib optimizes the compacted vector of these,
+    // the other parameters keep their values in full_variables_
+    std::vector<long> active_parameters_;
+    column_vector full_variables_;
+    column_vector full_derivatives_;
 };
 
 }
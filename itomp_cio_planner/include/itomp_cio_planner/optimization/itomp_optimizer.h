@@ -5,6 +5,7 @@
 #include <itomp_cio_planner/trajectory/itomp_trajectory.h>
 #include <itomp_cio_planner/optimization/new_eval_manager.h>
 #include <itomp_cio_planner/optimization/improvement_manager.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
 #include <itomp_cio_planner/planner/planning_info_manager.h>
 
 namespace itomp_cio_planner
@@ -15,6 +16,7 @@ class ItompOptimizer
 {
 public:
 	ItompOptimizer(int trajectory_index,
+                   const PlanningContextPtr& planning_context,
                    const ItompTrajectoryPtr& itomp_trajectory,
 				   const ItompRobotModelConstPtr& robot_model,
 				   const planning_scene::PlanningSceneConstPtr& planning_scene,
@@ -40,6 +42,8 @@ private:
 	int trajectory_index_;
 	double planning_start_time_;
 
+	PlanningContextPtr planning_context_;
+
 	int iteration_;
 
 	NewEvalManagerPtr evaluation_manager_;
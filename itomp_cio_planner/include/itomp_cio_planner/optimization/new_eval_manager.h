@@ -3,6 +3,7 @@
 
 #include <itomp_cio_planner/common.h>
 #include <itomp_cio_planner/model/itomp_robot_model.h>
+#include <itomp_cio_planner/model/rbdl_batch_dynamics.h>
 #include <itomp_cio_planner/trajectory/itomp_trajectory.h>
 #include <itomp_cio_planner/contact/contact_variables.h>
 #include <kdl/frames.hpp>
@@ -12,10 +13,15 @@
 #include <moveit/robot_state/robot_state.h>
 #include <itomp_cio_planner/collision/collision_world_fcl_derivatives.h>
 #include <itomp_cio_planner/collision/collision_robot_fcl_derivatives.h>
+#include <itomp_cio_planner/collision/obstacle_distance_field.h>
 
 namespace itomp_cio_planner
 {
 ITOMP_FORWARD_DECL(NewEvalManager)
+ITOMP_FORWARD_DECL(PlanningContext)
+ITOMP_FORWARD_DECL(PhaseManager)
+ITOMP_FORWARD_DECL(TrajectoryCostManager)
+ITOMP_FORWARD_DECL(TrajectoryCost)
 
 class NewEvalManager
 {
@@ -26,7 +32,12 @@ public:
 
     NewEvalManager& operator=(const NewEvalManager& manager);
 
-    void initialize(const ItompTrajectoryPtr& itomp_trajectory,
+    // creates a manager for derivative computation. it shares the read-only state (models, world collision)
+    // with this manager and owns the per-point state of a single perturbation window only
+    NewEvalManager* createDerivativeEvaluationManager() const;
+
+    void initialize(const PlanningContextPtr& planning_context,
+                    const ItompTrajectoryPtr& itomp_trajectory,
 					const ItompRobotModelConstPtr& robot_model,
 					const planning_scene::PlanningSceneConstPtr& planning_scene,
 					const ItompPlanningGroupConstPtr& planning_group,
@@ -34,13 +45,15 @@ public:
                     const std::vector<moveit_msgs::Constraints>& trajectory_constraints);
 
     const ItompTrajectoryConstPtr& getTrajectory() const;
+    // the returned trajectory can be modified, all points are re-evaluated in the next evaluate()
     ItompTrajectoryPtr& getTrajectoryNonConst();
 
     void getParameters(ItompTrajectory::ParameterVector& parameters) const;
     void setParameters(const ItompTrajectory::ParameterVector& parameters);
 
 	double evaluate();
-    void evaluateParameterPoint(double value, int parameter_index, unsigned int& point_begin, unsigned int& point_end, bool first);
+    void evaluateParameterPoint(double value, int parameter_index, unsigned int& point_begin, unsigned int& point_end, bool first,
+                                bool skip_analytic_costs = false);
 
     void computeDerivatives(int parameter_index, const ItompTrajectory::ParameterVector& parameters,
                             double* derivative_out, double eps);
@@ -49,10 +62,13 @@ public:
 
 	bool isLastTrajectoryFeasible() const;
 	double getTrajectoryCost() const;
+    // cost of the named cost function in the last evaluation. 0 if the cost function is not active
+    double getTrajectoryCost(const std::string& cost_name) const;
 	void printTrajectoryCost(int iteration, bool details = false);
     void resetBestTrajectoryCost();
 
-	void render();
+	// enqueues a snapshot to the visualization thread. force bypasses the rate limit
+	void render(bool force = false);
 
 	void updateFromParameterTrajectory();
 
@@ -64,10 +80,25 @@ public:
 
     const CollisionWorldFCLDerivativesPtr& getCollisionWorldFCLDerivatives() const;
     const CollisionRobotFCLDerivativesPtr& getCollisionRobotFCLDerivatives() const;
+    const ObstacleDistanceFieldConstPtr& getObstacleDistanceField() const;
+    // collision query objects of this manager, reused by the obstacle cost
+    CollisionScratch& getCollisionScratch() const;
+
+    const PlanningContextPtr& getPlanningContext() const;
+    const std::vector<std::vector<ContactVariables> >& getContactVariables() const;
+    const Eigen::MatrixXd& getEvaluationCostMatrix() const;
+    const PhaseManagerPtr& getPhaseManager() const;
+    const TrajectoryCostManagerPtr& getTrajectoryCostManager() const;
+    const PerformanceProfilerPtr& getPerformanceProfiler() const;
 
     void printLinkTransforms() const;
 
 private:
+    NewEvalManager(const NewEvalManager& manager, unsigned int num_overlay_points);
+
+    unsigned int getStateIndex(int point) const;
+    void setDirtyPoints(int point_begin, int point_end);
+
 	void initializeContactVariables();
     void correctContacts(bool update_kinematics = true);
     void correctContacts(int point_begin, int point_end, bool update_kinematics = true);
@@ -75,7 +106,13 @@ private:
 	void performFullForwardKinematicsAndDynamics(int point_begin, int point_end);
     void performPartialForwardKinematicsAndDynamics(int point_begin, int point_end, const ItompTrajectoryIndex& index);
 
-    bool evaluatePointRange(int point_begin, int point_end, Eigen::MatrixXd& cost_matrix, const ItompTrajectoryIndex& index);
+    bool evaluatePointRange(int point_begin, int point_end, Eigen::MatrixXd& cost_matrix, const ItompTrajectoryIndex& index,
+                            bool skip_analytic_costs = false);
+
+    // applied after each perturbation of a parameter, by both derivative modes
+    void avoidNeighbors(const ItompTrajectoryIndex& index);
+    double computeAnalyticDerivative(int parameter_index, double value, double eps);
+    bool requiresFiniteDifference(const ItompTrajectoryIndex& index) const;
 
     void computePassiveForces(int point,
                               const RigidBodyDynamics::Math::VectorNd &q,
@@ -89,22 +126,45 @@ private:
     planning_scene::PlanningSceneConstPtr planning_scene_;
     ItompPlanningGroupConstPtr planning_group_;
 
+    // per-trial members shared with the derivative evaluation managers
+    PlanningContextPtr planning_context_;
+    PhaseManagerPtr phase_manager_;
+    TrajectoryCostManagerPtr trajectory_cost_manager_;
+    PerformanceProfilerPtr performance_profiler_;
+
     // non-pointer members
 	double planning_start_time_;
 	double trajectory_start_time_;
 	bool last_trajectory_feasible_;
     double best_cost_;
 
+    // if non-zero, per-point states are stored in a window of num_overlay_points_ slots
+    unsigned int num_overlay_points_;
+
 	std::vector<RigidBodyDynamics::Model> rbdl_models_;
     std::vector<Eigen::VectorXd> joint_torques_; // computed from inverse dynamics
 	std::vector<std::vector<RigidBodyDynamics::Math::SpatialVector> > external_forces_;
 	std::vector<std::vector<ContactVariables> > contact_variables_;
+    std::vector<std::vector<double> > passive_forces_;
+
+    // batched full kinematics and dynamics of performFullForwardKinematicsAndDynamics()
+    BatchKinematicsAndDynamics batch_dynamics_;
+    Eigen::MatrixXd batch_q_;
+    Eigen::MatrixXd batch_q_dot_;
+    Eigen::MatrixXd batch_q_ddot_;
 
 	Eigen::MatrixXd evaluation_cost_matrix_;
+    // points of which the kinematics/dynamics and the rows of evaluation_cost_matrix_ are outdated.
+    // rows of the other points are reused in evaluate() if the cost functions and the phase are not changed
+    std::vector<bool> dirty_points_;
+    std::vector<TrajectoryCostPtr> evaluated_cost_functions_;
+    unsigned int evaluated_phase_;
+    Eigen::MatrixXd trajectory_derivatives_; // d(trajectory)/d(parameter) for analytic derivatives
 
     std::vector<moveit_msgs::Constraints> trajectory_constraints_;
 
-    static const NewEvalManager* ref_evaluation_manager_;
+    // the manager which has the full trajectory state of the planning context
+    const NewEvalManager* ref_evaluation_manager_;
 
     // non-shared pointer members
     //FullTrajectoryPtr full_trajectory_;
@@ -116,6 +176,8 @@ private:
     std::vector<robot_state::RobotStatePtr> robot_state_;
     CollisionWorldFCLDerivativesPtr collision_world_derivatives_;
     CollisionRobotFCLDerivativesPtr collision_robot_derivatives_;
+    ObstacleDistanceFieldConstPtr obstacle_distance_field_;
+    mutable CollisionScratch collision_scratch_;
 
     friend class ItompOptimizer;
 
@@ -140,6 +202,7 @@ inline const ItompTrajectoryConstPtr& NewEvalManager::getTrajectory() const
 
 inline ItompTrajectoryPtr& NewEvalManager::getTrajectoryNonConst()
 {
+    setDirtyPoints(0, dirty_points_.size());
     return itomp_trajectory_;
 }
 
@@ -163,9 +226,19 @@ inline const ItompPlanningGroupConstPtr& NewEvalManager::getPlanningGroup() cons
 	return planning_group_;
 }
 
+inline unsigned int NewEvalManager::getStateIndex(int point) const
+{
+    return (num_overlay_points_ == 0) ? point : point % num_overlay_points_;
+}
+
+inline void NewEvalManager::setDirtyPoints(int point_begin, int point_end)
+{
+    std::fill(dirty_points_.begin() + point_begin, dirty_points_.begin() + point_end, true);
+}
+
 inline const RigidBodyDynamics::Model& NewEvalManager::getRBDLModel(int point) const
 {
-	return rbdl_models_[point];
+	return rbdl_models_[getStateIndex(point)];
 }
 
 inline const ItompRobotModelConstPtr& NewEvalManager::getItompRobotModel() const
@@ -175,7 +248,7 @@ inline const ItompRobotModelConstPtr& NewEvalManager::getItompRobotModel() const
 
 inline const robot_state::RobotStatePtr& NewEvalManager::getRobotState(int point) const
 {
-	return robot_state_[point];
+	return robot_state_[getStateIndex(point)];
 }
 
 inline const CollisionWorldFCLDerivativesPtr& NewEvalManager::getCollisionWorldFCLDerivatives() const
@@ -188,6 +261,46 @@ inline const CollisionRobotFCLDerivativesPtr& NewEvalManager::getCollisionRobotF
     return collision_robot_derivatives_;
 }
 
+inline const ObstacleDistanceFieldConstPtr& NewEvalManager::getObstacleDistanceField() const
+{
+    return obstacle_distance_field_;
+}
+
+inline CollisionScratch& NewEvalManager::getCollisionScratch() const
+{
+    return collision_scratch_;
+}
+
+inline const PlanningContextPtr& NewEvalManager::getPlanningContext() const
+{
+    return planning_context_;
+}
+
+inline const std::vector<std::vector<ContactVariables> >& NewEvalManager::getContactVariables() const
+{
+    return contact_variables_;
+}
+
+inline const Eigen::MatrixXd& NewEvalManager::getEvaluationCostMatrix() const
+{
+    return evaluation_cost_matrix_;
+}
+
+inline const PhaseManagerPtr& NewEvalManager::getPhaseManager() const
+{
+    return phase_manager_;
+}
+
+inline const TrajectoryCostManagerPtr& NewEvalManager::getTrajectoryCostManager() const
+{
+    return trajectory_cost_manager_;
+}
+
+inline const PerformanceProfilerPtr& NewEvalManager::getPerformanceProfiler() const
+{
+    return performance_profiler_;
+}
+
 }
 
 #endif
@@ -7,7 +7,7 @@
 namespace itomp_cio_planner
 {
 
-class PhaseManager : public Singleton<PhaseManager>
+class PhaseManager
 {
 public:
     PhaseManager();
@@ -18,7 +18,16 @@ public:
     unsigned int getPhase() const;
     void setPhase(unsigned int phase);
 
+    // the optimization of a warm-started trajectory starts from this phase if the trajectory is collision-free
+    unsigned int getWarmStartPhase() const;
+    void setWarmStartPhase(unsigned int phase);
+
+    // contact forces are updated or frozen per contact (3 forces per contact point)
+    static const int CONTACT_FORCE_GROUP_SIZE = NUM_ENDEFFECTOR_CONTACT_POINTS * 3;
+
     bool updateParameter(const ItompTrajectoryIndex& index) const;
+    // number of consecutive parameters of a point in a sub-component for which updateParameter() returns the same value
+    unsigned int getParameterGroupSize(unsigned int sub_component, unsigned int num_parameters) const;
 
     int agent_id_;
     int support_foot_;
@@ -26,9 +35,11 @@ public:
 
 private:
     unsigned int phase_;
+    unsigned int warm_start_phase_;
     int num_points_;
     ItompPlanningGroupConstPtr planning_group_;
 };
+ITOMP_DEFINE_SHARED_POINTERS(PhaseManager)
 
 inline unsigned int PhaseManager::getPhase() const
 {
@@ -40,6 +51,23 @@ inline void PhaseManager::setPhase(unsigned int phase)
     phase_ = phase;
 }
 
+inline unsigned int PhaseManager::getParameterGroupSize(unsigned int sub_component, unsigned int num_parameters) const
+{
+    if (sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_CONTACT_FORCE)
+        return CONTACT_FORCE_GROUP_SIZE;
+    return num_parameters;
+}
+
+inline unsigned int PhaseManager::getWarmStartPhase() const
+{
+    return warm_start_phase_;
+}
+
+inline void PhaseManager::setWarmStartPhase(unsigned int phase)
+{
+    warm_start_phase_ = phase;
+}
+
 }
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef PLANNING_CONTEXT_H_
+#define PLANNING_CONTEXT_H_
+
+#include <itomp_cio_planner/common.h>
+#include <itomp_cio_planner/optimization/phase_manager.h>
+#include <itomp_cio_planner/cost/trajectory_cost_manager.h>
+#include <itomp_cio_planner/util/performance_profiler.h>
+
+namespace itomp_cio_planner
+{
+
+// per-trial optimization state. trials running in parallel have their own contexts
+class PlanningContext
+{
+public:
+    PlanningContext(int trial_index = 0, bool visualize = true);
+    virtual ~PlanningContext();
+
+    int getTrialIndex() const;
+    bool getVisualize() const;
+
+    const PhaseManagerPtr& getPhaseManager() const;
+    const TrajectoryCostManagerPtr& getTrajectoryCostManager() const;
+    const PerformanceProfilerPtr& getPerformanceProfiler() const;
+
+private:
+    int trial_index_;
+    bool visualize_;
+
+    PhaseManagerPtr phase_manager_;
+    TrajectoryCostManagerPtr trajectory_cost_manager_;
+    PerformanceProfilerPtr performance_profiler_;
+};
+ITOMP_DEFINE_SHARED_POINTERS(PlanningContext)
+
+///////////////////////// inline functions follow //////////////////////
+
+inline int PlanningContext::getTrialIndex() const
+{
+    return trial_index_;
+}
+
+inline bool PlanningContext::getVisualize() const
+{
+    return visualize_;
+}
+
+inline const PhaseManagerPtr& PlanningContext::getPhaseManager() const
+{
+    return phase_manager_;
+}
+
+inline const TrajectoryCostManagerPtr& PlanningContext::getTrajectoryCostManager() const
+{
+    return trajectory_cost_manager_;
+}
+
+inline const PerformanceProfilerPtr& PlanningContext::getPerformanceProfiler() const
+{
+    return performance_profiler_;
+}
+
+}
+
+#endif /* PLANNING_CONTEXT_H_ */
@@ -6,6 +6,7 @@
 #include <itomp_cio_planner/model/itomp_robot_model.h>
 #include <itomp_cio_planner/trajectory/itomp_trajectory.h>
 #include <itomp_cio_planner/optimization/itomp_optimizer.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
 #include <moveit/planning_interface/planning_interface.h>
 #include <moveit/planning_scene/planning_scene.h>
 
@@ -33,16 +34,26 @@ public:
                         planning_interface::MotionPlanResponse &res);
 
 private:
+    // returns false if the cost of a planning group exceeds the failure cost
+    bool planTrial(int trial, const ItompTrajectoryPtr& itomp_trajectory,
+                   const PlanningContextPtr& planning_context,
+                   const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const planning_interface::MotionPlanRequest &req,
+                   const robot_state::RobotStatePtr& initial_robot_state,
+                   const std::vector<std::string>& planning_group_names,
+                   double trajectory_start_time);
+
 	bool validateRequest(const planning_interface::MotionPlanRequest &req);
     std::vector<std::string> getPlanningGroups(const std::string& group_name) const;
     void fillInResult(const robot_state::RobotStatePtr& robot_state,
                       planning_interface::MotionPlanResponse &res);
 
-    bool adjustStartGoalPositions(robot_state::RobotState& initial_state, robot_state::RobotState& goal_state, bool read_start_state_from_previous_step);
+    bool adjustStartGoalPositions(robot_state::RobotState& initial_state, robot_state::RobotState& goal_state, bool read_start_state_from_previous_step,
+                                  const PlanningContextPtr& planning_context);
     bool applySideStepping(const robot_state::RobotState& initial_state, robot_state::RobotState& goal_state);
     eFOOT_INDEX getFrontFoot(const robot_state::RobotState& initial_state, eFOOT_INDEX& support_foot);
 
-    bool readWaypoint(robot_state::RobotStatePtr& robot_state);
+    bool readWaypoint(robot_state::RobotStatePtr& robot_state, const PlanningContextPtr& planning_context);
     void writeWaypoint();
     void deleteWaypointFiles();
     void writeTrajectory();
@@ -53,7 +64,6 @@ private:
 	ItompRobotModelPtr itomp_robot_model_;
 
     ItompTrajectoryPtr itomp_trajectory_;
-	ItompOptimizerPtr optimizer_;
 	PlanningInfoManager planning_info_manager_;
 };
 ITOMP_DEFINE_SHARED_POINTERS(ItompPlannerNode)
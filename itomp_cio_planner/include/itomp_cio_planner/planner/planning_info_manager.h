@@ -44,6 +44,10 @@ public:
 	void write(int trials, int component, const PlanningInfo& info);
 	void printSummary() const;
 
+	// the lowest cost trial among the trials in which all components succeeded.
+	// the lowest cost trial if there is no such trial
+	int getBestTrial() const;
+
 protected:
 	std::vector<std::vector<PlanningInfo> > planning_info_;
 };
@@ -0,0 +1,47 @@
+#ifndef TRAJECTORY_CACHE_H_
+#define TRAJECTORY_CACHE_H_
+
+#include <itomp_cio_planner/common.h>
+#include <itomp_cio_planner/trajectory/itomp_trajectory.h>
+#include <boost/thread/mutex.hpp>
+#include <list>
+
+namespace itomp_cio_planner
+{
+
+// recently optimized trajectories, keyed by their start and goal joint positions.
+// a new request is seeded from the closest cached trajectory instead of the interpolated input trajectory.
+// shared by the planner nodes, the accesses are serialized
+class TrajectoryCache : public Singleton<TrajectoryCache>
+{
+public:
+    TrajectoryCache();
+    virtual ~TrajectoryCache();
+
+    // stores a copy of the trajectory. the least recently used trajectory is dropped if the cache is full
+    void insert(const ItompTrajectory& trajectory, unsigned int capacity);
+
+    // replaces all components of the trajectory with the closest cached trajectory,
+    // time-warped to the duration of the trajectory and offset to its start and goal joint positions.
+    // returns false if there is no cached trajectory within max_distance
+    bool seed(ItompTrajectory& trajectory, double max_distance);
+
+    void clear();
+
+private:
+    struct Entry
+    {
+        Eigen::VectorXd key_;
+        ItompTrajectoryConstPtr trajectory_;
+    };
+
+    void computeKey(const ItompTrajectory& trajectory, Eigen::VectorXd& key) const;
+    void warpTrajectory(const ItompTrajectory& source, ItompTrajectory& trajectory) const;
+
+    std::list<Entry> entries_; // most recently used first
+    boost::mutex entries_mutex_;
+};
+
+}
+
+#endif /* TRAJECTORY_CACHE_H_ */
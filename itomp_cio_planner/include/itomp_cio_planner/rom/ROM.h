@@ -52,6 +52,10 @@ public:
 	/// If the point is outside the polytope, returns a negative distance
 	double NormalizedResidualRadius(const double x, const double y, const double z) const;
 
+	/// \brief ResidualRadius for num_points configurations at once.
+	/// x, y and z are arrays of num_points angles, the results are written to residuals
+	void ResidualRadius(const double* x, const double* y, const double* z, const int num_points, double* residuals) const;
+
 public:
 	Eigen::MatrixXd A_;
 	Eigen::MatrixXd ANorm_;
@@ -63,9 +67,14 @@ public:
 	int  axis1_, axis2_, axis3_;
 private:
 	Eigen::Vector3d vAxis1_, vAxis2_, vAxis3_;
+	// ANorm_ columns stored separately for the batched evaluation
+	Eigen::VectorXd n1_, n2_, n3_;
 };
 
 ROM ROMFromFile(const std::string& filepath);
 
+/// \brief same as ROMFromFile, but each file is only read once per process
+ROM CachedROMFromFile(const std::string& filepath);
+
 } //namespace rom
 #endif //_STRUCT_ROM
@@ -11,6 +11,18 @@ ITOMP_FORWARD_DECL(ElementTrajectory)
 class ElementTrajectory : public NewTrajectory
 {
 public:
+    // the data is stored point-contiguous (row-major) if ITOMP_ROW_MAJOR_TRAJECTORY is defined,
+    // element-contiguous (column-major) otherwise. Point maps a point without copying in both layouts
+#ifdef ITOMP_ROW_MAJOR_TRAJECTORY
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Data;
+    typedef Eigen::InnerStride<1> PointStride;
+#else
+    typedef Eigen::MatrixXd Data;
+    typedef Eigen::InnerStride<Eigen::Dynamic> PointStride;
+#endif
+    typedef Eigen::Map<Eigen::VectorXd, 0, PointStride> Point;
+    typedef Eigen::Map<const Eigen::VectorXd, 0, PointStride> ConstPoint;
+
     // Construct a trajectory
     ElementTrajectory(const std::string& name, unsigned int num_points, unsigned int num_elements);
     ElementTrajectory(const ElementTrajectory& trajectory);
@@ -18,8 +30,15 @@ public:
     virtual ~ElementTrajectory();
     virtual ElementTrajectory* clone() const;
 
-    Eigen::MatrixXd::RowXpr getTrajectoryPoint(int point);
-    Eigen::MatrixXd::ConstRowXpr getTrajectoryPoint(int point) const;
+    Data::RowXpr getTrajectoryPoint(int point);
+    Data::ConstRowXpr getTrajectoryPoint(int point) const;
+
+    Point getPoint(int point);
+    ConstPoint getPoint(int point) const;
+
+    // contiguous values of the point. the point is copied to buffer only if the storage is column-major
+    const double* getPointData(int point, Eigen::VectorXd& buffer) const;
+    static bool isPointContiguous();
 
     double& operator()(unsigned int point, unsigned int element);
     double operator()(unsigned int point, unsigned int element) const;
@@ -27,8 +46,8 @@ public:
     double& at(unsigned int point, unsigned int element);
     double at(unsigned int point, unsigned int element) const;
 
-    Eigen::MatrixXd& getData();
-    const Eigen::MatrixXd& getData() const;
+    Data& getData();
+    const Data& getData() const;
 
     virtual void printTrajectory(std::ostream& out_stream, int point_start = 0, int point_end = -1) const;
     virtual void reset();
@@ -36,23 +55,47 @@ public:
 protected:
     void allocate(); /**< \brief Allocates memory for the trajectory */
 
-    Eigen::MatrixXd trajectory_data_; /**< Storage for the actual trajectory */
+    Data trajectory_data_; /**< Storage for the actual trajectory */
 
 };
 ITOMP_DEFINE_SHARED_POINTERS(ElementTrajectory)
 
 ///////////////////////// inline functions follow //////////////////////
 
-inline Eigen::MatrixXd::RowXpr ElementTrajectory::getTrajectoryPoint(int point)
+inline ElementTrajectory::Data::RowXpr ElementTrajectory::getTrajectoryPoint(int point)
 {
     return trajectory_data_.row(point);
 }
 
-inline Eigen::MatrixXd::ConstRowXpr ElementTrajectory::getTrajectoryPoint(int point) const
+inline ElementTrajectory::Data::ConstRowXpr ElementTrajectory::getTrajectoryPoint(int point) const
 {
     return trajectory_data_.row(point);
 }
 
+inline ElementTrajectory::Point ElementTrajectory::getPoint(int point)
+{
+    return Point(&trajectory_data_(point, 0), num_elements_, PointStride(trajectory_data_.colStride()));
+}
+
+inline ElementTrajectory::ConstPoint ElementTrajectory::getPoint(int point) const
+{
+    return ConstPoint(&trajectory_data_(point, 0), num_elements_, PointStride(trajectory_data_.colStride()));
+}
+
+inline const double* ElementTrajectory::getPointData(int point, Eigen::VectorXd& buffer) const
+{
+    if (isPointContiguous())
+        return &trajectory_data_(point, 0);
+
+    buffer = getPoint(point);
+    return buffer.data();
+}
+
+inline bool ElementTrajectory::isPointContiguous()
+{
+    return Data::IsRowMajor;
+}
+
 inline double& ElementTrajectory::operator()(unsigned int point, unsigned int element)
 {
     return trajectory_data_(point, element);
@@ -73,12 +116,12 @@ inline double ElementTrajectory::at(unsigned int point, unsigned int element) co
     return trajectory_data_(point, element);
 }
 
-inline Eigen::MatrixXd& ElementTrajectory::getData()
+inline ElementTrajectory::Data& ElementTrajectory::getData()
 {
     return trajectory_data_;
 }
 
-inline const Eigen::MatrixXd& ElementTrajectory::getData() const
+inline const ElementTrajectory::Data& ElementTrajectory::getData() const
 {
     return trajectory_data_;
 }
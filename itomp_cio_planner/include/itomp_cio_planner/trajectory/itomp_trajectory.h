@@ -13,6 +13,7 @@
 namespace itomp_cio_planner
 {
 ITOMP_FORWARD_DECL(ItompTrajectory)
+ITOMP_FORWARD_DECL(PhaseManager)
 
 struct ItompTrajectoryIndex
 {
@@ -43,6 +44,7 @@ public:
 
     typedef dlib::matrix<double, 0, 1> ParameterVector;
     typedef std::vector<ItompTrajectoryIndex> ParameterMap;
+    typedef std::vector<unsigned int>::const_iterator ParameterIndexIterator;
 
     ItompTrajectory(const ItompTrajectory& trajectory);
     virtual ~ItompTrajectory();
@@ -52,10 +54,18 @@ public:
             const ItompPlanningGroupConstPtr& planning_group);
     const ItompTrajectoryIndex& getTrajectoryIndex(unsigned int parameter_index) const;
 
-    void setParameters(const ParameterVector& parameters, const ItompPlanningGroupConstPtr& planning_group);
+    // parameter indices of a point in a component/sub-component, in the parameter vector order.
+    // the range is empty if the point is not a keyframe
+    ParameterIndexIterator getPointParametersBegin(unsigned int point, unsigned int component, unsigned int sub_component) const;
+    ParameterIndexIterator getPointParametersEnd(unsigned int point, unsigned int component, unsigned int sub_component) const;
+
+    // if changed_points is given, the points affected by the changed parameters are set to true
+    void setParameters(const ParameterVector& parameters, const ItompPlanningGroupConstPtr& planning_group,
+                       const PhaseManager& phase_manager, std::vector<bool>* changed_points = NULL);
     void getParameters(ParameterVector& parameters) const;
 
-    void directChangeForDerivativeComputation(unsigned int parameter_index, double value,
+    void directChangeForDerivativeComputation(const PhaseManager& phase_manager,
+            unsigned int parameter_index, double value,
             unsigned int& trajectory_point_begin, unsigned int& trajectory_point_end,
             bool backup = true);
 
@@ -88,6 +98,7 @@ public:
     int getParameterJointIndex(int trajectory_index) const;
 
     double getDiscretization() const;
+    unsigned int getKeyframeInterval() const;
 
     bool avoidNeighbors(const std::vector<moveit_msgs::Constraints>& neighbors);
 
@@ -103,6 +114,10 @@ protected:
 
     void interpolateTrajectory(unsigned int trajectory_point_begin, unsigned int trajectory_point_end,
                                const ItompTrajectoryIndex& index);
+    void computeHermiteBasis();
+    // keyframe_values : 4 x elements matrix of (cur_pos, cur_vel, next_pos, next_vel)
+    void interpolateKeyframeSpan(unsigned int sub_component, unsigned int cur_keyframe_index,
+                                 const Eigen::MatrixXd& keyframe_values);
     void interpolateInputJointTrajectory(const std::vector<unsigned int>& group_rbdl_indices,
                                          const ItompPlanningGroupConstPtr& planning_group,
                                          const moveit_msgs::TrajectoryConstraints& trajectory_constraints);
@@ -115,11 +130,20 @@ protected:
     ParameterMap parameter_to_index_map_;
     std::vector<int> full_to_parameter_joint_index_map_;
 
+    // reverse of parameter_to_index_map_. the parameters of (point, component, sub_component) are
+    // point_parameter_indices_[point_parameter_offsets_[i]..point_parameter_offsets_[i + 1]),
+    // i = (point * COMPONENT_TYPE_NUM + component) * SUB_COMPONENT_TYPE_NUM + sub_component
+    std::vector<unsigned int> point_parameter_offsets_;
+    std::vector<unsigned int> point_parameter_indices_;
+
     ElementTrajectoryPtr element_trajectories_[COMPONENT_TYPE_NUM][SUB_COMPONENT_TYPE_NUM];
 
     Eigen::MatrixXd backup_trajectory_[COMPONENT_TYPE_NUM];
     ItompTrajectoryIndex backup_index_;
 
+    // (keyframe_interval_ + 1) x 4 cubic hermite basis of pos/vel/acc in a keyframe span
+    Eigen::MatrixXd hermite_basis_[COMPONENT_TYPE_NUM];
+
     friend class TrajectoryFactory;
 };
 ITOMP_DEFINE_SHARED_POINTERS(ItompTrajectory)
@@ -141,6 +165,20 @@ inline const ItompTrajectoryIndex& ItompTrajectory::getTrajectoryIndex(unsigned
     return parameter_to_index_map_[parameter_index];
 }
 
+inline ItompTrajectory::ParameterIndexIterator ItompTrajectory::getPointParametersBegin(unsigned int point,
+        unsigned int component, unsigned int sub_component) const
+{
+    return point_parameter_indices_.begin() +
+           point_parameter_offsets_[(point * COMPONENT_TYPE_NUM + component) * SUB_COMPONENT_TYPE_NUM + sub_component];
+}
+
+inline ItompTrajectory::ParameterIndexIterator ItompTrajectory::getPointParametersEnd(unsigned int point,
+        unsigned int component, unsigned int sub_component) const
+{
+    return point_parameter_indices_.begin() +
+           point_parameter_offsets_[(point * COMPONENT_TYPE_NUM + component) * SUB_COMPONENT_TYPE_NUM + sub_component + 1];
+}
+
 inline int ItompTrajectory::getParameterJointIndex(int trajectory_index) const
 {
     return full_to_parameter_joint_index_map_[trajectory_index];
@@ -151,6 +189,11 @@ inline double ItompTrajectory::getDiscretization() const
     return discretization_;
 }
 
+inline unsigned int ItompTrajectory::getKeyframeInterval() const
+{
+    return keyframe_interval_;
+}
+
 inline void ItompTrajectory::interpolateStartEnd(SUB_COMPONENT_TYPE sub_component_type,
         const std::vector<unsigned int>* element_indices)
 {
@@ -17,21 +17,41 @@ inline void debugJointArray(KDL::JntArray& joint_array)
 
 //#define USE_TIME_PROFILER
 #ifdef USE_TIME_PROFILER
-#define TIME_PROFILER_INIT(get_time_func, num_threads) PerformanceProfiler::getInstance()->initialize(get_time_func, num_threads);
-#define TIME_PROFILER_ADD_ENTRY(name) PerformanceProfiler::getInstance()->addEntry(#name);
-#define TIME_PROFILER_START_ITERATION PerformanceProfiler::getInstance()->startIteration();
-#define TIME_PROFILER_START_TIMER(name) PerformanceProfiler::getInstance()->startTimer(#name);
-#define TIME_PROFILER_END_TIMER(name) PerformanceProfiler::getInstance()->endTimer(#name);
-#define TIME_PROFILER_PRINT_TOTAL_TIME(show_percentage) PerformanceProfiler::getInstance()->printTotalTime(show_percentage);
-#define TIME_PROFILER_PRINT_ITERATION_TIME(show_percentage) PerformanceProfiler::getInstance()->printIterationTime(show_percentage);
+// the entry id of a call site is looked up once and cached in a function-local static
+#define TIME_PROFILER_INIT(profiler, get_time_func, num_threads) (profiler)->initialize(get_time_func, num_threads);
+#define TIME_PROFILER_ADD_ENTRY(profiler, name) (profiler)->addEntry(#name);
+#define TIME_PROFILER_START_ITERATION(profiler) (profiler)->startIteration();
+#define TIME_PROFILER_START_TIMER(profiler, name) \
+    { static const int time_profiler_entry_id = PerformanceProfiler::getEntryId(#name); (profiler)->startTimer(time_profiler_entry_id); }
+#define TIME_PROFILER_END_TIMER(profiler, name) \
+    { static const int time_profiler_entry_id = PerformanceProfiler::getEntryId(#name); (profiler)->endTimer(time_profiler_entry_id); }
+#define TIME_PROFILER_SCOPED_TIMER(profiler, name) \
+    static const int time_profiler_entry_id_##name = PerformanceProfiler::getEntryId(#name); \
+    PerformanceProfiler::ScopedTimer time_profiler_scoped_timer_##name(*(profiler), time_profiler_entry_id_##name);
+#define TIME_PROFILER_PRINT_TOTAL_TIME(profiler, show_percentage) (profiler)->printTotalTime(show_percentage);
+#define TIME_PROFILER_PRINT_ITERATION_TIME(profiler, show_percentage) (profiler)->printIterationTime(show_percentage);
+#define TIME_PROFILER_PRINT_THREAD_UTILIZATION(profiler, name, wall_name) (profiler)->printThreadUtilization(#name, #wall_name);
 #else
-#define TIME_PROFILER_INIT(get_time_func, num_threads)
-#define TIME_PROFILER_ADD_ENTRY(name)
-#define TIME_PROFILER_START_ITERATION
-#define TIME_PROFILER_START_TIMER(name)
-#define TIME_PROFILER_END_TIMER(name)
-#define TIME_PROFILER_PRINT_TOTAL_TIME(show_percentage)
-#define TIME_PROFILER_PRINT_ITERATION_TIME(show_percentage)
+#define TIME_PROFILER_INIT(profiler, get_time_func, num_threads)
+#define TIME_PROFILER_ADD_ENTRY(profiler, name)
+#define TIME_PROFILER_START_ITERATION(profiler)
+#define TIME_PROFILER_START_TIMER(profiler, name)
+#define TIME_PROFILER_END_TIMER(profiler, name)
+#define TIME_PROFILER_SCOPED_TIMER(profiler, name)
+#define TIME_PROFILER_PRINT_TOTAL_TIME(profiler, show_percentage)
+#define TIME_PROFILER_PRINT_ITERATION_TIME(profiler, show_percentage)
+#define TIME_PROFILER_PRINT_THREAD_UTILIZATION(profiler, name, wall_name)
+#endif
+
+// records the timer events of each optimization iteration and writes them as a chrome trace.
+// requires USE_TIME_PROFILER
+//#define USE_TIME_PROFILER_TRACE
+#if defined(USE_TIME_PROFILER) && defined(USE_TIME_PROFILER_TRACE)
+#define TIME_PROFILER_ENABLE_TRACE(profiler, capacity) (profiler)->enableTrace(capacity);
+#define TIME_PROFILER_EXPORT_TRACE(profiler, file_prefix) (profiler)->exportTrace(file_prefix);
+#else
+#define TIME_PROFILER_ENABLE_TRACE(profiler, capacity)
+#define TIME_PROFILER_EXPORT_TRACE(profiler, file_prefix)
 #endif
 
 }
@@ -13,6 +13,8 @@ namespace planner
 class Node;
 }
 
+class NullSpaceProjector;
+
 Eigen::MatrixXd PseudoInverseDLS(const Eigen::MatrixXd& J, double eps);
 void PseudoInverseSVDDLS(const Eigen::MatrixXd& J, const Eigen::JacobiSVD<Eigen::MatrixXd>& svdOfJ, Eigen::MatrixXd& Jinv);
 
@@ -39,8 +41,6 @@ public:
 
 	void  GetNullspace(const Eigen::MatrixXd /*pseudoId*/, Eigen::MatrixXd& /*result*/);
 
-	// temporary
-	static void GetProjection(int point, const Eigen::VectorXd& q, Eigen::VectorXd& a);
     static void projectToNullSpace(const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s);
 
 private:
@@ -65,7 +65,48 @@ private:
 	Eigen::JacobiSVD<Eigen::MatrixXd> svdProduct_;
 
 public:
-	static itomp_cio_planner::NewEvalManager* evaluation_manager_;
+	// set by the thread running the optimization, trials can be optimized in parallel
+	static __thread itomp_cio_planner::NewEvalManager* evaluation_manager_;
+	static __thread NullSpaceProjector* null_space_projector_;
+};
+
+// projects the joint position steps of the trajectory points to the null space of the jacobian of the fixed contacts.
+// the points are projected in parallel, each thread uses its own model and buffers allocated in initialize()
+class NullSpaceProjector
+{
+public:
+    NullSpaceProjector();
+
+    void initialize(const itomp_cio_planner::NewEvalManager* evaluation_manager, int num_threads);
+    // if set, x and s of project() are the active parameters, the others take their values from full_parameters
+    void setActiveParameters(const std::vector<long>* active_parameters, const dlib::matrix<double, 0, 1>* full_parameters);
+    void project(const itomp_cio_planner::NewEvalManager* evaluation_manager,
+                 const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s);
+
+private:
+    struct Workspace
+    {
+        RigidBodyDynamics::Model model;
+        Eigen::VectorXd q;
+        Eigen::VectorXd a;
+        Eigen::MatrixXd G;
+        // transpose of the merged jacobian, qdot_size x (6 * number of bodies)
+        Eigen::MatrixXd jacobian_transpose;
+        Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+        Eigen::VectorXd householder_workspace;
+    };
+
+    void projectFull(const itomp_cio_planner::NewEvalManager* evaluation_manager,
+                     const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s);
+    void projectPoint(Workspace& workspace) const;
+
+    std::vector<Workspace> workspaces_;
+    std::vector<unsigned int> body_ids_;
+
+    const std::vector<long>* active_parameters_;
+    const dlib::matrix<double, 0, 1>* full_parameters_;
+    dlib::matrix<double, 0, 1> full_x_;
+    dlib::matrix<double, 0, 1> full_s_;
 };
 
 inline Eigen::MatrixXd PseudoInverseDLS(const Eigen::MatrixXd& J, double eps)
@@ -3,6 +3,7 @@
 
 #include <itomp_cio_planner/common.h>
 #include <itomp_cio_planner/model/itomp_robot_model.h>
+#include <itomp_cio_planner/trajectory/element_trajectory.h>
 #include <moveit/planning_interface/planning_request.h>
 
 namespace itomp_cio_planner
@@ -16,9 +17,9 @@ sensor_msgs::JointState getGoalStateFromGoalConstraints(
 
 void jointStateToArray(const ItompRobotModelConstPtr& itomp_robot_model,
 					   const sensor_msgs::JointState &joint_state,
-					   Eigen::MatrixXd::RowXpr joint_pos_array,
-					   Eigen::MatrixXd::RowXpr joint_vel_array,
-					   Eigen::MatrixXd::RowXpr joint_acc_array);
+					   ElementTrajectory::Data::RowXpr joint_pos_array,
+					   ElementTrajectory::Data::RowXpr joint_vel_array,
+					   ElementTrajectory::Data::RowXpr joint_acc_array);
 }
 
 #endif
@@ -50,7 +50,7 @@ class MultivariateGaussian
 {
 public:
 	template<typename Derived1, typename Derived2>
-	MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance);
+	MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance, int seed = -1);
 
 	template<typename Derived>
 	void sample(Eigen::MatrixBase<Derived>& output);
@@ -69,7 +69,7 @@ private:
 //////////////////////// template function definitions follow //////////////////////////////
 
 template<typename Derived1, typename Derived2>
-MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance) :
+MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance, int seed) :
 	mean_(mean), covariance_(covariance), covariance_cholesky_(covariance_.llt().matrixL()), normal_dist_(0.0, 1.0)
 {
 
@@ -78,7 +78,8 @@ MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& me
 	//  Eigen::MatrixXd matrix_l = ldlt.matrixL();
 	//  covariance_cholesky_ = (matrix_l.transpose()*ldlt.transpositionsP()).transpose()*diag_sqrt;
 
-	rng_.seed(rand());
+	// a negative seed keeps the shared rand() stream, which is not reproducible across threads
+	rng_.seed(seed < 0 ? rand() : seed);
 	size_ = mean.rows();
 	gaussian_.reset(new boost::variate_generator<boost::mt19937, boost::normal_distribution<> >(rng_, normal_dist_));
 }
@@ -2,60 +2,155 @@
 #define PERFORMANCE_PROFILER_H_
 
 #include <omp.h>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <limits>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/shared_ptr.hpp>
 
 namespace itomp_cio_planner
 {
-class PerformanceProfiler: public Singleton<PerformanceProfiler>
+class PerformanceProfiler
 {
 public:
+	static const int MAX_ENTRIES = 64;
+	static const int CACHE_LINE_SIZE = 64;
+
 	PerformanceProfiler() :
-		num_threads_(1), get_time_func_(NULL)
+		num_threads_(1), get_time_func_(NULL), trace_capacity_(0), iteration_(0),
+		trace_origin_(0.0)
 	{
 	}
 	virtual ~PerformanceProfiler()
 	{
 	}
 
+	// an entry name maps to the same id in every profiler.
+	// the id of a timer macro call site is resolved only once
+	static int getEntryId(const char* entry_name);
+
 	// non thread-safe functions. should be called after omp_set_num_threads()
 	void initialize(double (*get_time_func)(), int num_threads);
-	void addEntry(const char* entry_name);
+	int addEntry(const char* entry_name);
+
+	// record the timer events of each iteration in a ring buffer of capacity events per thread.
+	// 0 disables the recording
+	void enableTrace(int capacity);
 
 	// clear last iteration
 	void startIteration();
 
 	void printIterationTime(bool show_percentage = false);
 	void printTotalTime(bool show_percentage = false);
+	// per-thread time of entry_name in the last iteration relative to the time of wall_entry_name (timed by one thread)
+	void printThreadUtilization(const char* entry_name, const char* wall_entry_name);
+
+	// writes the recorded events of the last iteration in the chrome trace format
+	// (chrome://tracing, perfetto, speedscope) to <file_prefix>_<iteration>.json
+	void exportTrace(const std::string& file_prefix) const;
 
 	// thread-safe functions (in openMP)
-	void startTimer(const char* entry_name);
-	void endTimer(const char* entry_name);
+	void startTimer(int entry_id);
+	void endTimer(int entry_id);
 
-protected:
-	class Entry
+	class ScopedTimer
 	{
 	public:
-		Entry(int num_threads);
-		void initialize(int num_threads);
+		ScopedTimer(PerformanceProfiler& profiler, int entry_id) :
+			profiler_(profiler), entry_id_(entry_id)
+		{
+			profiler_.startTimer(entry_id_);
+		}
+		~ScopedTimer()
+		{
+			profiler_.endTimer(entry_id_);
+		}
+
+	private:
+		PerformanceProfiler& profiler_;
+		int entry_id_;
+	};
 
-		void startIteration();
+protected:
+	struct Accumulator
+	{
+		double timer_start_time_;
+		double iteration_elapsed_;
+		double total_elapsed_;
+	};
 
-		void startTimer(double (*get_time_func)());
-		void endTimer(double (*get_time_func)());
+	struct TraceEvent
+	{
+		int entry_id_;
+		double start_time_;
+		double end_time_;
+	};
 
-		double getTotalElapsed() const;
-		double getIterationElapsed() const;
+	// written only by its own thread. the padding keeps the data of two threads off the same cache line
+	struct ThreadData
+	{
+		char front_padding_[CACHE_LINE_SIZE];
+		Accumulator accumulators_[MAX_ENTRIES];
+		std::vector<TraceEvent> trace_events_;
+		unsigned int num_trace_events_;
+		char back_padding_[CACHE_LINE_SIZE];
+	};
+	typedef boost::shared_ptr<ThreadData> ThreadDataPtr;
 
-		std::vector<double> timer_start_time_;
+	static std::vector<std::string>& getEntryNames();
 
-		std::vector<double> total_elapsed_;
-		std::vector<double> iteration_elpased_;
-	};
-	//double getROSWallTime();
+	double getIterationElapsed(int entry_id) const;
+	double getTotalElapsed(int entry_id) const;
+	void printTime(bool iteration, bool show_percentage) const;
 
-	std::map<std::string, Entry> entries_;
+	std::map<std::string, int> entries_;
+	std::vector<ThreadDataPtr> thread_data_;
 	int num_threads_;
 	double (*get_time_func_)();
+
+	int trace_capacity_;
+	int iteration_;
+	double trace_origin_;
 };
+typedef boost::shared_ptr<PerformanceProfiler> PerformanceProfilerPtr;
+
+inline std::vector<std::string>& PerformanceProfiler::getEntryNames()
+{
+	static std::vector<std::string> entry_names;
+	return entry_names;
+}
+
+inline int PerformanceProfiler::getEntryId(const char* entry_name)
+{
+	int entry_id = -1;
+	#pragma omp critical (performance_profiler_entry_id)
+	{
+		std::vector<std::string>& entry_names = getEntryNames();
+		for (int i = 0; i < entry_names.size(); ++i)
+		{
+			if (entry_names[i] == entry_name)
+			{
+				entry_id = i;
+				break;
+			}
+		}
+		if (entry_id == -1)
+		{
+			if (entry_names.size() < MAX_ENTRIES)
+			{
+				entry_id = entry_names.size();
+				entry_names.push_back(entry_name);
+			}
+			else
+				std::cerr << "PerformanceProfiler : too many entries. " << entry_name << " is ignored" << std::endl;
+		}
+	}
+	return entry_id;
+}
 
 inline void PerformanceProfiler::initialize(double (*get_time_func)(), int num_threads)
 {
@@ -63,119 +158,192 @@ inline void PerformanceProfiler::initialize(double (*get_time_func)(), int num_t
 
 	// omp_get_num_threads doesn't work
 	num_threads_ = num_threads;//omp_get_num_threads();
-	for (std::map<std::string, Entry>::iterator it = entries_.begin();
-			it != entries_.end(); ++it)
-		it->second.initialize(num_threads_);
+	thread_data_.resize(num_threads_);
+	for (int i = 0; i < num_threads_; ++i)
+	{
+		if (!thread_data_[i])
+		{
+			thread_data_[i].reset(new ThreadData());
+			thread_data_[i]->num_trace_events_ = 0;
+		}
+		for (int j = 0; j < MAX_ENTRIES; ++j)
+		{
+			Accumulator& accumulator = thread_data_[i]->accumulators_[j];
+			accumulator.timer_start_time_ = accumulator.iteration_elapsed_ = accumulator.total_elapsed_ = 0.0;
+		}
+	}
+	enableTrace(trace_capacity_);
+}
+
+inline int PerformanceProfiler::addEntry(const char* entry_name)
+{
+	int entry_id = getEntryId(entry_name);
+	if (entry_id >= 0)
+		entries_.insert(std::make_pair(entry_name, entry_id));
+	return entry_id;
 }
 
-inline void PerformanceProfiler::addEntry(const char* entry_name)
+inline void PerformanceProfiler::enableTrace(int capacity)
 {
-	entries_.insert(std::make_pair(entry_name, Entry(num_threads_)));
+	trace_capacity_ = capacity;
+	for (int i = 0; i < thread_data_.size(); ++i)
+	{
+		thread_data_[i]->trace_events_.resize(trace_capacity_);
+		thread_data_[i]->num_trace_events_ = 0;
+	}
 }
 
 inline void PerformanceProfiler::startIteration()
 {
-	for (std::map<std::string, Entry>::iterator it = entries_.begin();
-			it != entries_.end(); ++it)
+	for (int i = 0; i < thread_data_.size(); ++i)
 	{
-		it->second.startIteration();
+		for (int j = 0; j < MAX_ENTRIES; ++j)
+			thread_data_[i]->accumulators_[j].iteration_elapsed_ = 0.0;
+		thread_data_[i]->num_trace_events_ = 0;
 	}
+
+	if (iteration_++ == 0 && get_time_func_ != NULL)
+		trace_origin_ = (*get_time_func_)();
 }
 
 inline void PerformanceProfiler::printIterationTime(bool show_percentage)
 {
     std::cout << "Elapsed Time\n";
-    std::cout.precision(std::numeric_limits<double>::digits10);
-
-	double sum = 0.0;
-	for (std::map<std::string, Entry>::iterator it = entries_.begin();
-			it != entries_.end(); ++it)
-	{
-        double elapsed = it->second.getIterationElapsed();
-        std::cout << it->first << " : " << std::fixed << elapsed << std::endl;
-        sum += elapsed;
-	}
+    printTime(true, show_percentage);
 }
 
 inline void PerformanceProfiler::printTotalTime(bool show_percentage)
 {
     std::cout << "Total Elapsed Time\n";
-    std::cout.precision(std::numeric_limits<double>::digits10);
+    printTime(false, show_percentage);
+}
 
-	double sum = 0.0;
-	for (std::map<std::string, Entry>::iterator it = entries_.begin();
-			it != entries_.end(); ++it)
+inline void PerformanceProfiler::printThreadUtilization(const char* entry_name, const char* wall_entry_name)
+{
+	int entry_id = getEntryId(entry_name);
+	int wall_entry_id = getEntryId(wall_entry_name);
+	if (entry_id < 0 || wall_entry_id < 0)
+		return;
+
+	double wall_time = getIterationElapsed(wall_entry_id);
+	std::cout << entry_name << " utilization\n";
+	std::ios::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision(3);
+	for (int i = 0; i < thread_data_.size(); ++i)
 	{
-        double elapsed = it->second.getTotalElapsed();
-        std::cout << it->first << " : " << std::fixed << elapsed << std::endl;
-        sum += elapsed;
+		double elapsed = thread_data_[i]->accumulators_[entry_id].iteration_elapsed_;
+		std::cout << "thread " << i << " : " << std::fixed << elapsed << " ("
+				  << (wall_time > 0.0 ? 100.0 * elapsed / wall_time : 0.0) << "%)" << std::endl;
 	}
+	std::cout.flags(flags);
+	std::cout.precision(precision);
 }
 
-// thread-safe
-inline void PerformanceProfiler::startTimer(const char* entry_name)
+inline void PerformanceProfiler::printTime(bool iteration, bool show_percentage) const
 {
-	entries_.find(entry_name)->second.startTimer(get_time_func_);
-}
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision(std::numeric_limits<double>::digits10);
 
-inline void PerformanceProfiler::endTimer(const char* entry_name)
-{
-	entries_.find(entry_name)->second.endTimer(get_time_func_);
-}
+	// percentages are relative to the sum of the entries
+	double sum = 0.0;
+	for (std::map<std::string, int>::const_iterator it = entries_.begin();
+			it != entries_.end(); ++it)
+		sum += iteration ? getIterationElapsed(it->second) : getTotalElapsed(it->second);
 
-/*
-inline double PerformanceProfiler::getROSWallTime()
-{
-	return ros::WallTime::now().toSec();
+	for (std::map<std::string, int>::const_iterator it = entries_.begin();
+			it != entries_.end(); ++it)
+	{
+        double elapsed = iteration ? getIterationElapsed(it->second) : getTotalElapsed(it->second);
+        std::cout << it->first << " : " << std::fixed << elapsed;
+        if (show_percentage)
+            std::cout << " (" << (sum > 0.0 ? 100.0 * elapsed / sum : 0.0) << "%)";
+        std::cout << std::endl;
+	}
+    std::cout.flags(flags);
+    std::cout.precision(precision);
 }
-*/
 
-////////////////////////////////////////////////////////////////////////////////
-inline PerformanceProfiler::Entry::Entry(int num_threads)
+inline void PerformanceProfiler::exportTrace(const std::string& file_prefix) const
 {
-	initialize(num_threads);
-}
+	std::stringstream file_name;
+	file_name << file_prefix << "_" << iteration_ << ".json";
+	std::ofstream trace_file(file_name.str().c_str());
+	if (!trace_file.is_open())
+	{
+		std::cerr << "PerformanceProfiler : could not open " << file_name.str() << std::endl;
+		return;
+	}
 
-inline void PerformanceProfiler::Entry::initialize(int num_threads)
-{
-	timer_start_time_.resize(num_threads, 0.0);
-	total_elapsed_.resize(num_threads, 0.0);
-	iteration_elpased_.resize(num_threads, 0.0);
-}
+	const std::vector<std::string>& entry_names = getEntryNames();
 
-inline void PerformanceProfiler::Entry::startIteration()
-{
-	for (int i = 0; i < iteration_elpased_.size(); ++i)
-		iteration_elpased_[i] = 0.0;
+	trace_file.precision(3);
+	trace_file << std::fixed << "{\"traceEvents\":[";
+	bool first = true;
+	for (int i = 0; i < thread_data_.size(); ++i)
+	{
+		const ThreadData& thread_data = *thread_data_[i];
+
+		// the oldest events were overwritten if the ring buffer wrapped around
+		unsigned int num_events = std::min<unsigned int>(thread_data.num_trace_events_, trace_capacity_);
+		unsigned int begin = thread_data.num_trace_events_ - num_events;
+		for (unsigned int j = begin; j < thread_data.num_trace_events_; ++j)
+		{
+			const TraceEvent& event = thread_data.trace_events_[j % trace_capacity_];
+			trace_file << (first ? "\n" : ",\n");
+			trace_file << "{\"name\":\"" << entry_names[event.entry_id_] << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << i
+					   << ",\"ts\":" << (event.start_time_ - trace_origin_) * 1e6
+					   << ",\"dur\":" << (event.end_time_ - event.start_time_) * 1e6 << "}";
+			first = false;
+		}
+	}
+	trace_file << "\n],\"displayTimeUnit\":\"ms\"}\n";
 }
 
-inline void PerformanceProfiler::Entry::startTimer(double (*get_time_func)())
+// thread-safe
+inline void PerformanceProfiler::startTimer(int entry_id)
 {
 	int thread_index = omp_get_thread_num();
-	timer_start_time_[thread_index] = (*get_time_func)();
+	if (entry_id < 0 || thread_index >= thread_data_.size())
+		return;
+
+	thread_data_[thread_index]->accumulators_[entry_id].timer_start_time_ = (*get_time_func_)();
 }
 
-inline void PerformanceProfiler::Entry::endTimer(double (*get_time_func)())
+inline void PerformanceProfiler::endTimer(int entry_id)
 {
 	int thread_index = omp_get_thread_num();
-	double elapsed = (*get_time_func)() - timer_start_time_[thread_index];
-	iteration_elpased_[thread_index] += elapsed;
-	total_elapsed_[thread_index] += elapsed;
+	if (entry_id < 0 || thread_index >= thread_data_.size())
+		return;
+
+	ThreadData& thread_data = *thread_data_[thread_index];
+	Accumulator& accumulator = thread_data.accumulators_[entry_id];
+	double end_time = (*get_time_func_)();
+	double elapsed = end_time - accumulator.timer_start_time_;
+	accumulator.iteration_elapsed_ += elapsed;
+	accumulator.total_elapsed_ += elapsed;
+
+	if (trace_capacity_ > 0)
+	{
+		TraceEvent& event = thread_data.trace_events_[thread_data.num_trace_events_++ % trace_capacity_];
+		event.entry_id_ = entry_id;
+		event.start_time_ = accumulator.timer_start_time_;
+		event.end_time_ = end_time;
+	}
 }
 
-inline double PerformanceProfiler::Entry::getTotalElapsed() const
+inline double PerformanceProfiler::getIterationElapsed(int entry_id) const
 {
 	double sum = 0.0;
-	for (int i = 0; i < total_elapsed_.size(); ++i)
-		sum += total_elapsed_[i];
+	for (int i = 0; i < thread_data_.size(); ++i)
+		sum += thread_data_[i]->accumulators_[entry_id].iteration_elapsed_;
 	return sum;
 }
 
-inline double PerformanceProfiler::Entry::getIterationElapsed() const
+inline double PerformanceProfiler::getTotalElapsed(int entry_id) const
 {
 	double sum = 0.0;
-	for (int i = 0; i < iteration_elpased_.size(); ++i)
-		sum += iteration_elpased_[i];
+	for (int i = 0; i < thread_data_.size(); ++i)
+		sum += thread_data_[i]->accumulators_[entry_id].total_elapsed_;
 	return sum;
 }
 
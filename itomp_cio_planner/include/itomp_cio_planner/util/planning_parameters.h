@@ -10,16 +10,35 @@
 
 #include <itomp_cio_planner/common.h>
 
+namespace XmlRpc
+{
+class XmlRpcValue;
+}
+
 namespace itomp_cio_planner
 {
 
 class PlanningParameters: public Singleton<PlanningParameters>
 {
 public:
+    enum DERIVATIVE_MODE
+    {
+        DERIVATIVE_MODE_FD = 0,     // central finite differences for all costs
+        DERIVATIVE_MODE_ANALYTIC,   // analytic derivatives if available, finite differences otherwise
+    };
+    enum OBSTACLE_COST_TYPE
+    {
+        OBSTACLE_COST_TYPE_FCL = 0,         // penetration depths of fcl world and self collision contacts
+        OBSTACLE_COST_TYPE_DISTANCE_FIELD,  // link spheres against a distance field of the static world
+    };
+
 	PlanningParameters();
 	virtual ~PlanningParameters();
 
 	void initFromNodeHandle();
+	// reads the parameters from a struct with the keys of the parameter server,
+	// e.g. to run the planner without a ros master
+	void initFromParameters(const XmlRpc::XmlRpcValue& parameters);
 	int getUpdateIndex() const;
 
 	void setTrajectoryDuration(double trajectory_duration);
@@ -52,9 +71,13 @@ public:
 	std::vector<double> getSmoothnessCosts() const;
 	double getRidgeFactor() const;
 	bool getAnimateEndeffector() const;
+	double getVisualizationMaxRate() const;
+	bool getWriteCheckpoints() const;
+	std::string getRestoreCheckpoint() const;
 	const std::multimap<std::string, std::string>& getGroupEndeffectorNames() const;
 	int getNumTrajectories() const;
 	int getNumTrials() const;
+	bool getUseParallelTrials() const;
 	int getNumRollouts() const;
 	int getNumReusedRollouts() const;
 	double getNoiseStddev() const;
@@ -120,7 +143,20 @@ public:
 
     double getPassiveForceRatio() const;
 
+    DERIVATIVE_MODE getDerivativeMode() const;
+    bool getValidateDerivatives() const;
+
+    OBSTACLE_COST_TYPE getObstacleCostType() const;
+    double getDistanceFieldResolution() const;
+    double getDistanceFieldMargin() const;
+
+    int getWarmStartCacheSize() const;
+    double getWarmStartMaxDistance() const;
+    int getWarmStartPhase() const;
+
 private:
+	void initialize(const XmlRpc::XmlRpcValue* parameters);
+
 	int updateIndex;
 	double trajectory_duration_;
 	double trajectory_discretization_;
@@ -148,6 +184,9 @@ private:
 	double smoothness_cost_jerk_;
 	double ridge_factor_;
 	bool animate_endeffector_;
+	double visualization_max_rate_;
+	bool write_checkpoints_;
+	std::string restore_checkpoint_;
 	std::multimap<std::string, std::string> group_endeffector_names_;
 	std::map<std::string, std::vector<std::string> > contact_points_;
 	int num_trajectories_;
@@ -167,6 +206,7 @@ private:
 	std::vector<double> contact_variable_goal_values_;
 
 	int num_trials_;
+	bool use_parallel_trials_;
 
 	int num_rollouts_;
 	int num_reused_rollouts_;
@@ -198,6 +238,17 @@ private:
 
     double passive_force_ratio_;
 
+    DERIVATIVE_MODE derivative_mode_;
+    bool validate_derivatives_;
+
+    OBSTACLE_COST_TYPE obstacle_cost_type_;
+    double distance_field_resolution_;
+    double distance_field_margin_;
+
+    int warm_start_cache_size_;
+    double warm_start_max_distance_;
+    int warm_start_phase_;
+
 	friend class Singleton<PlanningParameters> ;
 };
 
@@ -323,6 +374,21 @@ inline bool PlanningParameters::getAnimateEndeffector() const
 	return animate_endeffector_;
 }
 
+inline double PlanningParameters::getVisualizationMaxRate() const
+{
+	return visualization_max_rate_;
+}
+
+inline bool PlanningParameters::getWriteCheckpoints() const
+{
+	return write_checkpoints_;
+}
+
+inline std::string PlanningParameters::getRestoreCheckpoint() const
+{
+	return restore_checkpoint_;
+}
+
 inline const std::multimap<std::string, std::string>& PlanningParameters::getGroupEndeffectorNames() const
 {
 	return group_endeffector_names_;
@@ -372,6 +438,11 @@ inline int PlanningParameters::getNumTrials() const
 	return num_trials_;
 }
 
+inline bool PlanningParameters::getUseParallelTrials() const
+{
+	return use_parallel_trials_;
+}
+
 inline int PlanningParameters::getNumContacts() const
 {
 	return num_contacts_;
@@ -492,5 +563,45 @@ inline double PlanningParameters::getPassiveForceRatio() const
     return passive_force_ratio_;
 }
 
+inline PlanningParameters::DERIVATIVE_MODE PlanningParameters::getDerivativeMode() const
+{
+    return derivative_mode_;
+}
+
+inline bool PlanningParameters::getValidateDerivatives() const
+{
+    return validate_derivatives_;
+}
+
+inline PlanningParameters::OBSTACLE_COST_TYPE PlanningParameters::getObstacleCostType() const
+{
+    return obstacle_cost_type_;
+}
+
+inline double PlanningParameters::getDistanceFieldResolution() const
+{
+    return distance_field_resolution_;
+}
+
+inline double PlanningParameters::getDistanceFieldMargin() const
+{
+    return distance_field_margin_;
+}
+
+inline int PlanningParameters::getWarmStartCacheSize() const
+{
+    return warm_start_cache_size_;
+}
+
+inline double PlanningParameters::getWarmStartMaxDistance() const
+{
+    return warm_start_max_distance_;
+}
+
+inline int PlanningParameters::getWarmStartPhase() const
+{
+    return warm_start_phase_;
+}
+
 }
 #endif /* PLANNINGPARAMETERS_H_ */
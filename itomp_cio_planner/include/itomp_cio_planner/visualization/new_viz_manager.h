@@ -8,6 +8,7 @@
 #include <moveit/robot_state/robot_state.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <ros/publisher.h>
+#include <boost/thread.hpp>
 
 namespace itomp_cio_planner
 {
@@ -18,12 +19,31 @@ public:
 	{
 		BLACK = 0, BLUE, GREEN, CYAN, RED, MAGENTA, YELLOW, WHITE,
 	};
+	// snapshot of an evaluation manager rendered by the visualization thread
+	struct RenderRequest
+	{
+		ItompTrajectoryPtr trajectory_;
+		robot_state::RobotStatePtr robot_state_;
+		std::vector<std::vector<ContactVariables> > contact_variables_;
+		std::vector<RigidBodyDynamics::Model> models_;
+		bool is_best_;
+		bool animate_path_;
+		bool animate_endeffector_;
+	};
+	typedef boost::shared_ptr<RenderRequest> RenderRequestPtr;
+
 	NewVizManager();
 	virtual ~NewVizManager();
 
 	void initialize(const ItompRobotModelConstPtr& robot_model);
 	void setPlanningGroup(const ItompPlanningGroupConstPtr& planning_group);
 
+	// returns false if a render request is not accepted now (limited by visualization_max_rate).
+	// force always accepts the request
+	bool acceptRenderRequest(bool force);
+	// replaces the request waiting for the visualization thread, if any
+	void requestRender(const RenderRequestPtr& request);
+
     void animateEndeffectors(const ItompTrajectoryConstPtr& trajectory,
 							 const std::vector<RigidBodyDynamics::Model>& models, bool is_best);
     void animatePath(const ItompTrajectoryConstPtr& trajectory,
@@ -42,6 +62,10 @@ public:
 	ros::Publisher& getVisualizationMarkerArrayPublisher();
 
 private:
+    void render(RenderRequest& request);
+    void renderThread();
+    void stopRenderThread();
+
     void setPointMarker(visualization_msgs::Marker& marker, unsigned int id, const Eigen::Vector3d& pos, const visualization_msgs::Marker::_color_type& color, double color_scale = 1.0);
     void setLineMarker(visualization_msgs::Marker& marker, unsigned int id, const Eigen::Vector3d& pos1, const Eigen::Vector3d& pos2, const visualization_msgs::Marker::_color_type& color, double color_scale = 1.0);
 
@@ -57,6 +81,14 @@ private:
 	std::string reference_frame_;
 	std::vector<unsigned int> endeffector_rbdl_indices_;
 	std::vector<visualization_msgs::Marker::_color_type> colors_;
+
+	// the latest render request is rendered, older ones are dropped
+	boost::thread render_thread_;
+	boost::mutex render_mutex_;
+	boost::condition_variable render_condition_;
+	RenderRequestPtr pending_render_request_;
+	ros::WallTime last_render_request_time_;
+	bool stop_render_thread_;
 };
 
 }
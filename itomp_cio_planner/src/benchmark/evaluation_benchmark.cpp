@@ -0,0 +1,510 @@
+// benchmark of the trajectory evaluation pipeline.
+// runs without a ros master and rviz : the robot is loaded from the urdf/srdf files of
+// human_description / human_moveit_generated and the planner parameters are set below,
+// so the results are reproducible between releases. the results are written as json.
+//
+// usage : itomp_benchmark [-o output.json] [-r repetitions] [-t max_threads] [-d]
+//   -o : output file, '-' for stdout (default : itomp_benchmark.json)
+//   -r : timed repetitions of each benchmark (default : 10)
+//   -t : maximum number of threads (default : number of processors)
+//   -d : use the distance field backend for the obstacle cost
+
+#include <itomp_cio_planner/model/itomp_robot_model.h>
+#include <itomp_cio_planner/model/itomp_planning_group.h>
+#include <itomp_cio_planner/model/rbdl_model_util.h>
+#include <itomp_cio_planner/trajectory/trajectory_factory.h>
+#include <itomp_cio_planner/optimization/new_eval_manager.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
+#include <itomp_cio_planner/contact/ground_manager.h>
+#include <itomp_cio_planner/cost/trajectory_cost.h>
+#include <itomp_cio_planner/util/planning_parameters.h>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <geometric_shapes/shape_operations.h>
+#include <urdf_parser/urdf_parser.h>
+#include <srdfdom/model.h>
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <XmlRpcValue.h>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <omp.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace itomp_cio_planner;
+
+namespace
+{
+
+const char* PLANNING_GROUP = "lower_body";
+const char* CONTACT_MODEL = "package://move_itomp/meshes/merged_empty.dae";
+const double TRAJECTORY_DISCRETIZATION = 0.05;
+const double KEYFRAME_DURATION = 0.25;
+// phase of the last optimization step, which has the most active parameters
+const int BENCHMARK_PHASE = 4;
+const int BENCHMARK_NUM_POINTS[] = { 21, 41, 81, 161 };
+
+struct BenchmarkResult
+{
+    std::string name_;
+    int num_points_;
+    int num_threads_;
+    std::vector<double> times_; // in seconds
+};
+
+struct BenchmarkScene
+{
+    ItompRobotModelPtr robot_model_;
+    planning_scene::PlanningScenePtr planning_scene_;
+    ItompPlanningGroupConstPtr planning_group_;
+    PlanningContextPtr planning_context_;
+    ItompTrajectoryPtr trajectory_;
+    NewEvalManagerPtr evaluation_manager_;
+};
+
+bool readFile(const std::string& file_name, std::string& contents)
+{
+    std::ifstream file(file_name.c_str());
+    if (!file.is_open())
+    {
+        ROS_ERROR("Could not open %s", file_name.c_str());
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return true;
+}
+
+void setPlanningParameters(bool use_distance_field)
+{
+    XmlRpc::XmlRpcValue parameters;
+
+    parameters["print_planning_info"] = false;
+    parameters["animate_path"] = false;
+    parameters["animate_endeffector"] = false;
+
+    parameters["trajectory_discretization"] = TRAJECTORY_DISCRETIZATION;
+    parameters["keyframe_duration"] = KEYFRAME_DURATION;
+
+    parameters["smoothness_cost_weight"] = 0.0001;
+    parameters["obstacle_cost_weight"] = 1.0;
+    parameters["contact_invariant_cost_weight"] = 1.0;
+    parameters["physics_violation_cost_weight"] = 0.1;
+    parameters["FTR_cost_weight"] = 0.0;
+    parameters["obstacle_cost_type"] = std::string(use_distance_field ? "distance_field" : "fcl");
+
+    parameters["temp"][0] = 1000.0;
+    parameters["temp"][1] = 1000.0;
+    parameters["temp"][2] = 0.0;
+
+    const char* endeffectors[] = { "left_foot", "right_foot" };
+    parameters["num_contacts"] = 2;
+    for (int i = 0; i < 2; ++i)
+    {
+        std::string endeffector_link = std::string(endeffectors[i]) + "_endeffector_link";
+        parameters["group_endeffectors"][PLANNING_GROUP][i] = endeffector_link;
+        for (int j = 0; j < NUM_ENDEFFECTOR_CONTACT_POINTS; ++j)
+        {
+            std::stringstream contact_point_link;
+            contact_point_link << endeffectors[i] << "_cp_" << (j + 1) << "_link";
+            parameters["contact_points"][endeffector_link][j] = contact_point_link.str();
+        }
+        parameters["contact_variable_initial_values"][i] = 0.2;
+        parameters["contact_variable_goal_values"][i] = 0.2;
+    }
+    parameters["lower_body_root"] = std::string("pelvis_link");
+
+    parameters["contact_model"] = std::string(CONTACT_MODEL);
+    parameters["contact_model_position"][0] = 0.0;
+    parameters["contact_model_position"][1] = 0.0;
+    parameters["contact_model_position"][2] = -0.05;
+    parameters["contact_model_scale"] = 1.0;
+
+    PlanningParameters::getInstance()->initFromParameters(parameters);
+}
+
+robot_model::RobotModelPtr loadRobotModel(std::string& urdf_string)
+{
+    std::string srdf_string;
+    if (!readFile(ros::package::getPath("human_description") + "/robots/human_cio.urdf", urdf_string) ||
+            !readFile(ros::package::getPath("human_moveit_generated") + "/config/human_cio.srdf", srdf_string))
+        return robot_model::RobotModelPtr();
+
+    boost::shared_ptr<urdf::ModelInterface> urdf_model = urdf::parseURDF(urdf_string);
+    if (!urdf_model)
+        return robot_model::RobotModelPtr();
+    boost::shared_ptr<srdf::Model> srdf_model(new srdf::Model());
+    if (!srdf_model->initString(*urdf_model, srdf_string))
+        return robot_model::RobotModelPtr();
+
+    return robot_model::RobotModelPtr(new robot_model::RobotModel(urdf_model, srdf_model));
+}
+
+// the contact mesh is also the obstacle of the scene
+bool addContactModelToWorld(const planning_scene::PlanningScenePtr& planning_scene)
+{
+    const std::vector<double>& position = PlanningParameters::getInstance()->getContactModelPosition();
+    double scale = PlanningParameters::getInstance()->getContactModelScale();
+
+    shapes::Mesh* mesh = shapes::createMeshFromResource(PlanningParameters::getInstance()->getContactModel(),
+                         Eigen::Vector3d(scale, scale, scale));
+    if (mesh == NULL)
+    {
+        ROS_ERROR("Could not load %s", PlanningParameters::getInstance()->getContactModel().c_str());
+        return false;
+    }
+
+    Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+    pose.translation() = Eigen::Vector3d(position[0], position[1], position[2]);
+    planning_scene->getWorldNonConst()->addToObject("contact_model", shapes::ShapeConstPtr(mesh), pose);
+    return true;
+}
+
+sensor_msgs::JointState robotStateToJointState(const robot_state::RobotState& robot_state)
+{
+    sensor_msgs::JointState joint_state;
+    joint_state.name = robot_state.getVariableNames();
+    joint_state.position.assign(robot_state.getVariablePositions(),
+                                robot_state.getVariablePositions() + robot_state.getVariableCount());
+    return joint_state;
+}
+
+// walking forward by 1m
+void createScene(BenchmarkScene& scene, int num_points)
+{
+    double duration = (num_points - 1) * TRAJECTORY_DISCRETIZATION;
+    PlanningParameters::getInstance()->setTrajectoryDuration(duration);
+
+    scene.trajectory_.reset(TrajectoryFactory::getInstance()->CreateItompTrajectory(scene.robot_model_,
+                            duration, TRAJECTORY_DISCRETIZATION, KEYFRAME_DURATION));
+
+    robot_state::RobotState start_state(scene.robot_model_->getMoveitRobotModel());
+    start_state.setToDefaultValues();
+    start_state.update(true);
+    robot_state::RobotState goal_state(start_state);
+    goal_state.setVariablePosition("base_prismatic_joint_y", start_state.getVariablePosition("base_prismatic_joint_y") + 1.0);
+    goal_state.update(true);
+
+    scene.trajectory_->setStartState(robotStateToJointState(start_state), scene.robot_model_);
+    scene.trajectory_->setGoalState(robotStateToJointState(goal_state), scene.planning_group_, scene.robot_model_,
+                                    moveit_msgs::TrajectoryConstraints());
+
+    scene.planning_context_ = boost::make_shared<PlanningContext>(0, false);
+    scene.evaluation_manager_ = boost::make_shared<NewEvalManager>();
+    scene.evaluation_manager_->initialize(scene.planning_context_, scene.trajectory_, scene.robot_model_,
+                                          scene.planning_scene_, scene.planning_group_, 0.0, 0.0,
+                                          std::vector<moveit_msgs::Constraints>());
+    scene.planning_context_->getPhaseManager()->init(num_points, scene.planning_group_);
+    scene.planning_context_->getPhaseManager()->setPhase(BENCHMARK_PHASE);
+    scene.evaluation_manager_->evaluate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// benchmarks. operator() runs a single repetition
+
+class EvaluateBenchmark
+{
+public:
+    EvaluateBenchmark(const BenchmarkScene& scene)
+        : evaluation_manager_(scene.evaluation_manager_)
+    {
+    }
+    void operator()()
+    {
+        // marks all points to be re-evaluated
+        evaluation_manager_->getTrajectoryNonConst();
+        evaluation_manager_->evaluate();
+    }
+
+private:
+    NewEvalManagerPtr evaluation_manager_;
+};
+
+// same as ImprovementManagerNLP::derivative
+class DerivativeBenchmark
+{
+public:
+    DerivativeBenchmark(const BenchmarkScene& scene, int num_threads)
+    {
+        scene.evaluation_manager_->getParameters(parameters_);
+        derivatives_.resize(parameters_.size());
+        derivative_evaluation_managers_.resize(num_threads);
+        for (int i = 0; i < num_threads; ++i)
+            derivative_evaluation_managers_[i].reset(scene.evaluation_manager_->createDerivativeEvaluationManager());
+    }
+    void operator()()
+    {
+        #pragma omp parallel for
+        for (int i = 0; i < derivative_evaluation_managers_.size(); ++i)
+            derivative_evaluation_managers_[i]->setParameters(parameters_);
+
+        #pragma omp parallel for
+        for (int i = 0; i < parameters_.size(); ++i)
+            derivative_evaluation_managers_[omp_get_thread_num()]->computeDerivatives(i, parameters_, &derivatives_[0], ITOMP_EPS);
+    }
+
+private:
+    ItompTrajectory::ParameterVector parameters_;
+    std::vector<double> derivatives_;
+    std::vector<NewEvalManagerPtr> derivative_evaluation_managers_;
+};
+
+class KinematicsAndDynamicsBenchmark
+{
+public:
+    KinematicsAndDynamicsBenchmark(const BenchmarkScene& scene)
+    {
+        int num_points = scene.trajectory_->getNumPoints();
+        models_.resize(num_points, scene.robot_model_->getRBDLRobotModel());
+        q_ = scene.trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getData();
+        q_dot_ = scene.trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
+                 ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getData();
+        q_ddot_ = scene.trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
+                  ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getData();
+        tau_.resize(num_points, Eigen::VectorXd(q_.cols()));
+    }
+    void operator()()
+    {
+        #pragma omp parallel for
+        for (int point = 0; point < models_.size(); ++point)
+        {
+            Eigen::VectorXd q = q_.row(point);
+            Eigen::VectorXd q_dot = q_dot_.row(point);
+            Eigen::VectorXd q_ddot = q_ddot_.row(point);
+            updateFullKinematicsAndDynamics(models_[point], q, q_dot, q_ddot, tau_[point], NULL, NULL);
+        }
+    }
+
+private:
+    std::vector<RigidBodyDynamics::Model> models_;
+    Eigen::MatrixXd q_;
+    Eigen::MatrixXd q_dot_;
+    Eigen::MatrixXd q_ddot_;
+    std::vector<Eigen::VectorXd> tau_;
+};
+
+// a query for each contact point of the trajectory
+class NearestContactPositionBenchmark
+{
+public:
+    NearestContactPositionBenchmark(const BenchmarkScene& scene)
+    {
+        int num_queries = scene.trajectory_->getNumPoints() * scene.planning_group_->getNumContacts() * NUM_ENDEFFECTOR_CONTACT_POINTS;
+
+        // fixed seed for reproducible queries
+        boost::mt19937 rng(0);
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_xy(rng, boost::uniform_real<>(-1.0, 1.0));
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_z(rng, boost::uniform_real<>(0.0, 0.5));
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_angle(rng, boost::uniform_real<>(-0.3, 0.3));
+
+        positions_.resize(num_queries);
+        orientations_.resize(num_queries);
+        for (int i = 0; i < num_queries; ++i)
+        {
+            positions_[i] = Eigen::Vector3d(random_xy(), random_xy(), random_z());
+            orientations_[i] = Eigen::Vector3d(random_angle(), random_angle(), random_angle());
+        }
+    }
+    void operator()()
+    {
+        #pragma omp parallel for
+        for (int i = 0; i < positions_.size(); ++i)
+        {
+            Eigen::Vector3d position_out, orientation_out, normal;
+            GroundManager::getInstance()->getNearestContactPosition(positions_[i], orientations_[i],
+                    position_out, orientation_out, normal);
+        }
+    }
+
+private:
+    std::vector<Eigen::Vector3d> positions_;
+    std::vector<Eigen::Vector3d> orientations_;
+};
+
+// each thread uses its own copy of the evaluation manager, as the collision queries are not thread-safe
+class ObstacleCostBenchmark
+{
+public:
+    ObstacleCostBenchmark(const BenchmarkScene& scene, int num_threads)
+        : num_points_(scene.trajectory_->getNumPoints())
+    {
+        evaluation_managers_.resize(num_threads);
+        for (int i = 0; i < num_threads; ++i)
+            evaluation_managers_[i] = boost::make_shared<NewEvalManager>(*scene.evaluation_manager_);
+        cost_ = boost::make_shared<TrajectoryCostObstacle>(0, "Obstacle", 1.0, scene.evaluation_manager_.get());
+    }
+    void operator()()
+    {
+        for (int i = 0; i < evaluation_managers_.size(); ++i)
+            cost_->preEvaluate(evaluation_managers_[i].get());
+
+        #pragma omp parallel for
+        for (int point = 0; point < num_points_; ++point)
+        {
+            double cost;
+            cost_->evaluate(evaluation_managers_[omp_get_thread_num()].get(), point, cost);
+        }
+
+        for (int i = 0; i < evaluation_managers_.size(); ++i)
+            cost_->postEvaluate(evaluation_managers_[i].get());
+    }
+
+private:
+    int num_points_;
+    std::vector<NewEvalManagerPtr> evaluation_managers_;
+    TrajectoryCostPtr cost_;
+};
+
+template<typename Benchmark>
+void runBenchmark(const std::string& name, Benchmark benchmark, int num_points, int num_threads, int repetitions,
+                  std::vector<BenchmarkResult>& results)
+{
+    BenchmarkResult result;
+    result.name_ = name;
+    result.num_points_ = num_points;
+    result.num_threads_ = num_threads;
+
+    // warm up
+    benchmark();
+    for (int i = 0; i < repetitions; ++i)
+    {
+        double start_time = omp_get_wtime();
+        benchmark();
+        result.times_.push_back(omp_get_wtime() - start_time);
+    }
+
+    ROS_INFO("%s (%d points, %d threads) : %f ms", name.c_str(), num_points, num_threads,
+             1000.0 * *std::min_element(result.times_.begin(), result.times_.end()));
+    results.push_back(result);
+}
+
+void writeResults(FILE* file, const std::vector<BenchmarkResult>& results, int repetitions, bool use_distance_field)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"robot\": \"human_cio\",\n");
+    fprintf(file, "  \"planning_group\": \"%s\",\n", PLANNING_GROUP);
+    fprintf(file, "  \"contact_model\": \"%s\",\n", CONTACT_MODEL);
+    fprintf(file, "  \"obstacle_cost_type\": \"%s\",\n", use_distance_field ? "distance_field" : "fcl");
+    fprintf(file, "  \"num_processors\": %d,\n", omp_get_num_procs());
+    fprintf(file, "  \"repetitions\": %d,\n", repetitions);
+    fprintf(file, "  \"results\": [\n");
+    for (int i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        std::vector<double> times = result.times_;
+        std::sort(times.begin(), times.end());
+        double sum = 0.0;
+        for (int j = 0; j < times.size(); ++j)
+            sum += times[j];
+
+        fprintf(file, "    {\"name\": \"%s\", \"num_points\": %d, \"num_threads\": %d, "
+                "\"min_ms\": %.6f, \"median_ms\": %.6f, \"mean_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+                result.name_.c_str(), result.num_points_, result.num_threads_,
+                1000.0 * times.front(), 1000.0 * times[times.size() / 2],
+                1000.0 * sum / times.size(), 1000.0 * times.back(),
+                (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string output_file = "itomp_benchmark.json";
+    int repetitions = 10;
+    int max_threads = omp_get_num_procs();
+    bool use_distance_field = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output_file = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repetitions = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            max_threads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-d") == 0)
+            use_distance_field = true;
+        else
+        {
+            fprintf(stderr, "usage : %s [-o output.json] [-r repetitions] [-t max_threads] [-d]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // ros::Time::now() is available without a ros master
+    ros::Time::init();
+
+    setPlanningParameters(use_distance_field);
+
+    std::string urdf_string;
+    robot_model::RobotModelPtr moveit_robot_model = loadRobotModel(urdf_string);
+    if (!moveit_robot_model)
+    {
+        ROS_ERROR("Could not load the robot model");
+        return 1;
+    }
+
+    BenchmarkScene scene;
+    scene.robot_model_ = boost::make_shared<ItompRobotModel>();
+    if (!scene.robot_model_->init(moveit_robot_model, urdf_string))
+        return 1;
+    scene.planning_group_ = scene.robot_model_->getPlanningGroup(PLANNING_GROUP);
+
+    scene.planning_scene_.reset(new planning_scene::PlanningScene(moveit_robot_model));
+    if (!addContactModelToWorld(scene.planning_scene_))
+        return 1;
+
+    GroundManager::getInstance()->initialize(scene.planning_scene_);
+    TrajectoryFactory::getInstance()->initialize(TrajectoryFactory::TRAJECTORY_CIO);
+
+    std::vector<int> thread_counts;
+    for (int num_threads = 1; num_threads < max_threads; num_threads *= 2)
+        thread_counts.push_back(num_threads);
+    thread_counts.push_back(max_threads);
+
+    std::vector<BenchmarkResult> results;
+    for (int i = 0; i < sizeof(BENCHMARK_NUM_POINTS) / sizeof(int); ++i)
+    {
+        int num_points = BENCHMARK_NUM_POINTS[i];
+        createScene(scene, num_points);
+
+        for (int j = 0; j < thread_counts.size(); ++j)
+        {
+            int num_threads = thread_counts[j];
+            omp_set_num_threads(num_threads);
+
+            runBenchmark("evaluate", EvaluateBenchmark(scene), num_points, num_threads, repetitions, results);
+            runBenchmark("compute_derivatives", DerivativeBenchmark(scene, num_threads), num_points, num_threads, repetitions, results);
+            runBenchmark("update_full_kinematics_and_dynamics", KinematicsAndDynamicsBenchmark(scene), num_points, num_threads, repetitions, results);
+            runBenchmark("get_nearest_contact_position", NearestContactPositionBenchmark(scene), num_points, num_threads, repetitions, results);
+            runBenchmark("obstacle_cost_evaluate", ObstacleCostBenchmark(scene, num_threads), num_points, num_threads, repetitions, results);
+        }
+    }
+
+    FILE* file = (output_file == "-") ? stdout : fopen(output_file.c_str(), "w");
+    if (file == NULL)
+    {
+        ROS_ERROR("Could not open %s", output_file.c_str());
+        return 1;
+    }
+    writeResults(file, results, repetitions, use_distance_field);
+    if (file != stdout)
+        fclose(file);
+
+    scene = BenchmarkScene();
+    TrajectoryFactory::getInstance()->destroy();
+    GroundManager::getInstance()->destroy();
+    PlanningParameters::getInstance()->destroy();
+
+    return 0;
+}
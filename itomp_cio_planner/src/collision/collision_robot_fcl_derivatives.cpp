@@ -73,13 +73,21 @@ void CollisionRobotFCLDerivatives::updateInternalFCLObjectTransforms(const robot
 
 void CollisionRobotFCLDerivatives::checkSelfCollision(const CollisionRequest &req, CollisionResult &res, const robot_state::RobotState &state) const
 {
-	checkSelfCollisionDerivativesHelper(req, res, state, NULL);
+	CollisionDataDerivatives cdd;
+	checkSelfCollisionDerivativesHelper(req, res, state, NULL, cdd);
 }
 
 void CollisionRobotFCLDerivatives::checkSelfCollision(const CollisionRequest &req, CollisionResult &res, const robot_state::RobotState &state,
 		const AllowedCollisionMatrix &acm) const
 {
-	checkSelfCollisionDerivativesHelper(req, res, state, &acm);
+	CollisionDataDerivatives cdd;
+	checkSelfCollisionDerivativesHelper(req, res, state, &acm, cdd);
+}
+
+void CollisionRobotFCLDerivatives::checkSelfCollision(const CollisionRequest &req, CollisionResult &res, const robot_state::RobotState &state,
+		const collision_detection::AllowedCollisionMatrix &acm, CollisionDataDerivatives &cdd) const
+{
+	checkSelfCollisionDerivativesHelper(req, res, state, &acm, cdd);
 }
 
 double CollisionRobotFCLDerivatives::distanceSelf(const robot_state::RobotState &state) const
@@ -93,12 +101,11 @@ double CollisionRobotFCLDerivatives::distanceSelf(const robot_state::RobotState
 }
 
 void CollisionRobotFCLDerivatives::checkSelfCollisionDerivativesHelper(const CollisionRequest &req, CollisionResult &res, const robot_state::RobotState &state,
-		const AllowedCollisionMatrix *acm) const
+		const AllowedCollisionMatrix *acm, CollisionDataDerivatives &cdd) const
 {
 	CollisionData cd(&req, &res, acm);
 	cd.enableGroup(getRobotModel());
 
-	CollisionDataDerivatives cdd;
 	cdd.cd = &cd;
 
     manager_.manager_->collide(&cdd, &CollisionRobotFCLDerivatives::collisionCallback);
@@ -212,6 +219,9 @@ bool CollisionRobotFCLDerivatives::collisionCallback(fcl::CollisionObject *o1, f
 	if (always_allow_collision)
 		return false;
 
+	if (cdd->accumulate_cost)
+		return accumulatePenetrationCost(o1, o2, cd1, cd2, dcf, cdd);
+
 	if (cdata->req_->verbose)
 		logDebug("Actually checking collisions between %s and %s", cd1->getID().c_str(), cd2->getID().c_str());
 
@@ -26,22 +26,30 @@ CollisionWorldFCLDerivatives::~CollisionWorldFCLDerivatives()
 
 void CollisionWorldFCLDerivatives::checkRobotCollision(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state) const
 {
-	checkRobotCollisionDerivativesHelper(req, res, robot, state, NULL);
+	CollisionDataDerivatives cdd;
+	checkRobotCollisionDerivativesHelper(req, res, robot, state, NULL, cdd);
 }
 
 void CollisionWorldFCLDerivatives::checkRobotCollision(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state, const AllowedCollisionMatrix &acm) const
 {
-	checkRobotCollisionDerivativesHelper(req, res, robot, state, &acm);
+	CollisionDataDerivatives cdd;
+	checkRobotCollisionDerivativesHelper(req, res, robot, state, &acm, cdd);
 }
 
-void CollisionWorldFCLDerivatives::checkRobotCollisionDerivativesHelper(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state, const AllowedCollisionMatrix *acm) const
+void CollisionWorldFCLDerivatives::checkRobotCollision(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state, const AllowedCollisionMatrix &acm,
+		CollisionDataDerivatives &cdd) const
+{
+	checkRobotCollisionDerivativesHelper(req, res, robot, state, &acm, cdd);
+}
+
+void CollisionWorldFCLDerivatives::checkRobotCollisionDerivativesHelper(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state, const AllowedCollisionMatrix *acm,
+		CollisionDataDerivatives &cdd) const
 {
     const CollisionRobotFCLDerivatives &robot_fcl = static_cast<const CollisionRobotFCLDerivatives&>(robot);
     const FCLObject& fcl_obj = robot_fcl.manager_.object_;
 
 	CollisionData cd(&req, &res, acm);
 	cd.enableGroup(robot.getRobotModel());
-	CollisionDataDerivatives cdd;
 	cdd.cd = &cd;
 
 	for (std::size_t i = 0 ; !cd.done_ && i < fcl_obj.collision_objects_.size() ; ++i)
@@ -172,6 +180,9 @@ bool CollisionWorldFCLDerivatives::collisionCallback(fcl::CollisionObject *o1, f
 	if (always_allow_collision)
 		return false;
 
+	if (cdd->accumulate_cost)
+		return accumulatePenetrationCost(o1, o2, cd1, cd2, dcf, cdd);
+
 	if (cdata->req_->verbose)
 		logDebug("Actually checking collisions between %s and %s", cd1->getID().c_str(), cd2->getID().c_str());
 
@@ -0,0 +1,240 @@
+#include <itomp_cio_planner/collision/obstacle_distance_field.h>
+#include <itomp_cio_planner/util/planning_parameters.h>
+#include <moveit/robot_model/revolute_joint_model.h>
+#include <moveit/robot_model/prismatic_joint_model.h>
+#include <geometric_shapes/shape_operations.h>
+#include <geometric_shapes/bodies.h>
+#include <ros/ros.h>
+
+namespace itomp_cio_planner
+{
+
+ObstacleDistanceField::ObstacleDistanceField(const planning_scene::PlanningSceneConstPtr& planning_scene,
+        const robot_model::RobotModelConstPtr& robot_model,
+        double resolution, double margin)
+    : margin_(margin)
+{
+    createCollisionSpheres(robot_model);
+    createDistanceField(planning_scene, resolution);
+}
+
+ObstacleDistanceField::~ObstacleDistanceField()
+{
+
+}
+
+void ObstacleDistanceField::createCollisionSpheres(const robot_model::RobotModelConstPtr& robot_model)
+{
+    collision_spheres_.clear();
+
+    // each collision shape is covered by spheres along the longest axis of its bounding box
+    const std::vector<const robot_model::LinkModel*>& link_models = robot_model->getLinkModelsWithCollisionGeometry();
+    for (int i = 0; i < link_models.size(); ++i)
+    {
+        const robot_model::LinkModel* link_model = link_models[i];
+        const std::vector<shapes::ShapeConstPtr>& shapes = link_model->getShapes();
+        for (int j = 0; j < shapes.size(); ++j)
+        {
+            Eigen::Vector3d aabb_min, aabb_max;
+            if (shapes[j]->type == shapes::MESH)
+            {
+                const shapes::Mesh* mesh = static_cast<const shapes::Mesh*>(shapes[j].get());
+                if (mesh->vertex_count == 0)
+                    continue;
+                aabb_min = aabb_max = Eigen::Vector3d(mesh->vertices[0], mesh->vertices[1], mesh->vertices[2]);
+                for (unsigned int v = 1; v < mesh->vertex_count; ++v)
+                {
+                    Eigen::Vector3d vertex(mesh->vertices[3 * v], mesh->vertices[3 * v + 1], mesh->vertices[3 * v + 2]);
+                    aabb_min = aabb_min.cwiseMin(vertex);
+                    aabb_max = aabb_max.cwiseMax(vertex);
+                }
+            }
+            else
+            {
+                Eigen::Vector3d extents = shapes::computeShapeExtents(shapes[j].get());
+                aabb_min = -0.5 * extents;
+                aabb_max = 0.5 * extents;
+            }
+
+            Eigen::Vector3d extents = aabb_max - aabb_min;
+            int long_axis;
+            double length = extents.maxCoeff(&long_axis);
+
+            // radius covers the cross section of the bounding box
+            Eigen::Vector3d cross_section = extents;
+            cross_section(long_axis) = 0.0;
+            double radius = 0.5 * cross_section.norm();
+            if (radius <= 0.0)
+                radius = 0.5 * length;
+            if (radius <= 0.0)
+                continue;
+
+            int num_spheres = std::max(1, (int)std::ceil(length / (2.0 * radius)));
+            for (int k = 0; k < num_spheres; ++k)
+            {
+                Eigen::Vector3d center = 0.5 * (aabb_min + aabb_max);
+                center(long_axis) = aabb_min(long_axis) + (k + 0.5) * length / num_spheres;
+
+                CollisionSphere sphere;
+                sphere.link_model_ = link_model;
+                sphere.center_ = link_model->getCollisionOriginTransforms()[j] * center;
+                sphere.radius_ = radius;
+                collision_spheres_.push_back(sphere);
+            }
+        }
+    }
+}
+
+void ObstacleDistanceField::createDistanceField(const planning_scene::PlanningSceneConstPtr& planning_scene, double resolution)
+{
+    const collision_detection::WorldConstPtr& world = planning_scene->getWorld();
+
+    double max_radius = 0.0;
+    for (int i = 0; i < collision_spheres_.size(); ++i)
+        max_radius = std::max(max_radius, collision_spheres_[i].radius_);
+    // distances are only propagated up to the range which affects the cost
+    double max_distance = margin_ + max_radius + resolution;
+
+    // bounds of the world geometry
+    Eigen::Vector3d field_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d field_max = Eigen::Vector3d::Constant(-std::numeric_limits<double>::max());
+    for (collision_detection::World::const_iterator it = world->begin(); it != world->end(); ++it)
+    {
+        const collision_detection::World::Object& object = *it->second;
+        for (int i = 0; i < object.shapes_.size(); ++i)
+        {
+            bodies::Body* body = bodies::createBodyFromShape(object.shapes_[i].get());
+            if (body == NULL)
+                continue;
+            body->setPose(object.shape_poses_[i]);
+            bodies::BoundingSphere bounding_sphere;
+            body->computeBoundingSphere(bounding_sphere);
+            delete body;
+
+            field_min = field_min.cwiseMin(bounding_sphere.center - Eigen::Vector3d::Constant(bounding_sphere.radius));
+            field_max = field_max.cwiseMax(bounding_sphere.center + Eigen::Vector3d::Constant(bounding_sphere.radius));
+        }
+    }
+    if ((field_min.array() > field_max.array()).any())
+    {
+        ROS_WARN("Obstacle distance field : no world geometry");
+        return;
+    }
+
+    const std::vector<double>& workspace_min = PlanningParameters::getInstance()->getWorkspaceMin();
+    const std::vector<double>& workspace_max = PlanningParameters::getInstance()->getWorkspaceMax();
+    for (int i = 0; i < 3; ++i)
+    {
+        field_min(i) = std::max(field_min(i) - max_distance, workspace_min[i]);
+        field_max(i) = std::min(field_max(i) + max_distance, workspace_max[i]);
+    }
+    Eigen::Vector3d size = field_max - field_min;
+
+    distance_field_.reset(new distance_field::PropagationDistanceField(size(0), size(1), size(2), resolution,
+                          field_min(0), field_min(1), field_min(2), max_distance, true));
+
+    for (collision_detection::World::const_iterator it = world->begin(); it != world->end(); ++it)
+    {
+        const collision_detection::World::Object& object = *it->second;
+        for (int i = 0; i < object.shapes_.size(); ++i)
+            distance_field_->addShapeToField(object.shapes_[i].get(), object.shape_poses_[i]);
+    }
+
+    ROS_INFO("Obstacle distance field : %d x %d x %d cells, %d collision spheres",
+             distance_field_->getXNumCells(), distance_field_->getYNumCells(), distance_field_->getZNumCells(),
+             (int)collision_spheres_.size());
+    ROS_WARN("Self collisions are not checked with the distance field obstacle cost");
+}
+
+double ObstacleDistanceField::getSphereCost(const Eigen::Vector3d& position, double radius, Eigen::Vector3d* gradient,
+        bool* in_collision) const
+{
+    if (gradient != NULL)
+        gradient->setZero();
+
+    double gradient_x, gradient_y, gradient_z;
+    bool in_bounds;
+    double distance = distance_field_->getDistanceGradient(position(0), position(1), position(2),
+                      gradient_x, gradient_y, gradient_z, in_bounds);
+    if (!in_bounds)
+        return 0.0;
+
+    if (in_collision != NULL && distance - radius <= 0.0)
+        *in_collision = true;
+
+    double penetration = margin_ + radius - distance;
+    if (penetration <= 0.0)
+        return 0.0;
+
+    if (gradient != NULL)
+        *gradient = -2.0 * penetration * Eigen::Vector3d(gradient_x, gradient_y, gradient_z);
+
+    return penetration * penetration;
+}
+
+double ObstacleDistanceField::getCost(const robot_state::RobotState& robot_state, bool* in_collision) const
+{
+    if (in_collision != NULL)
+        *in_collision = false;
+    if (!distance_field_)
+        return 0.0;
+
+    double cost = 0.0;
+    for (int i = 0; i < collision_spheres_.size(); ++i)
+    {
+        const CollisionSphere& sphere = collision_spheres_[i];
+        Eigen::Vector3d position = robot_state.getGlobalLinkTransform(sphere.link_model_) * sphere.center_;
+        cost += getSphereCost(position, sphere.radius_, NULL, in_collision);
+    }
+    return cost;
+}
+
+double ObstacleDistanceField::getCostDerivative(const robot_state::RobotState& robot_state, int variable_index) const
+{
+    if (!distance_field_)
+        return 0.0;
+
+    const robot_model::JointModel* joint_model = robot_state.getRobotModel()->getJointOfVariable(variable_index);
+
+    Eigen::Vector3d axis;
+    bool is_revolute;
+    switch (joint_model->getType())
+    {
+    case robot_model::JointModel::REVOLUTE:
+        axis = static_cast<const robot_model::RevoluteJointModel*>(joint_model)->getAxis();
+        is_revolute = true;
+        break;
+    case robot_model::JointModel::PRISMATIC:
+        axis = static_cast<const robot_model::PrismaticJointModel*>(joint_model)->getAxis();
+        is_revolute = false;
+        break;
+    default:
+        return 0.0;
+    }
+
+    // the joint axis is defined in the child link frame
+    const Eigen::Affine3d& joint_transform = robot_state.getGlobalLinkTransform(joint_model->getChildLinkModel());
+    axis = joint_transform.linear() * axis;
+
+    const std::vector<const robot_model::LinkModel*>& descendant_link_models = joint_model->getDescendantLinkModels();
+
+    double derivative = 0.0;
+    for (int i = 0; i < collision_spheres_.size(); ++i)
+    {
+        const CollisionSphere& sphere = collision_spheres_[i];
+        if (std::find(descendant_link_models.begin(), descendant_link_models.end(), sphere.link_model_) == descendant_link_models.end())
+            continue;
+
+        Eigen::Vector3d position = robot_state.getGlobalLinkTransform(sphere.link_model_) * sphere.center_;
+        Eigen::Vector3d gradient;
+        if (getSphereCost(position, sphere.radius_, &gradient) == 0.0)
+            continue;
+
+        // d(sphere position) / d(joint variable)
+        Eigen::Vector3d position_derivative = is_revolute ? axis.cross(position - joint_transform.translation()) : axis;
+        derivative += gradient.dot(position_derivative);
+    }
+    return derivative;
+}
+
+}
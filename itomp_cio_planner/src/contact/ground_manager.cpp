@@ -14,10 +14,43 @@
 #include <geometric_shapes/shape_operations.h>
 #include <geometric_shapes/shapes.h>
 #include <limits>
+#include <algorithm>
 
 namespace itomp_cio_planner
 {
 
+namespace
+{
+const int BVH_MAX_LEAF_SIZE = 4;
+const int BVH_MAX_STACK_SIZE = 128;
+
+double distanceToBoundingBox(const Eigen::Vector3d& position, const TriangleBVHNode& node, bool ignore_Z)
+{
+    double sq_distance = 0.0;
+    int num_axes = ignore_Z ? 2 : 3;
+    for (int i = 0; i < num_axes; ++i)
+    {
+        double d = std::max(0.0, std::max(node.min_(i) - position(i), position(i) - node.max_(i)));
+        sq_distance += d * d;
+    }
+    return std::sqrt(sq_distance);
+}
+
+struct TriangleCentroidLess
+{
+    TriangleCentroidLess(const std::vector<Triangle>& triangles, int axis) : triangles_(triangles), axis_(axis) {}
+    bool operator()(int a, int b) const
+    {
+        const Triangle& ta = triangles_[a];
+        const Triangle& tb = triangles_[b];
+        return (ta.points_[0](axis_) + ta.points_[1](axis_) + ta.points_[2](axis_)) <
+               (tb.points_[0](axis_) + tb.points_[1](axis_) + tb.points_[2](axis_));
+    }
+    const std::vector<Triangle>& triangles_;
+    int axis_;
+};
+}
+
 Plane::Plane(const Triangle &triangle)
 {
     normal_ = triangle.normal_;
@@ -116,29 +149,66 @@ bool GroundManager::getNearestMeshPosition(const Eigen::Vector3d& position_in,
 
     if (NO_INTERPOLATED)
 	{
-        for (int i = 0; i < triangles_.size(); ++i)
-        {
-            const Triangle& triangle = triangles_[i];
+        if (bvh_nodes_.empty())
+            return false;
 
-            Eigen::Vector3d projection = ProjPoint2Triangle(triangle.points_[0], triangle.points_[1],
-                                         triangle.points_[2], position_in);
+        // among the triangles of the same distance, the one with the lowest index is selected
+        // to give the same result as a linear scan
+        int min_index = -1;
 
-            double distance = (position_in - projection).norm();
-            if (ignore_Z)
+        int stack[BVH_MAX_STACK_SIZE];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            const TriangleBVHNode& node = bvh_nodes_[stack[--stack_size]];
+            if (distanceToBoundingBox(position_in, node, ignore_Z) > current_min_distance)
+                continue;
+
+            if (node.children_[0] != -1)
             {
-                Eigen::Vector3d diff = position_in - projection;
-                diff(2) = 0.0;
-                distance = diff.norm();
+                ROS_ASSERT(stack_size + 2 <= BVH_MAX_STACK_SIZE);
+                // visit the nearer child first
+                const TriangleBVHNode& child0 = bvh_nodes_[node.children_[0]];
+                const TriangleBVHNode& child1 = bvh_nodes_[node.children_[1]];
+                if (distanceToBoundingBox(position_in, child0, ignore_Z) < distanceToBoundingBox(position_in, child1, ignore_Z))
+                {
+                    stack[stack_size++] = node.children_[1];
+                    stack[stack_size++] = node.children_[0];
+                }
+                else
+                {
+                    stack[stack_size++] = node.children_[0];
+                    stack[stack_size++] = node.children_[1];
+                }
+                continue;
             }
 
-
-            if (distance < current_min_distance)
+            for (int j = node.begin_; j < node.end_; ++j)
             {
-                current_min_distance = distance;
-                normal = triangle.normal_;
-                position_out = projection;
-
-                updated = true;
+                int i = bvh_triangle_indices_[j];
+                const Triangle& triangle = triangles_[i];
+
+                Eigen::Vector3d projection = ProjPoint2Triangle(triangle.points_[0], triangle.points_[1],
+                                             triangle.points_[2], position_in);
+
+                double distance = (position_in - projection).norm();
+                if (ignore_Z)
+                {
+                    Eigen::Vector3d diff = position_in - projection;
+                    diff(2) = 0.0;
+                    distance = diff.norm();
+                }
+
+                if (distance < current_min_distance || (distance == current_min_distance && i < min_index))
+                {
+                    current_min_distance = distance;
+                    normal = triangle.normal_;
+                    position_out = projection;
+                    min_index = i;
+
+                    updated = true;
+                }
             }
 		}
 	}
@@ -258,28 +328,59 @@ void GroundManager::getNearestZPosition(const Eigen::Vector3d& position_in, cons
 
 void GroundManager::getNearestMeshZPosition(const Eigen::Vector3d& position_in, Eigen::Vector3d& position_out, Eigen::Vector3d& normal, double current_min_distance) const
 {
-    for (int i = 0; i < triangles_.size(); ++i)
-    {
-        const Triangle& triangle = triangles_[i];
-        const Plane& plane = planes_[triangle.plane_index_];
+    if (bvh_nodes_.empty())
+        return;
 
-        Eigen::Vector3d projection;
-        if (plane.projectionZ(position_in, projection) == false)
-            continue;
+    int min_index = -1;
 
-        projection = ProjPoint2Triangle(triangle.points_[0], triangle.points_[1], triangle.points_[2], projection);
+    int stack[BVH_MAX_STACK_SIZE];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        const TriangleBVHNode& node = bvh_nodes_[stack[--stack_size]];
 
-        Eigen::Vector3d diff = projection - position_in;
-        if (std::abs(diff(0)) > ITOMP_EPS || std::abs(diff(1)) > ITOMP_EPS)
+        // the projection should be on the vertical line through position_in
+        if (position_in(0) < node.min_(0) - ITOMP_EPS || position_in(0) > node.max_(0) + ITOMP_EPS ||
+                position_in(1) < node.min_(1) - ITOMP_EPS || position_in(1) > node.max_(1) + ITOMP_EPS)
+            continue;
+        double z_distance = std::max(0.0, std::max(node.min_(2) - position_in(2), position_in(2) - node.max_(2)));
+        if (z_distance > current_min_distance)
             continue;
 
-        double distance = std::abs(diff(2));
+        if (node.children_[0] != -1)
+        {
+            ROS_ASSERT(stack_size + 2 <= BVH_MAX_STACK_SIZE);
+            stack[stack_size++] = node.children_[1];
+            stack[stack_size++] = node.children_[0];
+            continue;
+        }
 
-        if (distance < current_min_distance)
+        for (int j = node.begin_; j < node.end_; ++j)
         {
-            current_min_distance = distance;
-            normal = triangle.normal_;
-            position_out = projection;
+            int i = bvh_triangle_indices_[j];
+            const Triangle& triangle = triangles_[i];
+            const Plane& plane = planes_[triangle.plane_index_];
+
+            Eigen::Vector3d projection;
+            if (plane.projectionZ(position_in, projection) == false)
+                continue;
+
+            projection = ProjPoint2Triangle(triangle.points_[0], triangle.points_[1], triangle.points_[2], projection);
+
+            Eigen::Vector3d diff = projection - position_in;
+            if (std::abs(diff(0)) > ITOMP_EPS || std::abs(diff(1)) > ITOMP_EPS)
+                continue;
+
+            double distance = std::abs(diff(2));
+
+            if (distance < current_min_distance || (distance == current_min_distance && i < min_index))
+            {
+                current_min_distance = distance;
+                normal = triangle.normal_;
+                position_out = projection;
+                min_index = i;
+            }
         }
     }
 }
@@ -287,6 +388,9 @@ void GroundManager::getNearestMeshZPosition(const Eigen::Vector3d& position_in,
 void GroundManager::initializeContactSurfaces()
 {
 	triangles_.clear();
+    planes_.clear();
+    bvh_nodes_.clear();
+    bvh_triangle_indices_.clear();
 
     std::string contact_model = PlanningParameters::getInstance()->getContactModel();
     if (contact_model == "")
@@ -348,8 +452,72 @@ void GroundManager::initializeContactSurfaces()
         triangles_.push_back(tri);
     }
 
+    buildBVH();
+
     NewVizManager::getInstance()->renderContactSurface();
 }
 
+void GroundManager::buildBVH()
+{
+    bvh_nodes_.clear();
+    bvh_triangle_indices_.resize(triangles_.size());
+    for (int i = 0; i < triangles_.size(); ++i)
+        bvh_triangle_indices_[i] = i;
+
+    if (triangles_.empty())
+        return;
+
+    bvh_nodes_.reserve(2 * triangles_.size() / BVH_MAX_LEAF_SIZE + 1);
+    buildBVHNode(0, triangles_.size());
+}
+
+int GroundManager::buildBVHNode(int begin, int end)
+{
+    int node_index = bvh_nodes_.size();
+    bvh_nodes_.push_back(TriangleBVHNode());
+
+    Eigen::Vector3d box_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d box_max = Eigen::Vector3d::Constant(-std::numeric_limits<double>::max());
+    Eigen::Vector3d centroid_min = box_min;
+    Eigen::Vector3d centroid_max = box_max;
+    for (int j = begin; j < end; ++j)
+    {
+        const Triangle& triangle = triangles_[bvh_triangle_indices_[j]];
+        Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+        for (int k = 0; k < 3; ++k)
+        {
+            box_min = box_min.cwiseMin(triangle.points_[k]);
+            box_max = box_max.cwiseMax(triangle.points_[k]);
+            centroid += triangle.points_[k];
+        }
+        centroid_min = centroid_min.cwiseMin(centroid);
+        centroid_max = centroid_max.cwiseMax(centroid);
+    }
+
+    // padding for the numerical error of the triangle projection
+    bvh_nodes_[node_index].min_ = box_min - Eigen::Vector3d::Constant(ITOMP_EPS);
+    bvh_nodes_[node_index].max_ = box_max + Eigen::Vector3d::Constant(ITOMP_EPS);
+    bvh_nodes_[node_index].begin_ = begin;
+    bvh_nodes_[node_index].end_ = end;
+    bvh_nodes_[node_index].children_[0] = bvh_nodes_[node_index].children_[1] = -1;
+
+    if (end - begin <= BVH_MAX_LEAF_SIZE)
+        return node_index;
+
+    // median split along the longest axis of the centroids
+    int axis;
+    (centroid_max - centroid_min).maxCoeff(&axis);
+    int mid = (begin + end) / 2;
+    std::nth_element(bvh_triangle_indices_.begin() + begin, bvh_triangle_indices_.begin() + mid,
+                     bvh_triangle_indices_.begin() + end, TriangleCentroidLess(triangles_, axis));
+
+    int child0 = buildBVHNode(begin, mid);
+    int child1 = buildBVHNode(mid, end);
+    bvh_nodes_[node_index].children_[0] = child0;
+    bvh_nodes_[node_index].children_[1] = child1;
+
+    return node_index;
+}
+
 }
 
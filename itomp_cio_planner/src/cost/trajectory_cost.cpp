@@ -23,16 +23,34 @@ TrajectoryCost::~TrajectoryCost()
 
 }
 
+int TrajectoryCost::bindJointIndex(const NewEvalManager* evaluation_manager, const std::string& joint_name) const
+{
+    int rbdl_number = evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber(joint_name);
+    if (rbdl_number == -1)
+        ROS_ERROR("%s cost : joint %s does not exist", name_.c_str(), joint_name.c_str());
+    return rbdl_number;
+}
+
+const robot_model::JointModelGroup* TrajectoryCost::bindJointModelGroup(const NewEvalManager* evaluation_manager,
+        const std::string& group_name) const
+{
+    const robot_model::JointModelGroup* joint_model_group =
+        evaluation_manager->getItompRobotModel()->getMoveitRobotModel()->getJointModelGroup(group_name);
+    if (joint_model_group == NULL)
+        ROS_ERROR("%s cost : joint model group %s does not exist", name_.c_str(), group_name.c_str());
+    return joint_model_group;
+}
+
 ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(Smoothness)
 bool TrajectoryCostSmoothness::evaluate(
 	const NewEvalManager* evaluation_manager, int point, double& cost) const
 {
     cost = 0;
 
-    if (PhaseManager::getInstance()->getPhase() < 1)// || PhaseManager::getInstance()->getPhase() > 2)
+    if (evaluation_manager->getPhaseManager()->getPhase() < 1)// || evaluation_manager->getPhaseManager()->getPhase() > 2)
         return true;
 
-	TIME_PROFILER_START_TIMER(Smoothness);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), Smoothness);
 
     const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
     const ElementTrajectoryConstPtr traj_acc = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
@@ -67,11 +85,33 @@ bool TrajectoryCostSmoothness::evaluate(
     cost = cost_vel * PlanningParameters::getInstance()->getSmoothnessCostVelocity() +
             cost_acc * PlanningParameters::getInstance()->getSmoothnessCostAcceleration();
 
-	TIME_PROFILER_END_TIMER(Smoothness);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), Smoothness);
 
 	return true;
 }
 
+void TrajectoryCostSmoothness::computeDerivative(const NewEvalManager* evaluation_manager, int point,
+        const ItompTrajectoryIndex& index, double* derivative) const
+{
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+        derivative[i] = 0.0;
+
+    if (evaluation_manager->getPhaseManager()->getPhase() < 1 || index.sub_component != ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)
+        return;
+
+    const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
+    const ElementTrajectoryConstPtr traj_acc = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+    const ElementTrajectoryConstPtr traj_vel = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+
+    // d(sum_i x_i^2 / n) / dx_i = 2 x_i / n
+    derivative[ItompTrajectory::COMPONENT_TYPE_VELOCITY] = 2.0 * traj_vel->at(point, index.element) / traj_vel->getNumElements()
+            * PlanningParameters::getInstance()->getSmoothnessCostVelocity();
+    derivative[ItompTrajectory::COMPONENT_TYPE_ACCELERATION] = 2.0 * traj_acc->at(point, index.element) / traj_acc->getNumElements()
+            * PlanningParameters::getInstance()->getSmoothnessCostAcceleration();
+}
+
 void TrajectoryCostObstacle::initialize(const NewEvalManager* evaluation_manager)
 {
 
@@ -92,17 +132,91 @@ bool TrajectoryCostObstacle::isInvariant(const NewEvalManager* evaluation_manage
             index.sub_component != ItompTrajectory::SUB_COMPONENT_TYPE_ALL);
 }
 
+namespace
+{
+// climb first motion
+bool isIgnoredClimbingContact(const collision_detection::CollisionGeometryData* cd1,
+                              const collision_detection::CollisionGeometryData* cd2,
+                              const fcl::Contact& contact)
+{
+    return (cd1->getID() == "left_foot_x_joint_x_link" || cd2->getID() == "left_foot_x_joint_x_link") &&
+            std::abs(contact.normal[1]) > 0.9;
+}
+// climb last motion
+/*
+bool isIgnoredClimbingContact(const collision_detection::CollisionGeometryData* cd1,
+                              const collision_detection::CollisionGeometryData* cd2,
+                              const fcl::Contact& contact)
+{
+    return (cd1->getID() == "left_hand_x_joint_x_link" || cd2->getID() == "left_hand_x_joint_x_link") &&
+            std::abs(contact.normal[0]) > 0.9;
+}
+*/
+}
+
+bool TrajectoryCostObstacle::hasAnalyticDerivative() const
+{
+    return PlanningParameters::getInstance()->getObstacleCostType() == PlanningParameters::OBSTACLE_COST_TYPE_DISTANCE_FIELD;
+}
+
+void TrajectoryCostObstacle::computeDerivative(const NewEvalManager* evaluation_manager, int point,
+        const ItompTrajectoryIndex& index, double* derivative) const
+{
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+        derivative[i] = 0.0;
+
+    if (evaluation_manager->getPhaseManager()->getPhase() == 0 && (point != 0 && point != evaluation_manager->getTrajectory()->getNumPoints() - 1))
+        return;
+    if (index.sub_component != ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)
+        return;
+
+    const ObstacleDistanceFieldConstPtr& distance_field = evaluation_manager->getObstacleDistanceField();
+    robot_state::RobotStatePtr robot_state = evaluation_manager->getRobotState(point);
+
+    Eigen::VectorXd point_buffer;
+    robot_state->setVariablePositions(evaluation_manager->getTrajectory()->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getPointData(point, point_buffer));
+    robot_state->updateLinkTransforms();
+
+    // the cost depends on the joint positions only
+    derivative[ItompTrajectory::COMPONENT_TYPE_POSITION] = distance_field->getCostDerivative(*robot_state, index.element);
+}
+
+bool TrajectoryCostObstacle::evaluateDistanceField(const NewEvalManager* evaluation_manager, int point, double& cost) const
+{
+    const ObstacleDistanceFieldConstPtr& distance_field = evaluation_manager->getObstacleDistanceField();
+    robot_state::RobotStatePtr robot_state = evaluation_manager->getRobotState(point);
+
+    Eigen::VectorXd point_buffer;
+    robot_state->setVariablePositions(evaluation_manager->getTrajectory()->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getPointData(point, point_buffer));
+    robot_state->updateLinkTransforms();
+
+    // the margin makes the cost positive before the contact. only a contact is infeasible, as with fcl
+    bool in_collision;
+    cost = distance_field->getCost(*robot_state, &in_collision);
+
+    return !in_collision;
+}
+
 bool TrajectoryCostObstacle::evaluate(const NewEvalManager* evaluation_manager, int point, double& cost) const
 {
     double collision_scale = 1.0;
 
-	TIME_PROFILER_START_TIMER(Obstacle);
+	TIME_PROFILER_SCOPED_TIMER(evaluation_manager->getPerformanceProfiler(), Obstacle);
 
 	bool is_feasible = true;
 
-    if (PhaseManager::getInstance()->getPhase() == 0 && (point != 0 && point != evaluation_manager->getTrajectory()->getNumPoints() - 1))
+    if (evaluation_manager->getPhaseManager()->getPhase() == 0 && (point != 0 && point != evaluation_manager->getTrajectory()->getNumPoints() - 1))
         return is_feasible;
 
+    // the distance field replaces the fcl contact queries below. self collisions are not checked in this mode
+    if (PlanningParameters::getInstance()->getObstacleCostType() == PlanningParameters::OBSTACLE_COST_TYPE_DISTANCE_FIELD)
+    {
+        is_feasible = evaluateDistanceField(evaluation_manager, point, cost);
+        return is_feasible;
+    }
+
     const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
     robot_state::RobotStatePtr robot_state = evaluation_manager->getRobotState(point);
     const planning_scene::PlanningSceneConstPtr planning_scene = evaluation_manager->getPlanningScene();
@@ -111,16 +225,9 @@ bool TrajectoryCostObstacle::evaluate(const NewEvalManager* evaluation_manager,
                trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
                        ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getNumElements());
 
-    collision_detection::CollisionRequest collision_request;
-    collision_detection::CollisionResult collision_result;
-    collision_request.verbose = false;
-    collision_request.contacts = true;
-    collision_request.max_contacts = 1000;
-    collision_request.distance = false;
-
-    const Eigen::MatrixXd mat = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
-    robot_state->setVariablePositions(mat.data());
+    Eigen::VectorXd point_buffer;
+    robot_state->setVariablePositions(trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getPointData(point, point_buffer));
 
     const double self_collision_scale = 0.01;
 
@@ -132,59 +239,36 @@ bool TrajectoryCostObstacle::evaluate(const NewEvalManager* evaluation_manager,
 
     collision_robot_derivatives->updateInternalFCLObjectTransforms(*robot_state);
 
-    const collision_detection::CollisionResult::ContactMap& contact_map = collision_result.contacts;
-
-
-    collision_world_derivatives->checkRobotCollision(collision_request, collision_result,
+    // penetration depths are accumulated in the fcl callbacks, no contacts are stored
+    CollisionScratch& collision_scratch = evaluation_manager->getCollisionScratch();
+    CollisionDataDerivatives cdd;
+    cdd.accumulate_cost = true;
+    cdd.depth_threshold = 0.01;
+    cdd.fcl_result = &collision_scratch.fcl_result;
+    cdd.contact_filter = &isIgnoredClimbingContact;
+    cdd.contact_pairs = &collision_scratch.contact_pairs;
+
+    collision_scratch.result.clear();
+    collision_scratch.contact_pairs.clear();
+    collision_world_derivatives->checkRobotCollision(collision_scratch.request, collision_scratch.result,
             *collision_robot_derivatives,
             *robot_state,
-            planning_scene->getAllowedCollisionMatrix());
-
-
-
-    for (collision_detection::CollisionResult::ContactMap::const_iterator it =
-                contact_map.begin(); it != contact_map.end(); ++it)
-    {
-        const collision_detection::Contact& contact = it->second[0];
-
-        // climb first motion
-        if ((contact.body_name_1 == "left_foot_x_joint_x_link" || contact.body_name_2 == "left_foot_x_joint_x_link") &&
-                std::abs(contact.normal(1)) > 0.9)
-                    continue;
-        // climb last motion
-        /*
-        if ((contact.body_name_1 == "left_hand_x_joint_x_link" || contact.body_name_2 == "left_hand_x_joint_x_link") &&
-                std::abs(contact.normal(0)) > 0.9)
-                    continue;
-                    */
-
-        if (contact.depth > 0.01)
-            cost += (contact.depth - 0.01) * (contact.depth - 0.01) * collision_scale;
-          //cost += contact.depth * contact.depth * collision_scale;
-    }
-
-
-
-    collision_result.clear();
+            planning_scene->getAllowedCollisionMatrix(), cdd);
+    cost += cdd.penetration_cost * collision_scale;
 
+    cdd.penetration_cost = 0.0;
+    cdd.contact_filter = NULL;
 
-    collision_robot_derivatives->checkSelfCollision(collision_request, collision_result,
+    collision_scratch.result.clear();
+    collision_scratch.contact_pairs.clear();
+    collision_robot_derivatives->checkSelfCollision(collision_scratch.request, collision_scratch.result,
             *robot_state,
-            planning_scene->getAllowedCollisionMatrix());
-    for (collision_detection::CollisionResult::ContactMap::const_iterator it =
-                contact_map.begin(); it != contact_map.end(); ++it)
-    {
-        const collision_detection::Contact& contact = it->second[0];
-        if (contact.depth > 0.01)
-            cost += self_collision_scale * (contact.depth - 0.01) * (contact.depth - 0.01);
-    }
+            planning_scene->getAllowedCollisionMatrix(), cdd);
+    cost += self_collision_scale * cdd.penetration_cost;
 
 
     is_feasible = (cost == 0.0);
 
-
-    TIME_PROFILER_END_TIMER(Obstacle);
-
     return is_feasible;
 }
 
@@ -204,19 +288,19 @@ ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(ContactInvariant)
 bool TrajectoryCostContactInvariant::evaluate(
 	const NewEvalManager* evaluation_manager, int point, double& cost) const
 {
-	TIME_PROFILER_START_TIMER(ContactInvariant);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), ContactInvariant);
 
 	bool is_feasible = true;
 	cost = 0;
 
-    if (PhaseManager::getInstance()->getPhase() <= 2)
+    if (evaluation_manager->getPhaseManager()->getPhase() <= 2)
         return true;
 
     const ItompPlanningGroupConstPtr& planning_group = evaluation_manager->getPlanningGroup();
     const RigidBodyDynamics::Model& model = evaluation_manager->getRBDLModel(point);
 
 	const std::vector<ContactVariables>& contact_variables =
-		evaluation_manager->contact_variables_[point];
+		evaluation_manager->contact_variables_[evaluation_manager->getStateIndex(point)];
 	int num_contacts = contact_variables.size();
 
     if (PlanningParameters::getInstance()->getCIEvaluationOnPoints())
@@ -287,7 +371,7 @@ bool TrajectoryCostContactInvariant::evaluate(
         }
     }
 
-	TIME_PROFILER_END_TIMER(ContactInvariant);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), ContactInvariant);
 
 	return is_feasible;
 }
@@ -300,19 +384,19 @@ bool TrajectoryCostPhysicsViolation::evaluate(
 	bool is_feasible = true;
 	cost = 0;
 
-    if (PhaseManager::getInstance()->getPhase() <= 2)
+    if (evaluation_manager->getPhaseManager()->getPhase() <= 2)
         return true;
 
-	TIME_PROFILER_START_TIMER(PhysicsViolation);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), PhysicsViolation);
 
 	for (int i = 0; i < 6; ++i)
 	{
 		// non-actuated root joints
-        double joint_torque = evaluation_manager->joint_torques_[point](i);
+        double joint_torque = evaluation_manager->joint_torques_[evaluation_manager->getStateIndex(point)](i);
 		cost += joint_torque * joint_torque;
 	}
 
-	TIME_PROFILER_END_TIMER(PhysicsViolation);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), PhysicsViolation);
 
 	return is_feasible;
 }
@@ -321,7 +405,7 @@ ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(GoalPose)
 bool TrajectoryCostGoalPose::evaluate(const NewEvalManager* evaluation_manager,
 									  int point, double& cost) const
 {
-	TIME_PROFILER_START_TIMER(GoalPose);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), GoalPose);
 
     bool is_feasible = true;
     cost = 0;
@@ -334,7 +418,7 @@ bool TrajectoryCostGoalPose::evaluate(const NewEvalManager* evaluation_manager,
         current_goal_pos(1) = state->getVariablePosition(1);
         current_goal_pos(2) = state->getVariablePosition(5);
 
-        cost = (current_goal_pos - PhaseManager::getInstance()->initial_goal_pos).squaredNorm();
+        cost = (current_goal_pos - evaluation_manager->getPhaseManager()->initial_goal_pos).squaredNorm();
     }
 
 
@@ -382,7 +466,7 @@ bool TrajectoryCostGoalPose::evaluate(const NewEvalManager* evaluation_manager,
 	}
     */
 
-	TIME_PROFILER_END_TIMER(GoalPose);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), GoalPose);
 
 	return is_feasible;
 }
@@ -394,13 +478,13 @@ bool TrajectoryCostCOM::evaluate(const NewEvalManager* evaluation_manager,
 	bool is_feasible = true;
 	cost = 0;
 
-	TIME_PROFILER_START_TIMER(COM);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), COM);
 
 	// implement
 
 	// TODO: contact regulation cost for foot contacts
 	const std::vector<ContactVariables>& contact_variables =
-		evaluation_manager->contact_variables_[point];
+		evaluation_manager->contact_variables_[evaluation_manager->getStateIndex(point)];
 	int num_contacts = contact_variables.size();
 	for (int i = 0; i < num_contacts; ++i)
 	{
@@ -415,7 +499,7 @@ bool TrajectoryCostCOM::evaluate(const NewEvalManager* evaluation_manager,
 		cost += k_1 * active_force * active_force;
 	}
 
-	TIME_PROFILER_END_TIMER(COM);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), COM);
 
 	return is_feasible;
 }
@@ -428,21 +512,21 @@ bool TrajectoryCostEndeffectorVelocity::evaluate(
 	cost = 0;
 
 	// implement
-	TIME_PROFILER_START_TIMER(EndeffectorVelocity);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), EndeffectorVelocity);
 
 	const std::vector<ContactVariables>& contact_variables =
-		evaluation_manager->contact_variables_[point];
+		evaluation_manager->contact_variables_[evaluation_manager->getStateIndex(point)];
 	int num_contacts = contact_variables.size();
 	for (int i = 0; i < num_contacts; ++i)
 	{
 		unsigned int rbdl_body_id =
 			evaluation_manager->getPlanningGroup()->contact_points_[i].getRBDLBodyId();
 		double squared_norm =
-			evaluation_manager->rbdl_models_[point].v[rbdl_body_id].squaredNorm();
+			evaluation_manager->rbdl_models_[evaluation_manager->getStateIndex(point)].v[rbdl_body_id].squaredNorm();
 		cost += squared_norm;
 	}
 
-	TIME_PROFILER_END_TIMER(EndeffectorVelocity);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), EndeffectorVelocity);
 
 	return is_feasible;
 }
@@ -453,10 +537,10 @@ bool TrajectoryCostTorque::evaluate(const NewEvalManager* evaluation_manager, in
 	bool is_feasible = true;
 	cost = 0;
 
-    if (PhaseManager::getInstance()->getPhase() < 3)
+    if (evaluation_manager->getPhaseManager()->getPhase() < 3)
         return is_feasible;
 
-	TIME_PROFILER_START_TIMER(Torque);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), Torque);
 
     const RigidBodyDynamics::Model& model = evaluation_manager->getRBDLModel(point);
     const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
@@ -464,10 +548,10 @@ bool TrajectoryCostTorque::evaluate(const NewEvalManager* evaluation_manager, in
     const Eigen::VectorXd& q_ddot = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
                                     ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
 
-    for (int i = 0; i < evaluation_manager->joint_torques_[point].rows(); ++i)
+    for (int i = 0; i < evaluation_manager->joint_torques_[evaluation_manager->getStateIndex(point)].rows(); ++i)
 	{
 		// actuated joints
-        double joint_torque = evaluation_manager->joint_torques_[point](i);
+        double joint_torque = evaluation_manager->joint_torques_[evaluation_manager->getStateIndex(point)](i);
 
         // TODO
         double weight = 1.0;
@@ -485,7 +569,7 @@ bool TrajectoryCostTorque::evaluate(const NewEvalManager* evaluation_manager, in
         cost += weight * joint_torque * joint_torque;
 	}
 
-	TIME_PROFILER_END_TIMER(Torque);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), Torque);
 
 	return is_feasible;
 }
@@ -502,38 +586,38 @@ bool TrajectoryCostRVO::evaluate(const NewEvalManager* evaluation_manager,
 	return is_feasible;
 }
 
-ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(FTR)
+void TrajectoryCostFTR::initialize(const NewEvalManager* evaluation_manager)
+{
+	// TODO:
+	const char* endeffector_chain_group_names[] =
+	{ "left_leg", "right_leg", "left_arm", "right_arm" };
+
+    endeffector_chain_groups_.clear();
+    for (int i = 0; i < 4; ++i)
+        endeffector_chain_groups_.push_back(bindJointModelGroup(evaluation_manager, endeffector_chain_group_names[i]));
+}
+
 bool TrajectoryCostFTR::evaluate(const NewEvalManager* evaluation_manager,
 								 int point, double& cost) const
 {
 	bool is_feasible = true;
 	cost = 0;
 
-	TIME_PROFILER_START_TIMER(FTR);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), FTR);
 
     const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
     const ItompPlanningGroupConstPtr& planning_group = evaluation_manager->getPlanningGroup();
     const RigidBodyDynamics::Model& model = evaluation_manager->getRBDLModel(point);
-    const Eigen::VectorXd& q = trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                                                ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
-
-	// TODO:
-	const char* endeffector_chain_group_names[] =
-	{ "left_leg", "right_leg", "left_arm", "right_arm" };
-
-	std::vector<double> positions;
-	int num_joints = q.cols();
-	positions.resize(num_joints);
-
+    Eigen::VectorXd point_buffer;
     robot_state::RobotStatePtr robot_state = evaluation_manager->getRobotState(point);
-	robot_state->setVariablePositions(q.data());
+    robot_state->setVariablePositions(trajectory->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getPointData(point, point_buffer));
 
-    const std::vector<ContactVariables>& contact_variables = evaluation_manager->contact_variables_[point];
+    const std::vector<ContactVariables>& contact_variables = evaluation_manager->contact_variables_[evaluation_manager->getStateIndex(point)];
 	int num_contacts = contact_variables.size();
 	for (int i = 0; i < num_contacts; ++i)
 	{
-		std::string chain_name = endeffector_chain_group_names[i];
-        Eigen::MatrixXd jacobianFull = (robot_state->getJacobian(evaluation_manager->getItompRobotModel()->getMoveitRobotModel()->getJointModelGroup(chain_name)));
+        Eigen::MatrixXd jacobianFull = (robot_state->getJacobian(endeffector_chain_groups_[i]));
         Eigen::MatrixXd jacobian = jacobianFull.block(0, 0, 3, jacobianFull.cols());
 		Eigen::MatrixXd jacobian_transpose = jacobian.transpose();
 
@@ -572,16 +656,11 @@ bool TrajectoryCostFTR::evaluate(const NewEvalManager* evaluation_manager,
 		}
 	}
 
-	TIME_PROFILER_END_TIMER(FTR);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), FTR);
 
 	return is_feasible;
 }
 
-namespace
-{
-std::vector<rom::ROM> roms_;
-}
-
 void TrajectoryCostROM::initialize(const NewEvalManager* evaluation_manager)
 {
 	// load rom files
@@ -592,10 +671,74 @@ void TrajectoryCostROM::initialize(const NewEvalManager* evaluation_manager)
 	std::string rightLegRom(source + "right_ankle_itomp.rom");
 	std::string leftArmRom(source + "left_arm_itomp.rom");
 	std::string leftLegRom(source + "left_ankle_itomp.rom");
-	roms_.push_back(rom::ROMFromFile(rightArmRom));
-	roms_.push_back(rom::ROMFromFile(rightLegRom));
-	roms_.push_back(rom::ROMFromFile(leftArmRom));
-	roms_.push_back(rom::ROMFromFile(leftLegRom));
+	roms_.clear();
+	roms_.push_back(rom::CachedROMFromFile(rightArmRom));
+	roms_.push_back(rom::CachedROMFromFile(rightLegRom));
+	roms_.push_back(rom::CachedROMFromFile(leftArmRom));
+	roms_.push_back(rom::CachedROMFromFile(leftLegRom));
+
+	// (z, y, x) rotation joints of the roms, in the order of roms_
+	const char* rom_joint_names[] =
+	{
+		"upper_right_arm_z_joint", "upper_right_arm_y_joint", "upper_right_arm_x_joint",
+		"upper_right_leg_z_joint", "upper_right_leg_y_joint", "upper_right_leg_x_joint",
+		"upper_left_arm_z_joint", "upper_left_arm_y_joint", "upper_left_arm_x_joint",
+		"upper_left_leg_z_joint", "upper_left_leg_y_joint", "upper_left_leg_x_joint",
+	};
+	rom_joint_indices_.resize(12);
+	for (int i = 0; i < 12; ++i)
+		rom_joint_indices_[i] = bindJointIndex(evaluation_manager, rom_joint_names[i]);
+
+	batch_evaluation_manager_ = NULL;
+}
+
+void TrajectoryCostROM::preEvaluate(const NewEvalManager* evaluation_manager)
+{
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), ROM);
+
+	// evaluate the dirty points of a limb in one call. the costs of the other points are not evaluated
+	const ElementTrajectoryConstPtr joint_trajectory = evaluation_manager->getTrajectory()->getElementTrajectory(
+                ItompTrajectory::COMPONENT_TYPE_POSITION, ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+	int num_points = evaluation_manager->getTrajectory()->getNumPoints();
+
+	if (batch_costs_.rows() != num_points)
+		batch_costs_ = Eigen::VectorXd::Zero(num_points);
+	batch_points_.clear();
+	for (int point = 0; point < num_points; ++point)
+	{
+		if (evaluation_manager->dirty_points_[point])
+		{
+			batch_points_.push_back(point);
+			batch_costs_(point) = 0.0;
+		}
+	}
+	int num_batch_points = batch_points_.size();
+
+	batch_residuals_.resize(num_batch_points);
+	batch_angles_.resize(num_batch_points, 3);
+	for (int i = 0; i < roms_.size(); ++i)
+	{
+		// (z, y, x) angles of the dirty points, one column per angle
+		for (int p = 0; p < num_batch_points; ++p)
+		{
+			ElementTrajectory::ConstPoint q = joint_trajectory->getPoint(batch_points_[p]);
+			for (int j = 0; j < 3; ++j)
+				batch_angles_(p, j) = q(rom_joint_indices_[3 * i + j]);
+		}
+		roms_[i].ResidualRadius(batch_angles_.col(0).data(), batch_angles_.col(1).data(), batch_angles_.col(2).data(),
+								num_batch_points, batch_residuals_.data());
+
+		for (int p = 0; p < num_batch_points; ++p)
+			batch_costs_(batch_points_[p]) += batch_residuals_(p);
+	}
+	batch_evaluation_manager_ = evaluation_manager;
+
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), ROM);
+}
+
+void TrajectoryCostROM::postEvaluate(const NewEvalManager* evaluation_manager)
+{
+	batch_evaluation_manager_ = NULL;
 }
 
 bool TrajectoryCostROM::evaluate(const NewEvalManager* evaluation_manager,
@@ -604,7 +747,14 @@ bool TrajectoryCostROM::evaluate(const NewEvalManager* evaluation_manager,
 	bool is_feasible = true;
 	cost = 0;
 
-	TIME_PROFILER_START_TIMER(ROM);
+	// full trajectory evaluation, computed in preEvaluate
+	if (evaluation_manager == batch_evaluation_manager_)
+	{
+		cost = batch_costs_(point);
+		return is_feasible;
+	}
+
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), ROM);
 
     const ItompTrajectoryConstPtr trajectory = evaluation_manager->getTrajectory();
 
@@ -614,29 +764,15 @@ bool TrajectoryCostROM::evaluate(const NewEvalManager* evaluation_manager,
 
 	// implement
 	// first right arm rom. Need to take the negative of the rom (if positive, inside rom, negative is outside)
-	double x, y, z;
-    z = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_arm_z_joint"));
-    y = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_arm_y_joint"));
-    x = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_arm_x_joint"));
-
-	cost += roms_[0].ResidualRadius(z, y, x);
-
-    z = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_leg_z_joint"));
-    y = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_leg_y_joint"));
-    x = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_right_leg_x_joint"));
-	cost += roms_[1].ResidualRadius(z, y, x);
-
-    z = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_arm_z_joint"));
-    y = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_arm_y_joint"));
-    x = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_arm_x_joint"));
-	cost += roms_[2].ResidualRadius(z, y, x);
-
-    z = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_leg_z_joint"));
-    y = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_leg_y_joint"));
-    x = q(evaluation_manager->getItompRobotModel()->jointNameToRbdlNumber("upper_left_leg_x_joint"));
-	cost += roms_[3].ResidualRadius(z, y, x);
+	for (int i = 0; i < roms_.size(); ++i)
+	{
+		double z = q(rom_joint_indices_[3 * i]);
+		double y = q(rom_joint_indices_[3 * i + 1]);
+		double x = q(rom_joint_indices_[3 * i + 2]);
+		cost += roms_[i].ResidualRadius(z, y, x);
+	}
 
-	TIME_PROFILER_END_TIMER(ROM);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), ROM);
 
 	return is_feasible;
 }
@@ -669,12 +805,12 @@ ITOMP_TRAJECTORY_COST_EMPTY_INIT_FUNC(FrictionCone)
 bool TrajectoryCostFrictionCone::evaluate(
 	const NewEvalManager* evaluation_manager, int point, double& cost) const
 {
-	TIME_PROFILER_START_TIMER(FrictionCone);
+	TIME_PROFILER_START_TIMER(evaluation_manager->getPerformanceProfiler(), FrictionCone);
 
 	bool is_feasible = true;
 	cost = 0;
 
-    const std::vector<ContactVariables>& contact_variables = evaluation_manager->contact_variables_[point];
+    const std::vector<ContactVariables>& contact_variables = evaluation_manager->contact_variables_[evaluation_manager->getStateIndex(point)];
 	int num_contacts = contact_variables.size();
 	for (int i = 0; i < num_contacts; ++i)
 	{
@@ -703,7 +839,7 @@ bool TrajectoryCostFrictionCone::evaluate(
 		}
 	}
 
-	TIME_PROFILER_END_TIMER(FrictionCone);
+	TIME_PROFILER_END_TIMER(evaluation_manager->getPerformanceProfiler(), FrictionCone);
 
 	return is_feasible;
 }
@@ -21,6 +21,20 @@ ItompRobotModel::~ItompRobotModel()
 }
 
 bool ItompRobotModel::init(const robot_model::RobotModelConstPtr& robot_model)
+{
+	// get the urdf as a string:
+	string urdf_string;
+	ros::NodeHandle node_handle("~");
+    robot_model_loader::RobotModelLoader robot_model_loader("robot_description");
+    if (!node_handle.getParam(robot_model_loader.getRobotDescription(), urdf_string))
+	{
+		return false;
+	}
+
+    return init(robot_model, urdf_string);
+}
+
+bool ItompRobotModel::init(const robot_model::RobotModelConstPtr& robot_model, const std::string& urdf_string)
 {
 	moveit_robot_model_ = robot_model;
     ItompRobotModelIKHelper::getInstance()->initialize(robot_model);
@@ -35,15 +49,6 @@ bool ItompRobotModel::init(const robot_model::RobotModelConstPtr& robot_model)
             ROS_INFO("[%d] %s", urdf_joints[i]->getFirstVariableIndex(), urdf_joints[i]->getName().c_str());
     }
 
-	// get the urdf as a string:
-	string urdf_string;
-	ros::NodeHandle node_handle("~");
-    robot_model_loader::RobotModelLoader robot_model_loader("robot_description");
-    if (!node_handle.getParam(robot_model_loader.getRobotDescription(), urdf_string))
-	{
-		return false;
-	}
-
 	// RBDL
     std::vector<std::vector<unsigned int> > rbdl_affected_body_ids_vector(urdf_joints.size() + 1);
 	////////////////////////////////////////////////////////////////////////////
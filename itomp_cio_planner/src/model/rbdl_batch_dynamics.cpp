@@ -0,0 +1,378 @@
+#include <itomp_cio_planner/model/rbdl_batch_dynamics.h>
+#include <ros/assert.h>
+
+using namespace RigidBodyDynamics;
+using namespace RigidBodyDynamics::Math;
+namespace itomp_cio_planner
+{
+
+BatchKinematicsAndDynamics::BatchKinematicsAndDynamics()
+    : is_initialized_(false), is_supported_(false), max_num_points_(0)
+{
+
+}
+
+BatchKinematicsAndDynamics::~BatchKinematicsAndDynamics()
+{
+
+}
+
+void BatchKinematicsAndDynamics::initialize(const Model& model, int max_num_points)
+{
+    is_initialized_ = true;
+    is_supported_ = true;
+    gravity_ = model.gravity;
+
+    bodies_.resize(model.mBodies.size());
+    for (unsigned int i = 1; i < model.mBodies.size(); ++i)
+    {
+        const Joint& joint = model.mJoints[i];
+        BodyData& body = bodies_[i];
+
+        switch (joint.mJointType)
+        {
+        case JointTypeRevolute:
+        case JointTypeRevoluteX:
+        case JointTypeRevoluteY:
+        case JointTypeRevoluteZ:
+            body.is_revolute = true;
+            break;
+
+        case JointTypePrismatic:
+            body.is_revolute = false;
+            break;
+
+        default:
+            is_supported_ = false;
+            break;
+        }
+        if (!is_supported_ || joint.mDoFCount != 1)
+        {
+            is_supported_ = false;
+            bodies_.clear();
+            return;
+        }
+
+        body.lambda = model.lambda[i];
+        body.q_index = joint.q_index;
+        body.is_virtual = model.mBodies[i].mIsVirtual;
+        for (int j = 0; j < 6; ++j)
+            body.S[j] = joint.mJointAxes[0][j];
+
+        // E_J = P + cos(q) * C + sin(q) * K, r_J = q * axis
+        Matrix3d P, C, K;
+        Vector3d axis;
+        if (body.is_revolute)
+        {
+            // Xrot(q, axis)
+            const Vector3d rotation_axis(joint.mJointAxes[0][0], joint.mJointAxes[0][1], joint.mJointAxes[0][2]);
+            P = rotation_axis * rotation_axis.transpose();
+            C = Matrix3d::Identity() - P;
+            K = Matrix3d(0., rotation_axis[2], -rotation_axis[1],
+                         -rotation_axis[2], 0., rotation_axis[0],
+                         rotation_axis[1], -rotation_axis[0], 0.);
+            axis.setZero();
+        }
+        else
+        {
+            // Xtrans(q * axis)
+            P = Matrix3d::Identity();
+            C.setZero();
+            K.setZero();
+            axis = Vector3d(joint.mJointAxes[0][3], joint.mJointAxes[0][4], joint.mJointAxes[0][5]);
+        }
+
+        // X_J * X_T
+        const SpatialTransform& X_T = model.X_T[i];
+        body.E_P = P * X_T.E;
+        body.E_C = C * X_T.E;
+        body.E_K = K * X_T.E;
+        body.r_T = X_T.r;
+        body.r_q = X_T.E.transpose() * axis;
+        body.I = model.I[i];
+    }
+
+    // update() works on the first rows of the arrays
+    max_num_points_ = max_num_points;
+    int num_bodies = bodies_.size();
+    X_lambda_.resize(num_bodies);
+    X_base_.resize(num_bodies);
+    v_.resize(num_bodies);
+    c_.resize(num_bodies);
+    a_.resize(num_bodies);
+    f_.resize(num_bodies);
+    for (int i = 0; i < num_bodies; ++i)
+    {
+        X_lambda_[i].resize(max_num_points, 12);
+        X_base_[i].resize(max_num_points, 12);
+        v_[i].resize(max_num_points, 6);
+        c_[i].resize(max_num_points, 6);
+        a_[i].resize(max_num_points, 6);
+        f_[i].resize(max_num_points, 6);
+    }
+    cos_sin_q_.resize(max_num_points, 2);
+    temp_.resize(max_num_points, 6);
+    force_.resize(max_num_points, 6);
+    load_.resize(max_num_points);
+
+    // the root body is the same for all points, it is not written by update()
+    X_base_[0].setZero();
+    X_base_[0].col(0).setOnes();
+    X_base_[0].col(4).setOnes();
+    X_base_[0].col(8).setOnes();
+    v_[0].setZero();
+    a_[0].setZero();
+    for (int j = 0; j < 3; ++j)
+        a_[0].col(j + 3).setConstant(gravity_[j]);
+}
+
+void BatchKinematicsAndDynamics::update(std::vector<Model>& models, int point_begin, int point_end,
+                                        const Eigen::MatrixXd& Q, const Eigen::MatrixXd& QDot, const Eigen::MatrixXd& QDDot,
+                                        std::vector<Eigen::VectorXd>& Tau,
+                                        const std::vector<std::vector<SpatialVector> >* f_ext,
+                                        const std::vector<std::vector<double> >* joint_forces)
+{
+    ROS_ASSERT(is_supported_);
+
+    int num_points = point_end - point_begin;
+    int num_bodies = bodies_.size();
+    ROS_ASSERT(num_points <= max_num_points_);
+    if (tau_.cols() != Q.cols())
+        tau_.resize(max_num_points_, Q.cols());
+
+    for (int i = 1; i < num_bodies; ++i)
+    {
+        const BodyData& body = bodies_[i];
+        const unsigned int lambda = body.lambda;
+        const Eigen::Block<const Eigen::MatrixXd> q = Q.block(0, body.q_index, num_points, 1);
+        const Eigen::Block<const Eigen::MatrixXd> q_dot = QDot.block(0, body.q_index, num_points, 1);
+        const Eigen::Block<const Eigen::MatrixXd> q_ddot = QDDot.block(0, body.q_index, num_points, 1);
+
+        // forward kinematics
+        SpatialTransformBlock X_lambda = X_lambda_[i].topRows(num_points);
+        if (body.is_revolute)
+        {
+            cos_sin_q_.col(0).head(num_points) = q.array().cos();
+            cos_sin_q_.col(1).head(num_points) = q.array().sin();
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int k = 0; k < 3; ++k)
+                    X_lambda.col(3 * r + k) = body.E_P(r, k) + body.E_C(r, k) * cos_sin_q_.col(0).head(num_points)
+                                              + body.E_K(r, k) * cos_sin_q_.col(1).head(num_points);
+                X_lambda.col(9 + r).setConstant(body.r_T[r]);
+            }
+        }
+        else
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int k = 0; k < 3; ++k)
+                    X_lambda.col(3 * r + k).setConstant(body.E_P(r, k));
+                X_lambda.col(9 + r) = body.r_T[r] + body.r_q[r] * q.array();
+            }
+        }
+        multiply(X_lambda, X_base_[lambda].topRows(num_points), X_base_[i].topRows(num_points));
+
+        SpatialVectorBlock v = v_[i].topRows(num_points);
+        apply(X_lambda, v_[lambda].topRows(num_points), v);
+        for (int j = 0; j < 6; ++j)
+            v.col(j) += body.S[j] * q_dot.array();
+
+        // c = crossm(v, S * q_dot)
+        const double* S = body.S;
+        SpatialVectorBlock c = c_[i].topRows(num_points);
+        c.col(0) = q_dot.array() * (-v.col(2) * S[1] + v.col(1) * S[2]);
+        c.col(1) = q_dot.array() * (v.col(2) * S[0] - v.col(0) * S[2]);
+        c.col(2) = q_dot.array() * (-v.col(1) * S[0] + v.col(0) * S[1]);
+        c.col(3) = q_dot.array() * (-v.col(5) * S[1] + v.col(4) * S[2] - v.col(2) * S[4] + v.col(1) * S[5]);
+        c.col(4) = q_dot.array() * (v.col(5) * S[0] - v.col(3) * S[2] + v.col(2) * S[3] - v.col(0) * S[5]);
+        c.col(5) = q_dot.array() * (-v.col(4) * S[0] + v.col(3) * S[1] - v.col(1) * S[3] + v.col(0) * S[4]);
+
+        SpatialVectorBlock a = a_[i].topRows(num_points);
+        apply(X_lambda, a_[lambda].topRows(num_points), a);
+        for (int j = 0; j < 6; ++j)
+            a.col(j) += c.col(j) + S[j] * q_ddot.array();
+
+        // inverse dynamics
+        SpatialVectorBlock f = f_[i].topRows(num_points);
+        if (!body.is_virtual)
+            computeBodyForce(body.I, v, a, f);
+        else
+            f.setZero();
+
+        // the forces are applied to all points if any point has a non-zero force
+        if (joint_forces != NULL)
+        {
+            bool has_force = false;
+            for (int p = 0; p < num_points; ++p)
+            {
+                load_(p) = (*joint_forces)[point_begin + p][i];
+                has_force |= (load_(p) != 0.0);
+            }
+            if (has_force)
+            {
+                for (int j = 0; j < 6; ++j)
+                    f.col(j) += S[j] * load_.head(num_points);
+            }
+        }
+
+        if (f_ext != NULL)
+        {
+            bool has_force = false;
+            for (int p = 0; p < num_points; ++p)
+            {
+                const SpatialVector& ext_force = (*f_ext)[point_begin + p][i];
+                for (int j = 0; j < 6; ++j)
+                    force_(p, j) = ext_force[j];
+                has_force |= (ext_force != SpatialVectorZero);
+            }
+            if (has_force)
+                addApplyAdjoint(X_base_[i].topRows(num_points), force_.topRows(num_points), f);
+        }
+    }
+
+    for (int i = num_bodies - 1; i > 0; --i)
+    {
+        const BodyData& body = bodies_[i];
+        const SpatialVectorBlock f = f_[i].topRows(num_points);
+
+        tau_.col(body.q_index).head(num_points).array() = body.S[0] * f.col(0) + body.S[1] * f.col(1) + body.S[2] * f.col(2)
+                                         + body.S[3] * f.col(3) + body.S[4] * f.col(4) + body.S[5] * f.col(5);
+
+        if (body.lambda != 0)
+            addApplyTranspose(X_lambda_[i].topRows(num_points), f, f_[body.lambda].topRows(num_points));
+    }
+
+    writeBack(models, point_begin, point_end, Tau);
+}
+
+void BatchKinematicsAndDynamics::writeBack(std::vector<Model>& models, int point_begin, int point_end,
+        std::vector<Eigen::VectorXd>& Tau) const
+{
+    // X_J and v_J are not written, they are computed by jcalc() before they are used
+    SpatialVector spatial_gravity(0., 0., 0., gravity_[0], gravity_[1], gravity_[2]);
+    for (int point = point_begin; point < point_end; ++point)
+    {
+        models[point].v[0].setZero();
+        models[point].a[0] = spatial_gravity;
+        Tau[point] = tau_.row(point - point_begin).transpose();
+    }
+
+    for (int i = 1; i < bodies_.size(); ++i)
+    {
+        for (int p = 0; p < point_end - point_begin; ++p)
+        {
+            Model& model = models[point_begin + p];
+
+            SpatialTransform& X_lambda = model.X_lambda[i];
+            SpatialTransform& X_base = model.X_base[i];
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    X_lambda.E(r, k) = X_lambda_[i](p, 3 * r + k);
+                    X_base.E(r, k) = X_base_[i](p, 3 * r + k);
+                }
+                X_lambda.r[r] = X_lambda_[i](p, 9 + r);
+                X_base.r[r] = X_base_[i](p, 9 + r);
+            }
+
+            for (int j = 0; j < 6; ++j)
+            {
+                model.v[i][j] = v_[i](p, j);
+                model.c[i][j] = c_[i](p, j);
+                model.a[i][j] = a_[i](p, j);
+                model.f[i][j] = f_[i](p, j);
+            }
+        }
+    }
+}
+
+void BatchKinematicsAndDynamics::apply(const SpatialTransformBlock& X, const SpatialVectorBlock& v, SpatialVectorBlock out)
+{
+    SpatialVectorBlock temp = temp_.topRows(X.rows());
+
+    // v - r x w
+    temp.col(0) = v.col(3) - X.col(10) * v.col(2) + X.col(11) * v.col(1);
+    temp.col(1) = v.col(4) - X.col(11) * v.col(0) + X.col(9) * v.col(2);
+    temp.col(2) = v.col(5) - X.col(9) * v.col(1) + X.col(10) * v.col(0);
+
+    for (int r = 0; r < 3; ++r)
+    {
+        out.col(r) = X.col(3 * r) * v.col(0) + X.col(3 * r + 1) * v.col(1) + X.col(3 * r + 2) * v.col(2);
+        out.col(r + 3) = X.col(3 * r) * temp.col(0) + X.col(3 * r + 1) * temp.col(1) + X.col(3 * r + 2) * temp.col(2);
+    }
+}
+
+void BatchKinematicsAndDynamics::addApplyTranspose(const SpatialTransformBlock& X, const SpatialVectorBlock& f, SpatialVectorBlock out)
+{
+    SpatialVectorBlock temp = temp_.topRows(X.rows());
+
+    // E^T * f
+    for (int k = 0; k < 3; ++k)
+        temp.col(k) = X.col(k) * f.col(3) + X.col(3 + k) * f.col(4) + X.col(6 + k) * f.col(5);
+
+    out.col(0) += X.col(0) * f.col(0) + X.col(3) * f.col(1) + X.col(6) * f.col(2)
+                  - X.col(11) * temp.col(1) + X.col(10) * temp.col(2);
+    out.col(1) += X.col(1) * f.col(0) + X.col(4) * f.col(1) + X.col(7) * f.col(2)
+                  + X.col(11) * temp.col(0) - X.col(9) * temp.col(2);
+    out.col(2) += X.col(2) * f.col(0) + X.col(5) * f.col(1) + X.col(8) * f.col(2)
+                  - X.col(10) * temp.col(0) + X.col(9) * temp.col(1);
+    for (int k = 0; k < 3; ++k)
+        out.col(k + 3) += temp.col(k);
+}
+
+void BatchKinematicsAndDynamics::addApplyAdjoint(const SpatialTransformBlock& X, const SpatialVectorBlock& f, SpatialVectorBlock out)
+{
+    SpatialVectorBlock temp = temp_.topRows(X.rows());
+
+    // n - r x f
+    temp.col(0) = f.col(0) - (X.col(10) * f.col(5) - X.col(11) * f.col(4));
+    temp.col(1) = f.col(1) - (X.col(11) * f.col(3) - X.col(9) * f.col(5));
+    temp.col(2) = f.col(2) - (X.col(9) * f.col(4) - X.col(10) * f.col(3));
+
+    for (int r = 0; r < 3; ++r)
+    {
+        out.col(r) += X.col(3 * r) * temp.col(0) + X.col(3 * r + 1) * temp.col(1) + X.col(3 * r + 2) * temp.col(2);
+        out.col(r + 3) += X.col(3 * r) * f.col(3) + X.col(3 * r + 1) * f.col(4) + X.col(3 * r + 2) * f.col(5);
+    }
+}
+
+void BatchKinematicsAndDynamics::multiply(const SpatialTransformBlock& X1, const SpatialTransformBlock& X2, SpatialTransformBlock out)
+{
+    // (E1 * E2, r2 + E2^T * r1)
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int k = 0; k < 3; ++k)
+            out.col(3 * r + k) = X1.col(3 * r) * X2.col(k) + X1.col(3 * r + 1) * X2.col(3 + k) + X1.col(3 * r + 2) * X2.col(6 + k);
+        out.col(9 + r) = X2.col(9 + r) + X2.col(r) * X1.col(9) + X2.col(3 + r) * X1.col(10) + X2.col(6 + r) * X1.col(11);
+    }
+}
+
+void BatchKinematicsAndDynamics::computeBodyForce(const SpatialRigidBodyInertia& I,
+        const SpatialVectorBlock& v, const SpatialVectorBlock& a, SpatialVectorBlock out)
+{
+    const Vector3d& h = I.h;
+    SpatialVectorBlock temp = temp_.topRows(v.rows());
+
+    // I * v
+    temp.col(0) = I.Ixx * v.col(0) + I.Iyx * v.col(1) + I.Izx * v.col(2) + h[1] * v.col(5) - h[2] * v.col(4);
+    temp.col(1) = I.Iyx * v.col(0) + I.Iyy * v.col(1) + I.Izy * v.col(2) + h[2] * v.col(3) - h[0] * v.col(5);
+    temp.col(2) = I.Izx * v.col(0) + I.Izy * v.col(1) + I.Izz * v.col(2) + h[0] * v.col(4) - h[1] * v.col(3);
+    temp.col(3) = I.m * v.col(3) - h[1] * v.col(2) + h[2] * v.col(1);
+    temp.col(4) = I.m * v.col(4) - h[2] * v.col(0) + h[0] * v.col(2);
+    temp.col(5) = I.m * v.col(5) - h[0] * v.col(1) + h[1] * v.col(0);
+
+    // I * a + crossf(v, I * v)
+    out.col(0) = I.Ixx * a.col(0) + I.Iyx * a.col(1) + I.Izx * a.col(2) + h[1] * a.col(5) - h[2] * a.col(4)
+                 - v.col(2) * temp.col(1) + v.col(1) * temp.col(2) - v.col(5) * temp.col(4) + v.col(4) * temp.col(5);
+    out.col(1) = I.Iyx * a.col(0) + I.Iyy * a.col(1) + I.Izy * a.col(2) + h[2] * a.col(3) - h[0] * a.col(5)
+                 + v.col(2) * temp.col(0) - v.col(0) * temp.col(2) + v.col(5) * temp.col(3) - v.col(3) * temp.col(5);
+    out.col(2) = I.Izx * a.col(0) + I.Izy * a.col(1) + I.Izz * a.col(2) + h[0] * a.col(4) - h[1] * a.col(3)
+                 - v.col(1) * temp.col(0) + v.col(0) * temp.col(1) - v.col(4) * temp.col(3) + v.col(3) * temp.col(4);
+    out.col(3) = I.m * a.col(3) - h[1] * a.col(2) + h[2] * a.col(1) - v.col(2) * temp.col(4) + v.col(1) * temp.col(5);
+    out.col(4) = I.m * a.col(4) - h[2] * a.col(0) + h[0] * a.col(2) + v.col(2) * temp.col(3) - v.col(0) * temp.col(5);
+    out.col(5) = I.m * a.col(5) - h[0] * a.col(1) + h[1] * a.col(0) - v.col(1) * temp.col(3) + v.col(0) * temp.col(4);
+}
+
+}
@@ -314,6 +314,21 @@ void UpdatePartialKinematics(RigidBodyDynamics::Model & model,
 	}
 }
 
+void InverseKinematics6DWorkspace::resize(unsigned int num_bodies, unsigned int qdot_size)
+{
+    unsigned int num_rows = 6 * num_bodies;
+    if (J.rows() != num_rows || J.cols() != qdot_size)
+    {
+        J.resize(num_rows, qdot_size);
+        G.resize(6, qdot_size);
+        e.resize(num_rows);
+        JJT_lambda2_I.resize(num_rows, num_rows);
+        z.resize(num_rows);
+        delta_theta.resize(qdot_size);
+    }
+    target_euler.resize(num_bodies);
+}
+
 bool InverseKinematics6D (
         Model &model,
         const VectorNd &Qinit,
@@ -326,100 +341,112 @@ bool InverseKinematics6D (
         unsigned int max_iter
         )
 {
+    InverseKinematics6DWorkspace workspace;
+    return InverseKinematics6D(model, Qinit, body_id, target_pos, target_ori, Qres, workspace, step_tol, lambda, max_iter);
+}
+
+bool InverseKinematics6D (
+        Model &model,
+        const VectorNd &Qinit,
+        const std::vector<unsigned int>& body_id,
+        const std::vector<Vector3d>& target_pos,
+        const std::vector<Matrix3d>& target_ori,
+        VectorNd &Qres,
+        InverseKinematics6DWorkspace& workspace,
+        double step_tol,
+        double lambda,
+        unsigned int max_iter
+        )
+{
 
     assert (Qinit.size() == model.q_size);
     assert (body_id.size() == target_pos.size());
 
-    MatrixNd J = MatrixNd::Zero(6 * body_id.size(), model.qdot_size);
-    VectorNd e = VectorNd::Zero(6 * body_id.size());
+    workspace.resize(body_id.size(), model.qdot_size);
+    MatrixNd& J = workspace.J;
+    MatrixNd& G = workspace.G;
+    VectorNd& e = workspace.e;
+    MatrixNd& JJTe_lambda2_I = workspace.JJT_lambda2_I;
+    VectorNd& z = workspace.z;
+    VectorNd& delta_theta = workspace.delta_theta;
+
+    // the targets do not change during the iterations
+    for (unsigned int k = 0; k < body_id.size(); k++)
+        workspace.target_euler[k] = target_ori[k].eulerAngles(0, 1, 2);
 
     Qres = Qinit;
 
     for (unsigned int ik_iter = 0; ik_iter < max_iter; ik_iter++) {
         UpdateKinematicsCustom (model, &Qres, NULL, NULL);
         for (unsigned int k = 0; k < body_id.size(); k++) {
-            MatrixNd G (MatrixNd::Zero(6, model.qdot_size));
+            G.setZero();
             CalcPointJacobian6D(model, Qres, body_id[k], Vector3d::Zero(), G, false);
-            Vector3d point_base = CalcBodyToBaseCoordinates (model, Qres, body_id[k], Vector3d::Zero(), false);
-            LOG << "current_pos = " << point_base.transpose() << std::endl;
+            J.block(k * 6, 0, 6, model.qdot_size) = G;
 
-            Vector3d target_euler = target_ori[k].eulerAngles(0, 1, 2);
+            Vector3d point_base = CalcBodyToBaseCoordinates (model, Qres, body_id[k], Vector3d::Zero(), false);
             Matrix3d body_world_ori = CalcBodyWorldOrientation(model, Qres, body_id[k], false);
             Vector3d body_euler = body_world_ori.eulerAngles(0, 1, 2);
 
-            for (unsigned int i = 0; i < 6; i++) {
-                for (unsigned int j = 0; j < model.qdot_size; j++) {
-                    unsigned int row = k * 6 + i;
-                    LOG << "i = " << i << " j = " << j << " k = " << k << " row = " << row << " col = " << j << std::endl;
-                    J(row, j) = G (i,j);
-                }
-
-                if (i < 3)
-                {
-                    e[k * 6 + i] = -(target_euler[i] - body_euler[i]);
-                }
-                else
-                {
-                    e[k * 6 + i] = target_pos[k][i - 3] - point_base[i - 3];
-                }
-            }
-
-            LOG << J << std::endl;
-
-            // abort if we are getting "close"
-            if (e.norm() < step_tol) {
-                LOG << "Reached target close enough after " << ik_iter << " steps" << std::endl;
-                return true;
-            }
+            e.segment<3>(k * 6) = body_euler - workspace.target_euler[k];
+            e.segment<3>(k * 6 + 3) = target_pos[k] - point_base;
         }
 
-        LOG << "J = " << J << std::endl;
-        LOG << "e = " << e.transpose() << std::endl;
-
-        //std::cout << "iteration " << ik_iter << " " << e.norm() << std::endl;
+        // abort if we are getting "close"
+        if (e.norm() < step_tol) {
+            LOG << "Reached target close enough after " << ik_iter << " steps" << std::endl;
+            return true;
+        }
 
-        MatrixNd JJTe_lambda2_I = J * J.transpose() + lambda*lambda * MatrixNd::Identity(e.size(), e.size());
+        // damped least squares step. J * J^T + lambda^2 * I is symmetric positive definite
+        JJTe_lambda2_I.noalias() = J * J.transpose();
+        JJTe_lambda2_I.diagonal().array() += lambda * lambda;
 
-        VectorNd z (body_id.size() * 6);
 #ifndef RBDL_USE_SIMPLE_MATH
-        z = JJTe_lambda2_I.colPivHouseholderQr().solve (e);
+        z = JJTe_lambda2_I.ldlt().solve (e);
 #else
         bool solve_successful = LinSolveGaussElimPivot (JJTe_lambda2_I, e, z);
         assert (solve_successful);
 #endif
 
-        LOG << "z = " << z << std::endl;
-
-        VectorNd delta_theta = J.transpose() * z;
-        LOG << "change = " << delta_theta << std::endl;
-
-        Qres = Qres + delta_theta;
-        LOG << "Qres = " << Qres.transpose() << std::endl;
+        delta_theta.noalias() = J.transpose() * z;
+        Qres += delta_theta;
 
         if (delta_theta.norm() < step_tol) {
             LOG << "reached convergence after " << ik_iter << " steps" << std::endl;
             return true;
         }
+    }
 
-        VectorNd test_1 (z.size());
-        VectorNd test_res (z.size());
-
-        test_1.setZero();
+    return false;
+}
 
-        for (unsigned int i = 0; i < z.size(); i++) {
-            test_1[i] = 1.;
+void InverseKinematics6DBatch(std::vector<Model> &models,
+                              const std::vector<unsigned int>& points,
+                              const std::vector<InverseKinematics6DProblem>& problems,
+                              std::vector<VectorNd>& Q,
+                              std::vector<int>& results,
+                              double step_tol,
+                              double lambda,
+                              unsigned int max_iter)
+{
+    assert (points.size() == problems.size() && points.size() == Q.size());
 
-            VectorNd test_delta = J.transpose() * test_1;
+    int num_problems = problems.size();
+    results.resize(num_problems);
 
-            test_res[i] = test_delta.squaredNorm();
+    #pragma omp parallel if (num_problems > 1)
+    {
+        InverseKinematics6DWorkspace workspace;
 
-            test_1[i] = 0.;
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < num_problems; ++i)
+        {
+            const InverseKinematics6DProblem& problem = problems[i];
+            results[i] = InverseKinematics6D(models[points[i]], Q[i], problem.body_ids,
+                                             problem.target_positions, problem.target_orientations,
+                                             Q[i], workspace, step_tol, lambda, max_iter) ? 1 : 0;
         }
-
-        LOG << "test_res = " << test_res.transpose() << std::endl;
     }
-
-    return false;
 }
 
 void CalcPointJacobian6D (
@@ -0,0 +1,375 @@
+#include <itomp_cio_planner/optimization/checkpoint.h>
+#include <itomp_cio_planner/optimization/new_eval_manager.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
+#include <itomp_cio_planner/cost/trajectory_cost.h>
+#include <ros/ros.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace itomp_cio_planner
+{
+
+namespace
+{
+
+const char CHECKPOINT_MAGIC[4] = { 'I', 'T', 'C', 'K' };
+const int CHECKPOINT_VERSION = 1;
+
+void writeInt(ostream& out_stream, int value)
+{
+    out_stream.write(reinterpret_cast<const char*>(&value), sizeof(int));
+}
+
+void writeString(ostream& out_stream, const string& value)
+{
+    writeInt(out_stream, value.size());
+    out_stream.write(value.data(), value.size());
+}
+
+void writeMatrix(ostream& out_stream, const Eigen::MatrixXd& value)
+{
+    writeInt(out_stream, value.rows());
+    writeInt(out_stream, value.cols());
+    out_stream.write(reinterpret_cast<const char*>(value.data()), sizeof(double) * value.size());
+}
+
+bool readInt(istream& in_stream, int& value)
+{
+    in_stream.read(reinterpret_cast<char*>(&value), sizeof(int));
+    return in_stream.good();
+}
+
+bool readString(istream& in_stream, string& value)
+{
+    int size;
+    if (!readInt(in_stream, size) || size < 0)
+        return false;
+    value.resize(size);
+    if (size > 0)
+        in_stream.read(&value[0], size);
+    return in_stream.good();
+}
+
+bool readMatrix(istream& in_stream, Eigen::MatrixXd& value)
+{
+    int rows, cols;
+    if (!readInt(in_stream, rows) || !readInt(in_stream, cols) || rows < 0 || cols < 0)
+        return false;
+    value.resize(rows, cols);
+    in_stream.read(reinterpret_cast<char*>(value.data()), sizeof(double) * value.size());
+    return in_stream.good();
+}
+
+void printMatrixText(ostream& out_stream, const Eigen::MatrixXd& value)
+{
+    for (int i = 0; i < value.rows(); ++i)
+    {
+        out_stream << i << " : ";
+        for (int j = 0; j < value.cols(); ++j)
+            out_stream << fixed << value(i, j) << " ";
+        out_stream << endl;
+    }
+}
+
+void printMatrixCSV(ostream& out_stream, const string& section, const string& name, const Eigen::MatrixXd& value)
+{
+    for (int i = 0; i < value.rows(); ++i)
+        for (int j = 0; j < value.cols(); ++j)
+            out_stream << section << "," << name << "," << i << "," << j << "," << value(i, j) << "\n";
+}
+
+}
+
+Checkpoint::Checkpoint()
+    : phase_(0), trial_index_(0), num_contacts_(0)
+{
+
+}
+
+Checkpoint::~Checkpoint()
+{
+
+}
+
+void Checkpoint::capture(const NewEvalManager& evaluation_manager, int phase)
+{
+    const ItompTrajectoryConstPtr& trajectory = evaluation_manager.getTrajectory();
+
+    phase_ = phase;
+    trial_index_ = evaluation_manager.getPlanningContext()->getTrialIndex();
+
+    ItompTrajectory::ParameterVector parameters(trajectory->getNumParameters());
+    evaluation_manager.getParameters(parameters);
+    parameters_.resize(parameters.size());
+    for (int i = 0; i < parameters.size(); ++i)
+        parameters_(i) = parameters(i);
+
+    trajectory_names_.clear();
+    trajectories_.clear();
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+    {
+        for (int j = 0; j < ItompTrajectory::SUB_COMPONENT_TYPE_NUM; ++j)
+        {
+            ElementTrajectoryConstPtr element_trajectory = trajectory->getElementTrajectory(i, j);
+            trajectory_names_.push_back(element_trajectory->getName());
+            trajectories_.push_back(element_trajectory->getData());
+        }
+    }
+
+    const std::vector<std::vector<ContactVariables> >& contact_variables = evaluation_manager.getContactVariables();
+    num_contacts_ = contact_variables.empty() ? 0 : contact_variables[0].size();
+    contact_variables_.resize(contact_variables.size() * num_contacts_, CONTACT_VARIABLES_SIZE);
+    for (int point = 0; point < contact_variables.size(); ++point)
+    {
+        for (int i = 0; i < num_contacts_; ++i)
+        {
+            const ContactVariables& variables = contact_variables[point][i];
+            Eigen::MatrixXd::RowXpr row = contact_variables_.row(point * num_contacts_ + i);
+            int col = 0;
+            row.segment(col, 7) = variables.serialized_position_.transpose();
+            col += 7;
+            row.segment(col, NUM_ENDEFFECTOR_CONTACT_POINTS * 3) = variables.serialized_forces_.transpose();
+            col += NUM_ENDEFFECTOR_CONTACT_POINTS * 3;
+            row.segment(col, 3) = variables.projected_position_.transpose();
+            col += 3;
+            row.segment(col, 3) = variables.projected_orientation_.transpose();
+            col += 3;
+            for (int c = 0; c < NUM_ENDEFFECTOR_CONTACT_POINTS; ++c, col += 3)
+                row.segment(col, 3) = variables.projected_point_positions_[c].transpose();
+        }
+    }
+
+    const std::vector<TrajectoryCostPtr>& cost_functions = evaluation_manager.getTrajectoryCostManager()->getCostFunctionVector();
+    cost_names_.resize(cost_functions.size());
+    for (int c = 0; c < cost_functions.size(); ++c)
+        cost_names_[c] = cost_functions[c]->getName();
+    cost_matrix_ = evaluation_manager.getEvaluationCostMatrix();
+}
+
+bool Checkpoint::restore(NewEvalManager& evaluation_manager) const
+{
+    ItompTrajectoryPtr& trajectory = evaluation_manager.getTrajectoryNonConst();
+
+    if (parameters_.size() != trajectory->getNumParameters() ||
+            trajectories_.size() != ItompTrajectory::COMPONENT_TYPE_NUM * ItompTrajectory::SUB_COMPONENT_TYPE_NUM)
+    {
+        ROS_ERROR("Checkpoint of phase %d does not match the trajectory", phase_);
+        return false;
+    }
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+    {
+        for (int j = 0; j < ItompTrajectory::SUB_COMPONENT_TYPE_NUM; ++j)
+        {
+            const Eigen::MatrixXd& data = trajectories_[i * ItompTrajectory::SUB_COMPONENT_TYPE_NUM + j];
+            const ElementTrajectoryPtr& element_trajectory = trajectory->getElementTrajectory(i, j);
+            if (data.rows() != element_trajectory->getNumPoints() || data.cols() != element_trajectory->getNumElements())
+            {
+                ROS_ERROR("Checkpoint trajectory %s does not match the trajectory", trajectory_names_[i * ItompTrajectory::SUB_COMPONENT_TYPE_NUM + j].c_str());
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+        for (int j = 0; j < ItompTrajectory::SUB_COMPONENT_TYPE_NUM; ++j)
+            trajectory->getElementTrajectory(i, j)->getData() = trajectories_[i * ItompTrajectory::SUB_COMPONENT_TYPE_NUM + j];
+
+    ItompTrajectory::ParameterVector parameters(parameters_.size());
+    for (int i = 0; i < parameters_.size(); ++i)
+        parameters(i) = parameters_(i);
+    evaluation_manager.setParameters(parameters);
+
+    return true;
+}
+
+bool Checkpoint::write(const std::string& file_name) const
+{
+    ofstream out_stream(file_name.c_str(), ios::out | ios::binary);
+    if (!out_stream.is_open())
+    {
+        ROS_ERROR("Could not open checkpoint file %s", file_name.c_str());
+        return false;
+    }
+
+    out_stream.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeInt(out_stream, CHECKPOINT_VERSION);
+    writeInt(out_stream, phase_);
+    writeInt(out_stream, trial_index_);
+    writeMatrix(out_stream, parameters_);
+
+    writeInt(out_stream, trajectories_.size());
+    for (int i = 0; i < trajectories_.size(); ++i)
+    {
+        writeString(out_stream, trajectory_names_[i]);
+        writeMatrix(out_stream, trajectories_[i]);
+    }
+
+    writeInt(out_stream, num_contacts_);
+    writeMatrix(out_stream, contact_variables_);
+
+    writeInt(out_stream, cost_names_.size());
+    for (int i = 0; i < cost_names_.size(); ++i)
+        writeString(out_stream, cost_names_[i]);
+    writeMatrix(out_stream, cost_matrix_);
+
+    return out_stream.good();
+}
+
+bool Checkpoint::read(const std::string& file_name)
+{
+    ifstream in_stream(file_name.c_str(), ios::in | ios::binary);
+    if (!in_stream.is_open())
+    {
+        ROS_ERROR("Could not open checkpoint file %s", file_name.c_str());
+        return false;
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    int version;
+    in_stream.read(magic, sizeof(magic));
+    if (!in_stream.good() || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC) ||
+            !readInt(in_stream, version) || version != CHECKPOINT_VERSION)
+    {
+        ROS_ERROR("%s is not a checkpoint file of version %d", file_name.c_str(), CHECKPOINT_VERSION);
+        return false;
+    }
+
+    bool is_valid = readInt(in_stream, phase_) && readInt(in_stream, trial_index_);
+
+    Eigen::MatrixXd parameters;
+    is_valid = is_valid && readMatrix(in_stream, parameters) && parameters.cols() == 1;
+    if (is_valid)
+        parameters_ = parameters.col(0);
+
+    int num_trajectories;
+    is_valid = is_valid && readInt(in_stream, num_trajectories) && num_trajectories >= 0;
+    if (is_valid)
+    {
+        trajectory_names_.resize(num_trajectories);
+        trajectories_.resize(num_trajectories);
+    }
+    for (int i = 0; is_valid && i < num_trajectories; ++i)
+        is_valid = readString(in_stream, trajectory_names_[i]) && readMatrix(in_stream, trajectories_[i]);
+
+    is_valid = is_valid && readInt(in_stream, num_contacts_) && readMatrix(in_stream, contact_variables_);
+
+    int num_costs;
+    is_valid = is_valid && readInt(in_stream, num_costs) && num_costs >= 0;
+    if (is_valid)
+        cost_names_.resize(num_costs);
+    for (int i = 0; is_valid && i < num_costs; ++i)
+        is_valid = readString(in_stream, cost_names_[i]);
+    is_valid = is_valid && readMatrix(in_stream, cost_matrix_);
+
+    if (!is_valid)
+        ROS_ERROR("Checkpoint file %s is truncated", file_name.c_str());
+    return is_valid;
+}
+
+void Checkpoint::printText(std::ostream& out_stream) const
+{
+    out_stream.precision(std::numeric_limits<double>::digits10);
+    out_stream << "Phase " << phase_ << " trial " << trial_index_ << endl;
+
+    out_stream << "Parameters (" << parameters_.size() << ")" << endl;
+    for (int i = 0; i < parameters_.size(); ++i)
+        out_stream << fixed << parameters_(i) << " ";
+    out_stream << endl;
+
+    for (int i = 0; i < trajectories_.size(); ++i)
+    {
+        out_stream << "Trajectory " << trajectory_names_[i] << endl;
+        printMatrixText(out_stream, trajectories_[i]);
+    }
+
+    out_stream << "Contact variables (" << num_contacts_ << " contacts per point)" << endl;
+    printMatrixText(out_stream, contact_variables_);
+
+    out_stream << "Costs : ";
+    for (int c = 0; c < cost_names_.size(); ++c)
+        out_stream << cost_names_[c] << " ";
+    out_stream << endl;
+    printMatrixText(out_stream, cost_matrix_);
+}
+
+void Checkpoint::printCSV(std::ostream& out_stream) const
+{
+    out_stream.precision(std::numeric_limits<double>::digits10);
+    out_stream << "section,name,row,column,value\n";
+    out_stream << "info,phase,0,0," << phase_ << "\n";
+    out_stream << "info,trial,0,0," << trial_index_ << "\n";
+    printMatrixCSV(out_stream, "parameter", "parameters", parameters_);
+    for (int i = 0; i < trajectories_.size(); ++i)
+        printMatrixCSV(out_stream, "trajectory", trajectory_names_[i], trajectories_[i]);
+    printMatrixCSV(out_stream, "contact", "contact_variables", contact_variables_);
+    for (int c = 0; c < cost_names_.size(); ++c)
+        printMatrixCSV(out_stream, "cost", cost_names_[c], cost_matrix_.col(c));
+}
+
+std::string Checkpoint::getFileName(int phase, int trial_index)
+{
+    std::stringstream ss;
+    ss << "checkpoint_phase_" << phase;
+    if (trial_index != 0)
+        ss << "_trial_" << trial_index;
+    ss << ".bin";
+    return ss.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+CheckpointWriter::CheckpointWriter()
+    : is_writing_(false), stop_write_thread_(false)
+{
+    write_thread_ = boost::thread(&CheckpointWriter::writeThread, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        boost::mutex::scoped_lock lock(write_mutex_);
+        stop_write_thread_ = true;
+        write_condition_.notify_all();
+    }
+    write_thread_.join();
+}
+
+void CheckpointWriter::write(const CheckpointConstPtr& checkpoint, const std::string& file_name)
+{
+    boost::mutex::scoped_lock lock(write_mutex_);
+    write_queue_.push_back(std::make_pair(checkpoint, file_name));
+    write_condition_.notify_all();
+}
+
+void CheckpointWriter::flush()
+{
+    boost::mutex::scoped_lock lock(write_mutex_);
+    while (!write_queue_.empty() || is_writing_)
+        write_condition_.wait(lock);
+}
+
+void CheckpointWriter::writeThread()
+{
+    while (true)
+    {
+        std::pair<CheckpointConstPtr, std::string> request;
+        {
+            boost::mutex::scoped_lock lock(write_mutex_);
+            is_writing_ = false;
+            write_condition_.notify_all();
+            while (write_queue_.empty() && !stop_write_thread_)
+                write_condition_.wait(lock);
+
+            // the queued checkpoints are written before the thread stops
+            if (write_queue_.empty())
+                break;
+            request = write_queue_.front();
+            write_queue_.pop_front();
+            is_writing_ = true;
+        }
+        request.first->write(request.second);
+    }
+}
+
+}
@@ -0,0 +1,114 @@
+#include <itomp_cio_planner/optimization/derivative_scheduler.h>
+#include <algorithm>
+
+namespace itomp_cio_planner
+{
+
+// initial estimates (in seconds) before a parameter is measured.
+// joint parameters need kinematics and collision checking, the others only dynamics
+const double INITIAL_JOINT_PARAMETER_COST = 1e-3;
+const double INITIAL_PARAMETER_COST = 1e-4;
+// weight of the last measurement in the estimate
+const double COST_ESTIMATE_WEIGHT = 0.5;
+
+DerivativeScheduler::Queue::Queue()
+    : begin_(0), end_(0), load_(0.0)
+{
+    omp_init_lock(&lock_);
+}
+
+DerivativeScheduler::Queue::~Queue()
+{
+    omp_destroy_lock(&lock_);
+}
+
+DerivativeScheduler::DerivativeScheduler()
+{
+
+}
+
+DerivativeScheduler::~DerivativeScheduler()
+{
+
+}
+
+void DerivativeScheduler::initialize(const ItompTrajectoryConstPtr& trajectory, int num_threads)
+{
+    queues_.resize(num_threads);
+    for (int i = 0; i < num_threads; ++i)
+        queues_[i].reset(new Queue());
+
+    cost_estimates_.resize(trajectory->getNumParameters());
+    for (int i = 0; i < cost_estimates_.size(); ++i)
+    {
+        const ItompTrajectoryIndex& index = trajectory->getTrajectoryIndex(i);
+        cost_estimates_[i] = (index.sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_JOINT) ?
+                    INITIAL_JOINT_PARAMETER_COST : INITIAL_PARAMETER_COST;
+    }
+}
+
+void DerivativeScheduler::schedule(const std::vector<long>& parameters)
+{
+    sorted_parameters_ = parameters;
+    std::sort(sorted_parameters_.begin(), sorted_parameters_.end(), CostGreater(cost_estimates_));
+
+    for (int i = 0; i < queues_.size(); ++i)
+    {
+        queues_[i]->parameters_.clear();
+        queues_[i]->load_ = 0.0;
+    }
+
+    // longest processing time first. each queue is in the decreasing order of the costs
+    for (int i = 0; i < sorted_parameters_.size(); ++i)
+    {
+        int min_queue = 0;
+        for (int j = 1; j < queues_.size(); ++j)
+        {
+            if (queues_[j]->load_ < queues_[min_queue]->load_)
+                min_queue = j;
+        }
+        queues_[min_queue]->parameters_.push_back(sorted_parameters_[i]);
+        queues_[min_queue]->load_ += cost_estimates_[sorted_parameters_[i]];
+    }
+
+    for (int i = 0; i < queues_.size(); ++i)
+    {
+        queues_[i]->begin_ = 0;
+        queues_[i]->end_ = queues_[i]->parameters_.size();
+    }
+}
+
+bool DerivativeScheduler::getNextParameter(int thread_index, long& parameter)
+{
+    // the owner takes the most expensive parameter of its queue
+    Queue& queue = *queues_[thread_index];
+    omp_set_lock(&queue.lock_);
+    bool found = (queue.begin_ < queue.end_);
+    if (found)
+        parameter = queue.parameters_[queue.begin_++];
+    omp_unset_lock(&queue.lock_);
+    if (found)
+        return true;
+
+    // steal the cheapest parameter of another queue
+    for (int i = 1; i < queues_.size(); ++i)
+    {
+        Queue& victim = *queues_[(thread_index + i) % queues_.size()];
+        omp_set_lock(&victim.lock_);
+        found = (victim.begin_ < victim.end_);
+        if (found)
+            parameter = victim.parameters_[--victim.end_];
+        omp_unset_lock(&victim.lock_);
+        if (found)
+            return true;
+    }
+
+    return false;
+}
+
+void DerivativeScheduler::updateCost(long parameter, double elapsed)
+{
+    cost_estimates_[parameter] = (1.0 - COST_ESTIMATE_WEIGHT) * cost_estimates_[parameter] + COST_ESTIMATE_WEIGHT * elapsed;
+}
+
+}
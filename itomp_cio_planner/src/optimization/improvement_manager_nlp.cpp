@@ -1,6 +1,6 @@
 #include <itomp_cio_planner/optimization/improvement_manager_nlp.h>
-#include <itomp_cio_planner/optimization/phase_manager.h>
-#include <itomp_cio_planner/cost/trajectory_cost_manager.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
+#include <itomp_cio_planner/optimization/checkpoint.h>
 #include <itomp_cio_planner/util/multivariate_gaussian.h>
 #include <itomp_cio_planner/util/planning_parameters.h>
 #include <omp.h>
@@ -32,9 +32,6 @@ ImprovementManagerNLP::ImprovementManagerNLP()
 
 ImprovementManagerNLP::~ImprovementManagerNLP()
 {
-    TrajectoryCostManager::getInstance()->destroy();
-    PerformanceProfiler::getInstance()->destroy();
-
     for (int i = 0; i < derivatives_evaluation_manager_.size(); ++i)
         derivatives_evaluation_manager_[i].reset();
 }
@@ -46,7 +43,8 @@ void ImprovementManagerNLP::initialize(const NewEvalManagerPtr& evaluation_manag
 
     ImprovementManager::initialize(evaluation_manager, planning_group);
 
-    num_threads_ = omp_get_max_threads();
+    // a trial running in a parallel region evaluates derivatives in its own thread
+    num_threads_ = (omp_in_parallel() && !omp_get_nested()) ? 1 : omp_get_max_threads();
 
     omp_set_num_threads(num_threads_);
     if (PlanningParameters::getInstance()->getPrintPlanningInfo())
@@ -55,20 +53,26 @@ void ImprovementManagerNLP::initialize(const NewEvalManagerPtr& evaluation_manag
     if (num_threads_ < 1)
         ROS_ERROR("0 threads!!!");
 
-    TIME_PROFILER_INIT(getROSWallTime, num_threads_);
-    TIME_PROFILER_ADD_ENTRY(FK);
+    TIME_PROFILER_INIT(evaluation_manager_->getPerformanceProfiler(), getROSWallTime, num_threads_);
+    TIME_PROFILER_ADD_ENTRY(evaluation_manager_->getPerformanceProfiler(), FK);
+    TIME_PROFILER_ADD_ENTRY(evaluation_manager_->getPerformanceProfiler(), Derivative);
+    TIME_PROFILER_ADD_ENTRY(evaluation_manager_->getPerformanceProfiler(), DerivativeLoop);
+    TIME_PROFILER_ENABLE_TRACE(evaluation_manager_->getPerformanceProfiler(), 1 << 16);
 
     int num_points = evaluation_manager_->getTrajectory()->getNumPoints();
 
-    int num_costs =	TrajectoryCostManager::getInstance()->getNumActiveCostFunctions();
+    int num_costs =	evaluation_manager_->getTrajectoryCostManager()->getNumActiveCostFunctions();
 
     derivatives_evaluation_manager_.resize(num_threads_);
     evaluation_cost_matrices_.resize(num_threads_);
     for (int i = 0; i < num_threads_; ++i)
     {
-        derivatives_evaluation_manager_[i].reset(new NewEvalManager(*evaluation_manager));
+        derivatives_evaluation_manager_[i].reset(evaluation_manager->createDerivativeEvaluationManager());
         evaluation_cost_matrices_[i] = Eigen::MatrixXd(num_points, num_costs);
 	}
+
+    null_space_projector_.initialize(evaluation_manager_.get(), num_threads_);
+    derivative_scheduler_.initialize(evaluation_manager_->getTrajectory(), num_threads_);
 }
 
 bool ImprovementManagerNLP::updatePlanningParameters()
@@ -76,7 +80,7 @@ bool ImprovementManagerNLP::updatePlanningParameters()
     if (!ImprovementManager::updatePlanningParameters())
         return false;
 
-    TrajectoryCostManager::getInstance()->buildActiveCostFunctions(evaluation_manager_.get());
+    evaluation_manager_->getTrajectoryCostManager()->buildActiveCostFunctions(evaluation_manager_.get());
 
     return true;
 }
@@ -107,8 +111,12 @@ void ImprovementManagerNLP::runSingleIteration(int iteration)
         }
     }
 
-    //if (iteration != 0)
-    //addNoiseToVariables(variables);
+    // trials are perturbed differently when the intermediate points become free (phase 1)
+    if (iteration == 1 && evaluation_manager_->getPlanningContext()->getTrialIndex() != 0)
+    {
+        addNoiseToVariables(variables);
+        evaluation_manager_->setParameters(variables);
+    }
 
     optimize(iteration, variables);
 
@@ -130,17 +138,19 @@ void ImprovementManagerNLP::runSingleIteration(int iteration)
         trajectory_file.close();
     }
 
-    std::ofstream trajectory_file;
-    std::stringstream ss;
-    ss << "trajectory_out_phase_" << iteration << ".txt";
-    trajectory_file.open(ss.str().c_str());
-    evaluation_manager_->getTrajectory()->printTrajectory(trajectory_file);
-    trajectory_file.close();
+    if (PlanningParameters::getInstance()->getWriteCheckpoints())
+    {
+        CheckpointPtr checkpoint = boost::make_shared<Checkpoint>();
+        checkpoint->capture(*evaluation_manager_, iteration);
+        CheckpointWriter::getInstance()->write(checkpoint,
+                                               Checkpoint::getFileName(iteration, checkpoint->trial_index_));
+    }
 }
 
 double ImprovementManagerNLP::evaluate(const column_vector& variables)
 {
-    evaluation_manager_->setParameters(variables);
+    scatterActiveParameters(variables);
+    evaluation_manager_->setParameters(full_variables_);
 
     double cost = evaluation_manager_->evaluate();
 
@@ -180,11 +190,13 @@ column_vector ImprovementManagerNLP::derivative_ref(const column_vector& variabl
         const double old_val = e(i);
 
         e(i) += eps_;
-        evaluation_manager_->setParameters(e);
+        scatterActiveParameters(e);
+        evaluation_manager_->setParameters(full_variables_);
         const double delta_plus = evaluation_manager_->evaluate();
 
         e(i) = old_val - eps_;
-        evaluation_manager_->setParameters(e);
+        scatterActiveParameters(e);
+        evaluation_manager_->setParameters(full_variables_);
         double delta_minus = evaluation_manager_->evaluate();
 
         der(i) = (delta_plus - delta_minus) / (2 * eps_);
@@ -198,21 +210,57 @@ column_vector ImprovementManagerNLP::derivative_ref(const column_vector& variabl
     return der;
 }
 
+void ImprovementManagerNLP::validateDerivative(const column_vector& variables, const column_vector& der)
+{
+    column_vector der_reference = derivative_ref(variables);
+
+    // derivative_ref leaves the evaluation manager at a perturbed trajectory
+    scatterActiveParameters(variables);
+    evaluation_manager_->setParameters(full_variables_);
+    evaluation_manager_->evaluate();
+
+    ROS_INFO("Vaildate computed derivative with reference");
+    double max_der = 0.0;
+    for (int i = 0; i < variables.size(); ++i)
+    {
+        double abs_der = std::abs(der(i));
+        if (abs_der > max_der)
+            max_der = abs_der;
+    }
+    int num_errors = 0;
+    for (int i = 0; i < variables.size(); ++i)
+    {
+        if (std::abs(der(i) - der_reference(i)) > 0.001)
+        {
+            const ItompTrajectoryIndex& index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(active_parameters_[i]);
+
+            ROS_INFO("Error at %ld(%d %d %d %d) : %.14f (%.14f vs %.14f) max_der : %f", active_parameters_[i],
+                     index.component, index.sub_component, index.point, index.element,
+                     std::abs(der(i) - der_reference(i)),
+                     der(i), der_reference(i), max_der);
+            ++num_errors;
+        }
+    }
+    ROS_INFO("%d/%ld derivatives differ from reference", num_errors, variables.size());
+}
+
 //#define COMPUTE_COST_DERIVATIVE
 column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
 {
     // assume evaluate was called before
 
-    TIME_PROFILER_START_ITERATION;
+    TIME_PROFILER_START_ITERATION(evaluation_manager_->getPerformanceProfiler());
 
     column_vector der;
     der.set_size(variables.size());
 
+    scatterActiveParameters(variables);
+
     // for cost debug
 #ifdef COMPUTE_COST_DERIVATIVE
-    std::vector<column_vector> cost_der(TrajectoryCostManager::getInstance()->getNumActiveCostFunctions());
+    std::vector<column_vector> cost_der(evaluation_manager_->getTrajectoryCostManager()->getNumActiveCostFunctions());
     for (int i = 0; i < cost_der.size(); ++i)
-        cost_der[i].set_size(variables.size());
+        cost_der[i].set_size(full_variables_.size());
     std::vector<double*> cost_der_ptr(cost_der.size());
     for (int i = 0; i < cost_der.size(); ++i)
         cost_der_ptr[i] = cost_der[i].begin();
@@ -221,46 +269,47 @@ column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
     #pragma omp parallel for
     for (int i = 0; i < num_threads_; ++i)
     {
-        derivatives_evaluation_manager_[i]->setParameters(variables);
+        derivatives_evaluation_manager_[i]->setParameters(full_variables_);
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < variables.size(); ++i)
+    // the costs of the parameters differ by an order of magnitude (kinematics and collision checking of joints),
+    // so the threads take the parameters from the scheduler instead of static chunks
+    derivative_scheduler_.schedule(active_parameters_);
+
+    TIME_PROFILER_START_TIMER(evaluation_manager_->getPerformanceProfiler(), DerivativeLoop);
+    #pragma omp parallel num_threads(num_threads_)
     {
         int thread_index = omp_get_thread_num();
-
-        /*
+        long parameter;
+        while (derivative_scheduler_.getNextParameter(thread_index, parameter))
         {
-            std::stringstream ss;
-            ss << thread_index << " begin " << i << "\n";
-            std::cout << ss.str().c_str();
-        }
-        */
+            TIME_PROFILER_START_TIMER(evaluation_manager_->getPerformanceProfiler(), Derivative);
+            double start_time = omp_get_wtime();
 
-        int order = evaluation_order_[i];
-
-        //  for cost debug
+            //  for cost debug
 #ifndef COMPUTE_COST_DERIVATIVE
-        derivatives_evaluation_manager_[thread_index]->computeDerivatives(order, variables, der.begin(), eps_);
+            derivatives_evaluation_manager_[thread_index]->computeDerivatives(parameter, full_variables_, full_derivatives_.begin(), eps_);
 #else
-        derivatives_evaluation_manager_[thread_index]->computeCostDerivatives(order, variables, der.begin(), cost_der_ptr, eps_);
+            derivatives_evaluation_manager_[thread_index]->computeCostDerivatives(parameter, full_variables_, full_derivatives_.begin(), cost_der_ptr, eps_);
 #endif
 
-        /*
-        {
-            std::stringstream ss;
-            ss << thread_index << " end " << i << "\n";
-            std::cout << ss.str().c_str();
+            derivative_scheduler_.updateCost(parameter, omp_get_wtime() - start_time);
+            TIME_PROFILER_END_TIMER(evaluation_manager_->getPerformanceProfiler(), Derivative);
         }
-        */
     }
+    TIME_PROFILER_END_TIMER(evaluation_manager_->getPerformanceProfiler(), DerivativeLoop);
 
-    TIME_PROFILER_PRINT_ITERATION_TIME();
+    for (int i = 0; i < der.size(); ++i)
+        der(i) = full_derivatives_(active_parameters_[i]);
+
+    TIME_PROFILER_PRINT_ITERATION_TIME(evaluation_manager_->getPerformanceProfiler(), false);
+    TIME_PROFILER_PRINT_THREAD_UTILIZATION(evaluation_manager_->getPerformanceProfiler(), Derivative, DerivativeLoop);
+    TIME_PROFILER_EXPORT_TRACE(evaluation_manager_->getPerformanceProfiler(), "itomp_trace");
 
     // print derivatives per costs
 #ifdef COMPUTE_COST_DERIVATIVE
     {
-        const std::vector<TrajectoryCostPtr>& cost_functions = TrajectoryCostManager::getInstance()->getCostFunctionVector();
+        const std::vector<TrajectoryCostPtr>& cost_functions = evaluation_manager_->getTrajectoryCostManager()->getCostFunctionVector();
         std::cout.precision(3);
         std::cout.precision(std::numeric_limits<double>::digits10);
         std::cout << "component sub_component point element ";
@@ -271,10 +320,10 @@ column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
         std::cout << "sum " << std::endl;
         for (int i = 0; i < variables.size(); ++i)
         {
-            const ItompTrajectoryIndex& index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(i);
-            std::cout << i << " " << index.component << " " << index.sub_component << " " << index.point << " " << index.element << " ";
+            const ItompTrajectoryIndex& index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(active_parameters_[i]);
+            std::cout << active_parameters_[i] << " " << index.component << " " << index.sub_component << " " << index.point << " " << index.element << " ";
             for (int j = 0; j < cost_der.size(); ++j)
-                std::cout << cost_der[j](i) << " ";
+                std::cout << cost_der[j](active_parameters_[i]) << " ";
             std::cout << der(i);
             std::cout << std::endl;
         }
@@ -282,29 +331,8 @@ column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
 #endif
 
     // validation with der_ref
-    /*
-    column_vector der_reference = derivative_ref(variables);
-    ROS_INFO("Vaildate computed derivative with reference");
-    double max_der = 0.0;
-    for (int i = 0; i < variables.size(); ++i)
-    {
-        double abs_der = std::abs(der(i));
-        if (abs_der > max_der)
-            max_der = abs_der;
-    }
-    for (int i = 0; i < variables.size(); ++i)
-    {
-        if (std::abs(der(i) - der_reference(i)) > 0.001)
-        {
-            const ItompTrajectoryIndex& index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(i);
-
-            ROS_INFO("Error at %d(%d %d %d %d) : %.14f (%.14f vs %.14f) max_der : %f", i,
-                     index.component, index.sub_component, index.point, index.element,
-                     std::abs(der(i) - der_reference(i)),
-                     der(i), der_reference(i), max_der);
-        }
-    }
-    */
+    if (PlanningParameters::getInstance()->getValidateDerivatives())
+        validateDerivative(variables, der);
 
 
     /*
@@ -343,7 +371,7 @@ column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
             der(i) = -1e10;
     }
 
-    double scale = (PhaseManager::getInstance()->getPhase() <= 0) ? 1.0 : 1000.0;
+    double scale = (evaluation_manager_->getPhaseManager()->getPhase() <= 0) ? 1.0 : 1000.0;
     double norm = 0.0;
     for (int i = 0; i < der.size(); ++i)
         norm += der(i) * der(i);
@@ -365,10 +393,18 @@ column_vector ImprovementManagerNLP::derivative(const column_vector& variables)
 
 void ImprovementManagerNLP::optimize(int iteration, column_vector& variables)
 {
-    computeEvaluationOrder(variables.size());
+    full_variables_ = variables;
+    full_derivatives_ = dlib::zeros_matrix<double>(variables.size(), 1);
+    computeActiveParameters();
     //addNoiseToVariables(variables);
 
     Jacobian::evaluation_manager_ = evaluation_manager_.get();
+    Jacobian::null_space_projector_ = &null_space_projector_;
+    null_space_projector_.setActiveParameters(&active_parameters_, &full_variables_);
+
+    column_vector active_variables(active_parameters_.size());
+    for (int i = 0; i < active_parameters_.size(); ++i)
+        active_variables(i) = variables(active_parameters_[i]);
 
     std::vector<double> group_joint_min(planning_group_->group_joints_.size());
     std::vector<double> group_joint_max(planning_group_->group_joints_.size());
@@ -381,11 +417,11 @@ void ImprovementManagerNLP::optimize(int iteration, column_vector& variables)
     }
 
     column_vector x_lower, x_upper;
-    x_lower.set_size(variables.size());
-    x_upper.set_size(variables.size());
-    for (int i = 0; i < variables.size(); ++i)
+    x_lower.set_size(active_variables.size());
+    x_upper.set_size(active_variables.size());
+    for (int i = 0; i < active_variables.size(); ++i)
     {
-        ItompTrajectoryIndex index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(i);
+        ItompTrajectoryIndex index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(active_parameters_[i]);
 
         x_lower(i) = -30.0;
         x_upper(i) = 30.0;
@@ -487,25 +523,33 @@ void ImprovementManagerNLP::optimize(int iteration, column_vector& variables)
     evaluation_manager_->render();
 
     int max_iterations = PlanningParameters::getInstance()->getMaxIterations();
-    if (PhaseManager::getInstance()->getPhase() > 2)
+    if (evaluation_manager_->getPhaseManager()->getPhase() > 2)
         max_iterations *= 10;
-    dlib::find_min_box_constrained(dlib::lbfgs_search_strategy(10),
-                                   dlib::objective_delta_stop_strategy(eps_, max_iterations).be_verbose(),
-                                   boost::bind(&ImprovementManagerNLP::evaluate, this, _1),
-                                   boost::bind(&ImprovementManagerNLP::derivative, this, _1),
-                                   variables, x_lower, x_upper);
+    if (active_variables.size() != 0)
+    {
+        dlib::find_min_box_constrained(dlib::lbfgs_search_strategy(10),
+                                       dlib::objective_delta_stop_strategy(eps_, max_iterations).be_verbose(),
+                                       boost::bind(&ImprovementManagerNLP::evaluate, this, _1),
+                                       boost::bind(&ImprovementManagerNLP::derivative, this, _1),
+                                       active_variables, x_lower, x_upper);
+        scatterActiveParameters(active_variables);
+    }
+    null_space_projector_.setActiveParameters(NULL, NULL);
+    variables = full_variables_;
 
     evaluation_manager_->setParameters(variables);
     evaluation_manager_->evaluate();
     evaluation_manager_->printTrajectoryCost(0, true);
-    evaluation_manager_->render();
+    evaluation_manager_->render(true);
 }
 
 void ImprovementManagerNLP::addNoiseToVariables(column_vector& variables)
 {
     int num_variables = variables.size();
+    // seeded from the trial index so that parallel trials are reproducible
     MultivariateGaussian noise_generator(VectorXd::Zero(num_variables),
-                                         MatrixXd::Identity(num_variables, num_variables));
+                                         MatrixXd::Identity(num_variables, num_variables),
+                                         evaluation_manager_->getPlanningContext()->getTrialIndex());
     VectorXd noise = VectorXd::Zero(num_variables);
     noise_generator.sample(noise);
     for (int i = 0; i < num_variables; ++i)
@@ -516,37 +560,27 @@ void ImprovementManagerNLP::addNoiseToVariables(column_vector& variables)
     }
 }
 
-void ImprovementManagerNLP::computeEvaluationOrder(long variable_size)
+void ImprovementManagerNLP::computeActiveParameters()
 {
-    evaluation_order_.resize(variable_size);
+    const ItompTrajectoryConstPtr& trajectory = evaluation_manager_->getTrajectory();
+    const PhaseManagerPtr& phase_manager = evaluation_manager_->getPhaseManager();
 
-    std::vector<long> indices_of_joint_param; // slow due to collision checking
-    std::vector<long> indices_of_non_joint_param;
-    indices_of_joint_param.reserve(variable_size);
-    indices_of_non_joint_param.reserve(variable_size);
-    for (long i = 0; i < variable_size; ++i)
+    active_parameters_.clear();
+    for (long i = 0; i < trajectory->getNumParameters(); ++i)
     {
-        const ItompTrajectoryIndex& index = evaluation_manager_->getTrajectory()->getTrajectoryIndex(i);
-        if (index.sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)
-            indices_of_joint_param.push_back(i);
-        else
-            indices_of_non_joint_param.push_back(i);
-    }
-    // maximize chunk size
-    long write_index = 0;
-    for (int i = 0; i < num_threads_; ++i)
-    {
-        std::copy(indices_of_joint_param.begin() + i * indices_of_joint_param.size() / num_threads_,
-                  indices_of_joint_param.begin() + (i + 1) * indices_of_joint_param.size() / num_threads_,
-                  evaluation_order_.begin() + write_index);
-        write_index += (i + 1) * indices_of_joint_param.size() / num_threads_ - i * indices_of_joint_param.size() / num_threads_;
-
-        std::copy(indices_of_non_joint_param.begin() + i * indices_of_non_joint_param.size() / num_threads_,
-                  indices_of_non_joint_param.begin() + (i + 1) * indices_of_non_joint_param.size() / num_threads_,
-                  evaluation_order_.begin() + write_index);
-        write_index += (i + 1) * indices_of_non_joint_param.size() / num_threads_ - i * indices_of_non_joint_param.size() / num_threads_;
+        if (phase_manager->updateParameter(trajectory->getTrajectoryIndex(i)))
+            active_parameters_.push_back(i);
     }
-    ROS_ASSERT(write_index == variable_size);
+
+    if (PlanningParameters::getInstance()->getPrintPlanningInfo())
+        ROS_INFO("Phase %d : %d of %d parameters are active", phase_manager->getPhase(),
+                 (int)active_parameters_.size(), trajectory->getNumParameters());
+}
+
+void ImprovementManagerNLP::scatterActiveParameters(const column_vector& variables)
+{
+    for (int i = 0; i < active_parameters_.size(); ++i)
+        full_variables_(active_parameters_[i]) = variables(i);
 }
 
 }
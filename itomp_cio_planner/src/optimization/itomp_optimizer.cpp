@@ -5,6 +5,8 @@
 #include <itomp_cio_planner/visualization/new_viz_manager.h>
 #include <itomp_cio_planner/util/planning_parameters.h>
 #include <itomp_cio_planner/optimization/improvement_manager_nlp.h>
+#include <itomp_cio_planner/optimization/checkpoint.h>
+#include <boost/thread/mutex.hpp>
 //#include <itomp_cio_planner/optimization/improvement_manager_chomp.h>
 
 using namespace std;
@@ -12,14 +14,34 @@ using namespace std;
 namespace itomp_cio_planner
 {
 
+namespace
+{
+
+// the restore_checkpoint parameter is reloaded for every request. a checkpoint file is restored only once
+std::string restored_checkpoint_file;
+boost::mutex restored_checkpoint_mutex;
+
+// returns true for the first optimizer that restores the file
+bool claimCheckpoint(const std::string& checkpoint_file)
+{
+    boost::mutex::scoped_lock lock(restored_checkpoint_mutex);
+    if (checkpoint_file == restored_checkpoint_file)
+        return false;
+    restored_checkpoint_file = checkpoint_file;
+    return true;
+}
+
+}
+
 ItompOptimizer::ItompOptimizer(int trajectory_index,
+                               const PlanningContextPtr& planning_context,
                                const ItompTrajectoryPtr& itomp_trajectory,
 							   const ItompRobotModelConstPtr& robot_model,
 							   const planning_scene::PlanningSceneConstPtr& planning_scene,
 							   const ItompPlanningGroupConstPtr& planning_group,
 							   double planning_start_time, double trajectory_start_time,
                                const std::vector<moveit_msgs::Constraints>& trajectory_constraints) :
-    trajectory_index_(trajectory_index), planning_start_time_(planning_start_time), iteration_(-1),
+    trajectory_index_(trajectory_index), planning_start_time_(planning_start_time), planning_context_(planning_context), iteration_(-1),
     best_parameter_cost_(std::numeric_limits<double>::max()), is_best_parameter_feasible_(false), best_parameter_iteration_(-1)
 {
     initialize(itomp_trajectory, robot_model, planning_scene, planning_group,
@@ -36,16 +58,16 @@ void ItompOptimizer::initialize(const ItompTrajectoryPtr& itomp_trajectory,
 	improvement_manager_ = boost::make_shared<ImprovementManagerNLP>();
 	//improvement_manager_ = boost::make_shared<ImprovementManagerChomp>();
 
-	NewVizManager::getInstance()->setPlanningGroup(planning_group);
+    if (planning_context_->getVisualize())
+        NewVizManager::getInstance()->setPlanningGroup(planning_group);
 
-    NewEvalManager::ref_evaluation_manager_ = NULL;
 	evaluation_manager_ = boost::make_shared<NewEvalManager>();
-    evaluation_manager_->initialize(itomp_trajectory, robot_model,
+    evaluation_manager_->initialize(planning_context_, itomp_trajectory, robot_model,
 									planning_scene, planning_group, planning_start_time_,
                                     trajectory_start_time, trajectory_constraints);
 	improvement_manager_->initialize(evaluation_manager_, planning_group);
 
-    PhaseManager::getInstance()->init(itomp_trajectory->getNumPoints(), planning_group);
+    planning_context_->getPhaseManager()->init(itomp_trajectory->getNumPoints(), planning_group);
 
     best_parameter_trajectory_.set_size(itomp_trajectory->getNumParameters(), 1);
 }
@@ -66,12 +88,53 @@ bool ItompOptimizer::optimize()
 
 	improvement_manager_->updatePlanningParameters();
 
+    // a warm-started trajectory skips the early phases if it is collision-free.
+    // the obstacle cost of the interior points is evaluated from phase 1
+    unsigned int warm_start_phase = planning_context_->getPhaseManager()->getWarmStartPhase();
+    if (warm_start_phase > 0)
+        planning_context_->getPhaseManager()->setPhase(warm_start_phase);
+
 	evaluation_manager_->evaluate();
 
 	evaluation_manager_->render();
 	updateBestTrajectory();
 	++iteration_;
 
+    if (warm_start_phase > 0)
+    {
+        if (evaluation_manager_->getTrajectoryCost("Obstacle") == 0.0)
+        {
+            ROS_INFO("Warm-started trajectory is collision-free. Start from phase %d", warm_start_phase);
+            iteration_ = warm_start_phase;
+        }
+        else
+            best_parameter_cost_ = numeric_limits<double>::max();
+    }
+
+    // resume the optimization after the phase of a checkpoint. only the trial that wrote it is resumed
+    std::string checkpoint_file = PlanningParameters::getInstance()->getRestoreCheckpoint();
+    if (!checkpoint_file.empty())
+    {
+        Checkpoint checkpoint;
+        if (checkpoint.read(checkpoint_file) && checkpoint.trial_index_ == planning_context_->getTrialIndex() &&
+                claimCheckpoint(checkpoint_file) && checkpoint.restore(*evaluation_manager_))
+        {
+            ROS_INFO("Resume from the checkpoint of phase %d (%s)", checkpoint.phase_, checkpoint_file.c_str());
+            planning_context_->getPhaseManager()->setPhase(checkpoint.phase_);
+            iteration_ = checkpoint.phase_ + 1;
+
+            // the steps that follow a phase in the loop below
+            if (iteration_ == 1)
+                evaluation_manager_->getTrajectoryNonConst()->interpolateStartEnd(ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+            evaluation_manager_->correctContacts();
+            evaluation_manager_->evaluate();
+
+            best_parameter_cost_ = numeric_limits<double>::max();
+            is_best_parameter_feasible_ = false;
+            updateBestTrajectory();
+        }
+    }
+
 	int iteration_after_feasible_solution = 0;
     int num_max_iterations = 5;
 
@@ -79,12 +142,12 @@ bool ItompOptimizer::optimize()
 	{
 		while (iteration_ < num_max_iterations)
 		{
-            ROS_INFO("Optimization phase %d started", iteration_);
+            ROS_INFO("Optimization phase %d started (trial %d)", iteration_, planning_context_->getTrialIndex());
 
 			if (is_best_parameter_feasible_)
 				++iteration_after_feasible_solution;
 
-            PhaseManager::getInstance()->setPhase(iteration_);
+            planning_context_->getPhaseManager()->setPhase(iteration_);
             if (iteration_ != 0)
             {
                 best_parameter_cost_ = numeric_limits<double>::max();
@@ -125,7 +188,7 @@ bool ItompOptimizer::optimize()
 	evaluation_manager_->evaluate();
 	evaluation_manager_->printTrajectoryCost(iteration_);
 
-	evaluation_manager_->render();
+	evaluation_manager_->render(true);
 
 	double elpsed_time = (ros::WallTime::now() - start_time).toSec();
 
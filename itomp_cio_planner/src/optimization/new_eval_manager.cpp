@@ -2,11 +2,11 @@
 #include <moveit/robot_state/robot_state.h>
 #include <moveit_msgs/PlanningScene.h>
 #include <itomp_cio_planner/optimization/new_eval_manager.h>
-#include <itomp_cio_planner/optimization/phase_manager.h>
+#include <itomp_cio_planner/optimization/planning_context.h>
 #include <itomp_cio_planner/trajectory/trajectory_factory.h>
-#include <itomp_cio_planner/cost/trajectory_cost_manager.h>
 #include <itomp_cio_planner/model/itomp_planning_group.h>
 #include <itomp_cio_planner/model/rbdl_model_util.h>
+#include <itomp_cio_planner/model/rbdl_batch_dynamics.h>
 #include <itomp_cio_planner/contact/ground_manager.h>
 #include <itomp_cio_planner/contact/contact_util.h>
 #include <itomp_cio_planner/visualization/new_viz_manager.h>
@@ -25,36 +25,44 @@ using namespace Eigen;
 namespace itomp_cio_planner
 {
 
-const NewEvalManager* NewEvalManager::ref_evaluation_manager_ = NULL;
-
 NewEvalManager::NewEvalManager() :
     last_trajectory_feasible_(false),
-    best_cost_(std::numeric_limits<double>::max())
+    best_cost_(std::numeric_limits<double>::max()),
+    num_overlay_points_(0),
+    evaluated_phase_(0),
+    ref_evaluation_manager_(this)
 {
-    if (ref_evaluation_manager_ == NULL)
-        ref_evaluation_manager_ = this;
 }
 
 NewEvalManager::NewEvalManager(const NewEvalManager& manager)
     : robot_model_(manager.robot_model_),
       planning_scene_(manager.planning_scene_),
       planning_group_(manager.planning_group_),
+      planning_context_(manager.planning_context_),
+      phase_manager_(manager.phase_manager_),
+      trajectory_cost_manager_(manager.trajectory_cost_manager_),
+      performance_profiler_(manager.performance_profiler_),
       planning_start_time_(manager.planning_start_time_),
       trajectory_start_time_(manager.trajectory_start_time_),
       last_trajectory_feasible_(manager.last_trajectory_feasible_),
       best_cost_(manager.best_cost_),
+      num_overlay_points_(manager.num_overlay_points_),
       rbdl_models_(manager.rbdl_models_),
       joint_torques_(manager.joint_torques_),
       external_forces_(manager.external_forces_),
       contact_variables_(manager.contact_variables_),
       evaluation_cost_matrix_(manager.evaluation_cost_matrix_),
-      trajectory_constraints_(manager.trajectory_constraints_)
+      dirty_points_(manager.dirty_points_),
+      evaluated_cost_functions_(manager.evaluated_cost_functions_),
+      evaluated_phase_(manager.evaluated_phase_),
+      trajectory_constraints_(manager.trajectory_constraints_),
+      ref_evaluation_manager_(manager.ref_evaluation_manager_)
 {
     itomp_trajectory_.reset(new ItompTrajectory(*manager.getTrajectory()));
     itomp_trajectory_const_ = itomp_trajectory_;
 
-    robot_state_.resize(itomp_trajectory_->getNumPoints());
-    for (int i = 0; i < itomp_trajectory_->getNumPoints(); ++i)
+    robot_state_.resize(manager.robot_state_.size());
+    for (int i = 0; i < robot_state_.size(); ++i)
         robot_state_[i].reset(new robot_state::RobotState(*manager.robot_state_[i]));
 
     const collision_detection::WorldPtr world(new collision_detection::World(*planning_scene_->getWorld()));
@@ -63,34 +71,99 @@ NewEvalManager::NewEvalManager(const NewEvalManager& manager)
     collision_robot_derivatives_.reset(new CollisionRobotFCLDerivatives(
                                            dynamic_cast<const collision_detection::CollisionRobotFCL&>(*planning_scene_->getCollisionRobotUnpadded())));
     collision_robot_derivatives_->constructInternalFCLObject(planning_scene_->getCurrentState());
+
+    obstacle_distance_field_ = manager.obstacle_distance_field_;
+}
+
+NewEvalManager::NewEvalManager(const NewEvalManager& manager, unsigned int num_overlay_points)
+    : robot_model_(manager.robot_model_),
+      planning_scene_(manager.planning_scene_),
+      planning_group_(manager.planning_group_),
+      planning_context_(manager.planning_context_),
+      phase_manager_(manager.phase_manager_),
+      trajectory_cost_manager_(manager.trajectory_cost_manager_),
+      performance_profiler_(manager.performance_profiler_),
+      planning_start_time_(manager.planning_start_time_),
+      trajectory_start_time_(manager.trajectory_start_time_),
+      last_trajectory_feasible_(manager.last_trajectory_feasible_),
+      best_cost_(manager.best_cost_),
+      num_overlay_points_(num_overlay_points),
+      evaluation_cost_matrix_(manager.evaluation_cost_matrix_),
+      dirty_points_(manager.dirty_points_),
+      evaluated_cost_functions_(manager.evaluated_cost_functions_),
+      evaluated_phase_(manager.evaluated_phase_),
+      trajectory_constraints_(manager.trajectory_constraints_),
+      ref_evaluation_manager_(manager.ref_evaluation_manager_)
+{
+    ROS_ASSERT(manager.num_overlay_points_ == 0);
+
+    itomp_trajectory_.reset(new ItompTrajectory(*manager.getTrajectory()));
+    itomp_trajectory_const_ = itomp_trajectory_;
+
+    // slots are overwritten by the reference manager state before they are used
+    rbdl_models_.resize(num_overlay_points_, manager.rbdl_models_[0]);
+    joint_torques_.resize(num_overlay_points_, manager.joint_torques_[0]);
+    external_forces_.resize(num_overlay_points_, manager.external_forces_[0]);
+    contact_variables_.resize(num_overlay_points_, manager.contact_variables_[0]);
+
+    robot_state_.resize(num_overlay_points_);
+    for (int i = 0; i < num_overlay_points_; ++i)
+        robot_state_[i].reset(new robot_state::RobotState(*manager.robot_state_[0]));
+
+    // world collision queries do not modify the world, only the robot collision object is per-thread
+    collision_world_derivatives_ = manager.collision_world_derivatives_;
+    collision_robot_derivatives_.reset(new CollisionRobotFCLDerivatives(
+                                           dynamic_cast<const collision_detection::CollisionRobotFCL&>(*planning_scene_->getCollisionRobotUnpadded())));
+    collision_robot_derivatives_->constructInternalFCLObject(planning_scene_->getCurrentState());
+
+    obstacle_distance_field_ = manager.obstacle_distance_field_;
 }
 
 NewEvalManager::~NewEvalManager()
 {
 }
 
+NewEvalManager* NewEvalManager::createDerivativeEvaluationManager() const
+{
+    // a parameter perturbation changes at most 2 * keyframe_interval + 1 consecutive points
+    unsigned int num_overlay_points = 2 * itomp_trajectory_->getKeyframeInterval() + 2;
+    if (num_overlay_points >= itomp_trajectory_->getNumPoints())
+        return new NewEvalManager(*this);
+
+    return new NewEvalManager(*this, num_overlay_points);
+}
+
 NewEvalManager& NewEvalManager::operator=(const NewEvalManager& manager)
 {
     robot_model_ = manager.robot_model_;
     planning_scene_ = manager.planning_scene_;
     planning_group_ = manager.planning_group_;
+    planning_context_ = manager.planning_context_;
+    phase_manager_ = manager.phase_manager_;
+    trajectory_cost_manager_ = manager.trajectory_cost_manager_;
+    performance_profiler_ = manager.performance_profiler_;
     planning_start_time_ = manager.planning_start_time_;
     trajectory_start_time_ = manager.trajectory_start_time_;
     last_trajectory_feasible_ = manager.last_trajectory_feasible_;
     best_cost_ = manager.best_cost_;
+    num_overlay_points_ = manager.num_overlay_points_;
     rbdl_models_ = manager.rbdl_models_;
     joint_torques_ = manager.joint_torques_;
     external_forces_ = manager.external_forces_;
     contact_variables_ = manager.contact_variables_;
     evaluation_cost_matrix_ = manager.evaluation_cost_matrix_;
+    dirty_points_ = manager.dirty_points_;
+    evaluated_cost_functions_ = manager.evaluated_cost_functions_;
+    evaluated_phase_ = manager.evaluated_phase_;
     trajectory_constraints_ = manager.trajectory_constraints_;
+    ref_evaluation_manager_ = manager.ref_evaluation_manager_;
 
     // allocate
     itomp_trajectory_.reset(new ItompTrajectory(*manager.getTrajectory()));
     itomp_trajectory_const_ = itomp_trajectory_;
 
-    robot_state_.resize(itomp_trajectory_->getNumPoints());
-    for (int i = 0; i < itomp_trajectory_->getNumPoints(); ++i)
+    robot_state_.resize(manager.robot_state_.size());
+    for (int i = 0; i < robot_state_.size(); ++i)
         robot_state_[i].reset(new robot_state::RobotState(*manager.robot_state_[i]));
 
     const collision_detection::WorldPtr world(new collision_detection::World(*planning_scene_->getWorld()));
@@ -100,10 +173,13 @@ NewEvalManager& NewEvalManager::operator=(const NewEvalManager& manager)
                                            dynamic_cast<const collision_detection::CollisionRobotFCL&>(*planning_scene_->getCollisionRobotUnpadded())));
     collision_robot_derivatives_->constructInternalFCLObject(planning_scene_->getCurrentState());
 
+    obstacle_distance_field_ = manager.obstacle_distance_field_;
+
     return *this;
 }
 
-void NewEvalManager::initialize(const ItompTrajectoryPtr& itomp_trajectory,
+void NewEvalManager::initialize(const PlanningContextPtr& planning_context,
+                                const ItompTrajectoryPtr& itomp_trajectory,
                                 const ItompRobotModelConstPtr& robot_model,
                                 const planning_scene::PlanningSceneConstPtr& planning_scene,
                                 const ItompPlanningGroupConstPtr& planning_group,
@@ -116,14 +192,21 @@ void NewEvalManager::initialize(const ItompTrajectoryPtr& itomp_trajectory,
 	planning_scene_ = planning_scene;
 	planning_group_ = planning_group;
 
+    planning_context_ = planning_context;
+    phase_manager_ = planning_context->getPhaseManager();
+    trajectory_cost_manager_ = planning_context->getTrajectoryCostManager();
+    performance_profiler_ = planning_context->getPerformanceProfiler();
+
 	planning_start_time_ = planning_start_time;
 	trajectory_start_time_ = trajectory_start_time;
 
     int num_points = itomp_trajectory_->getNumPoints();
     int num_joints = itomp_trajectory_->getNumJoints();
 
-	TrajectoryCostManager::getInstance()->buildActiveCostFunctions(this);
-    evaluation_cost_matrix_.setZero(num_points, TrajectoryCostManager::getInstance()->getNumActiveCostFunctions());
+	trajectory_cost_manager_->buildActiveCostFunctions(this);
+    evaluation_cost_matrix_.setZero(num_points, trajectory_cost_manager_->getNumActiveCostFunctions());
+    dirty_points_.assign(num_points, true);
+    evaluated_cost_functions_.clear();
 
 
     rbdl_models_.resize(num_points, robot_model_->getRBDLRobotModel());
@@ -147,26 +230,61 @@ void NewEvalManager::initialize(const ItompTrajectoryPtr& itomp_trajectory,
                                            dynamic_cast<const collision_detection::CollisionRobotFCL&>(*planning_scene_->getCollisionRobotUnpadded())));
     collision_robot_derivatives_->constructInternalFCLObject(planning_scene_->getCurrentState());
 
+    if (PlanningParameters::getInstance()->getObstacleCostType() == PlanningParameters::OBSTACLE_COST_TYPE_DISTANCE_FIELD)
+        obstacle_distance_field_.reset(new ObstacleDistanceField(planning_scene_, robot_model_->getMoveitRobotModel(),
+                                       PlanningParameters::getInstance()->getDistanceFieldResolution(),
+                                       PlanningParameters::getInstance()->getDistanceFieldMargin()));
+    else
+        obstacle_distance_field_.reset();
+
     trajectory_constraints_ = trajectory_constraints;
 }
 
 double NewEvalManager::evaluate()
 {
-    int num_points = itomp_trajectory_->getNumPoints();
+    ROS_ASSERT(num_overlay_points_ == 0);
 
-    performFullForwardKinematicsAndDynamics(0, num_points);
+    int num_points = itomp_trajectory_->getNumPoints();
 
-    std::vector<TrajectoryCostPtr>& cost_functions = TrajectoryCostManager::getInstance()->getCostFunctionVector();
+    std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
     // cost weight changed
     if (cost_functions.size() != evaluation_cost_matrix_.cols())
         evaluation_cost_matrix_ = Eigen::MatrixXd::Zero(evaluation_cost_matrix_.rows(),	cost_functions.size());
 
+    // costs depend on the phase, cached rows are valid only for the same phase and cost functions
+    if (cost_functions != evaluated_cost_functions_ || phase_manager_->getPhase() != evaluated_phase_)
+    {
+        setDirtyPoints(0, num_points);
+        evaluated_cost_functions_ = cost_functions;
+        evaluated_phase_ = phase_manager_->getPhase();
+    }
+
+    // kinematics and dynamics of the consecutive dirty point ranges
+    int point_begin = 0;
+    while (point_begin < num_points)
+    {
+        if (!dirty_points_[point_begin])
+        {
+            ++point_begin;
+            continue;
+        }
+        int point_end = point_begin + 1;
+        while (point_end < num_points && dirty_points_[point_end])
+            ++point_end;
+
+        performFullForwardKinematicsAndDynamics(point_begin, point_end);
+        point_begin = point_end;
+    }
+
     last_trajectory_feasible_ = true;
     for (int c = 0; c < cost_functions.size(); ++c)
     {
         cost_functions[c]->preEvaluate(this);
         for (int i = 0; i < num_points; ++i)
         {
+            if (!dirty_points_[i])
+                continue;
+
             double cost = 0.0;
             last_trajectory_feasible_ &= cost_functions[c]->evaluate(this, i, cost);
             evaluation_cost_matrix_(i, c) = cost_functions[c]->getWeight() * cost;
@@ -175,13 +293,15 @@ double NewEvalManager::evaluate()
     }
     last_trajectory_feasible_ = false;
 
+    dirty_points_.assign(num_points, false);
+
 	return getTrajectoryCost();
 }
 
 void NewEvalManager::computeDerivatives(int parameter_index, const ItompTrajectory::ParameterVector& parameters,
                                         double* derivative_out, double eps)
 {
-    int num_cost_functions = TrajectoryCostManager::getInstance()->getNumActiveCostFunctions();
+    int num_cost_functions = trajectory_cost_manager_->getNumActiveCostFunctions();
 
     unsigned int point_begin, point_end;
     const double value = parameters(parameter_index, 0);
@@ -189,26 +309,125 @@ void NewEvalManager::computeDerivatives(int parameter_index, const ItompTrajecto
     double derivative = 0.0;
 
     const ItompTrajectoryIndex& index = itomp_trajectory_->getTrajectoryIndex(parameter_index);
-    if (PhaseManager::getInstance()->updateParameter(index))
+    if (phase_manager_->updateParameter(index))
     {
-        evaluateParameterPoint(value + eps, parameter_index, point_begin, point_end, true);
-        const double delta_plus = (evaluation_cost_matrix_.block(point_begin, 0, point_end - point_begin, num_cost_functions).sum());
+        bool use_analytic = (PlanningParameters::getInstance()->getDerivativeMode() == PlanningParameters::DERIVATIVE_MODE_ANALYTIC);
+        // costs without an analytic derivative always use finite differences
+        bool use_fd = !use_analytic || requiresFiniteDifference(index);
 
-        evaluateParameterPoint(value - eps, parameter_index, point_begin, point_end, false);
-        const double delta_minus = (evaluation_cost_matrix_.block(point_begin, 0, point_end - point_begin, num_cost_functions).sum());
+        if (use_analytic)
+            derivative += computeAnalyticDerivative(parameter_index, value, eps);
 
-        derivative = (delta_plus - delta_minus) / (2 * eps);
+        if (use_fd)
+        {
+            evaluateParameterPoint(value + eps, parameter_index, point_begin, point_end, true, use_analytic);
+            const double delta_plus = (evaluation_cost_matrix_.block(point_begin, 0, point_end - point_begin, num_cost_functions).sum());
 
-        itomp_trajectory_->restoreTrajectory();
+            evaluateParameterPoint(value - eps, parameter_index, point_begin, point_end, false, use_analytic);
+            const double delta_minus = (evaluation_cost_matrix_.block(point_begin, 0, point_end - point_begin, num_cost_functions).sum());
+
+            derivative += (delta_plus - delta_minus) / (2 * eps);
+
+            itomp_trajectory_->restoreTrajectory();
+        }
     }
 
     *(derivative_out + parameter_index) = derivative;
 }
 
+double NewEvalManager::computeAnalyticDerivative(int parameter_index, double value, double eps)
+{
+    const std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
+    const ItompTrajectoryIndex& index = itomp_trajectory_->getTrajectoryIndex(parameter_index);
+
+    bool has_analytic_cost = false;
+    for (int c = 0; c < cost_functions.size(); ++c)
+    {
+        if (cost_functions[c]->hasAnalyticDerivative() && !cost_functions[c]->isInvariant(this, index))
+            has_analytic_cost = true;
+    }
+    if (!has_analytic_cost)
+        return 0.0;
+
+    // keyframe interpolation is linear in the parameters,
+    // so d(trajectory)/d(parameter) does not need kinematics or cost evaluations
+    unsigned int point_begin, point_end;
+    itomp_trajectory_->directChangeForDerivativeComputation(*phase_manager_, parameter_index, value + eps, point_begin, point_end, true);
+    avoidNeighbors(index);
+    if (index.point == point_end)
+        ++point_end;
+    setDirtyPoints(point_begin, point_end);
+    int num_points = point_end - point_begin;
+
+    if (trajectory_derivatives_.rows() < num_points)
+        trajectory_derivatives_.resize(num_points, ItompTrajectory::COMPONENT_TYPE_NUM);
+
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+    {
+        const ElementTrajectoryPtr& element_trajectory = itomp_trajectory_->getElementTrajectory(i, index.sub_component);
+        for (int point = point_begin; point < point_end; ++point)
+            trajectory_derivatives_(point - point_begin, i) = element_trajectory->at(point, index.element);
+    }
+
+    itomp_trajectory_->directChangeForDerivativeComputation(*phase_manager_, parameter_index, value - eps, point_begin, point_end, false);
+    avoidNeighbors(index);
+    if (index.point == point_end)
+        ++point_end;
+
+    for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+    {
+        const ElementTrajectoryPtr& element_trajectory = itomp_trajectory_->getElementTrajectory(i, index.sub_component);
+        for (int point = point_begin; point < point_end; ++point)
+        {
+            double& d = trajectory_derivatives_(point - point_begin, i);
+            d = (d - element_trajectory->at(point, index.element)) / (2 * eps);
+        }
+    }
+
+    // cost derivatives are evaluated on the unperturbed trajectory
+    itomp_trajectory_->restoreTrajectory();
+
+    double derivative = 0.0;
+    double cost_derivative[ItompTrajectory::COMPONENT_TYPE_NUM];
+    for (int c = 0; c < cost_functions.size(); ++c)
+    {
+        if (!cost_functions[c]->hasAnalyticDerivative() || cost_functions[c]->isInvariant(this, index))
+            continue;
+
+        double weight = cost_functions[c]->getWeight();
+        for (int point = point_begin; point < point_end; ++point)
+        {
+            cost_functions[c]->computeDerivative(this, point, index, cost_derivative);
+            for (int i = 0; i < ItompTrajectory::COMPONENT_TYPE_NUM; ++i)
+                derivative += weight * cost_derivative[i] * trajectory_derivatives_(point - point_begin, i);
+        }
+    }
+
+    return derivative;
+}
+
+void NewEvalManager::avoidNeighbors(const ItompTrajectoryIndex& index)
+{
+    if (index.component == ItompTrajectory::COMPONENT_TYPE_POSITION && index.sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_JOINT &&
+            index.element < 2)
+        itomp_trajectory_->avoidNeighbors(trajectory_constraints_);
+}
+
+bool NewEvalManager::requiresFiniteDifference(const ItompTrajectoryIndex& index) const
+{
+    const std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
+    for (int c = 0; c < cost_functions.size(); ++c)
+    {
+        if (!cost_functions[c]->hasAnalyticDerivative() && !cost_functions[c]->isInvariant(this, index))
+            return true;
+    }
+    return false;
+}
+
 void NewEvalManager::computeCostDerivatives(int parameter_index, const ItompTrajectory::ParameterVector& parameters,
         double* derivative_out, std::vector<double*>& cost_derivative_out, double eps)
 {
-    int num_cost_functions = TrajectoryCostManager::getInstance()->getNumActiveCostFunctions();
+    int num_cost_functions = trajectory_cost_manager_->getNumActiveCostFunctions();
 
     unsigned int point_begin, point_end;
     const double value = parameters(parameter_index, 0);
@@ -218,7 +437,7 @@ void NewEvalManager::computeCostDerivatives(int parameter_index, const ItompTraj
     double derivative = 0.0;
 
     const ItompTrajectoryIndex& index = itomp_trajectory_->getTrajectoryIndex(parameter_index);
-    if (PhaseManager::getInstance()->updateParameter(index))
+    if (phase_manager_->updateParameter(index))
     {
         evaluateParameterPoint(value + eps, parameter_index, point_begin, point_end, true);
         const double delta_plus = (evaluation_cost_matrix_.block(point_begin, 0, point_end - point_begin, num_cost_functions).sum());
@@ -242,29 +461,30 @@ void NewEvalManager::computeCostDerivatives(int parameter_index, const ItompTraj
 }
 
 void NewEvalManager::evaluateParameterPoint(double value, int parameter_index,
-        unsigned int& point_begin, unsigned int& point_end, bool first)
+        unsigned int& point_begin, unsigned int& point_end, bool first, bool skip_analytic_costs)
 {
-    itomp_trajectory_->directChangeForDerivativeComputation(parameter_index, value, point_begin, point_end, first);
+    itomp_trajectory_->directChangeForDerivativeComputation(*phase_manager_, parameter_index, value, point_begin, point_end, first);
 
     const ItompTrajectoryIndex& index = itomp_trajectory_->getTrajectoryIndex(parameter_index);
 
-    if (index.component == ItompTrajectory::COMPONENT_TYPE_POSITION && index.sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_JOINT &&
-            index.element < 2)
-        itomp_trajectory_->avoidNeighbors(trajectory_constraints_);
+    avoidNeighbors(index);
 
     if (index.point == point_end)
         ++point_end;
 
+    setDirtyPoints(point_begin, point_end);
+
     performPartialForwardKinematicsAndDynamics(point_begin, point_end, index);
 
-    evaluatePointRange(point_begin, point_end, evaluation_cost_matrix_, index);
+    evaluatePointRange(point_begin, point_end, evaluation_cost_matrix_, index, skip_analytic_costs);
 }
 
-bool NewEvalManager::evaluatePointRange(int point_begin, int point_end, Eigen::MatrixXd& cost_matrix, const ItompTrajectoryIndex& index)
+bool NewEvalManager::evaluatePointRange(int point_begin, int point_end, Eigen::MatrixXd& cost_matrix, const ItompTrajectoryIndex& index,
+                                        bool skip_analytic_costs)
 {
     bool is_feasible = true;
 
-    const std::vector<TrajectoryCostPtr>& cost_functions = TrajectoryCostManager::getInstance()->getCostFunctionVector();
+    const std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
 
     // cost weight changed
     if (cost_functions.size() != cost_matrix.cols())
@@ -272,7 +492,8 @@ bool NewEvalManager::evaluatePointRange(int point_begin, int point_end, Eigen::M
 
     for (int c = 0; c < cost_functions.size(); ++c)
     {
-        if (cost_functions[c]->isInvariant(this, index))
+        if (cost_functions[c]->isInvariant(this, index) ||
+                (skip_analytic_costs && cost_functions[c]->hasAnalyticDerivative()))
         {
             for (int i = point_begin; i < point_end; ++i)
                 cost_matrix(i, c) = 0.0;
@@ -293,48 +514,75 @@ bool NewEvalManager::evaluatePointRange(int point_begin, int point_end, Eigen::M
     return is_feasible;
 }
 
-void NewEvalManager::render()
+void NewEvalManager::render(bool force)
 {
-	bool is_best = (getTrajectoryCost() <= best_cost_);
-	if (PlanningParameters::getInstance()->getAnimatePath())
-    {
-        NewVizManager::getInstance()->animatePath(itomp_trajectory_, robot_state_[0], is_best);
-
-        //if (is_best)
-            NewVizManager::getInstance()->displayTrajectory(itomp_trajectory_);
-    }
-
-	if (PlanningParameters::getInstance()->getAnimateEndeffector())
-	{
-        NewVizManager::getInstance()->animateEndeffectors(itomp_trajectory_, rbdl_models_, is_best);
-        NewVizManager::getInstance()->animateContacts(itomp_trajectory_, contact_variables_, rbdl_models_, is_best);
-	}
-
+#ifndef ITOMP_HEADLESS
+    if (!planning_context_->getVisualize())
+        return;
+
+    bool is_best = (getTrajectoryCost() <= best_cost_);
+    bool animate_path = PlanningParameters::getInstance()->getAnimatePath();
+    bool animate_endeffector = PlanningParameters::getInstance()->getAnimateEndeffector();
+
+    // only the trajectory is displayed if it is not the best one
+    if (!is_best && !animate_path)
+        return;
+
+    if (!NewVizManager::getInstance()->acceptRenderRequest(force))
+        return;
+
+    // the markers are built and published in the visualization thread from a snapshot
+    NewVizManager::RenderRequestPtr request = boost::make_shared<NewVizManager::RenderRequest>();
+    request->trajectory_.reset(itomp_trajectory_->clone());
+    request->is_best_ = is_best;
+    request->animate_path_ = animate_path;
+    request->animate_endeffector_ = animate_endeffector;
     if (is_best)
     {
-        NewVizManager::getInstance()->animateInternalForces(itomp_trajectory_, rbdl_models_, true, true);
-        NewVizManager::getInstance()->animateCenterOfMass(itomp_trajectory_, rbdl_models_);
+        request->robot_state_ = boost::make_shared<robot_state::RobotState>(*robot_state_[0]);
+        request->contact_variables_ = contact_variables_;
+        request->models_ = rbdl_models_;
     }
+
+    NewVizManager::getInstance()->requestRender(request);
+#endif
 }
 
 void NewEvalManager::performFullForwardKinematicsAndDynamics(int point_begin, int point_end)
 {
-	TIME_PROFILER_START_TIMER(FK);
+	TIME_PROFILER_START_TIMER(performance_profiler_, FK);
 
 	int num_contacts = planning_group_->getNumContacts();
     int num_joints = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getNumElements();
 
-	for (int point = point_begin; point < point_end; ++point)
-	{
-        const Eigen::VectorXd& q = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                   ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+    const ElementTrajectoryPtr& pos_trajectory = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+    const ElementTrajectoryPtr& vel_trajectory = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+    const ElementTrajectoryPtr& acc_trajectory = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
 
-        const Eigen::VectorXd& q_dot = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
-                                       ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+    // the kinematics and dynamics of all points are computed in a batch after the forces of the points
+    // the batch buffers are allocated once for all points, the points of a call use their first rows.
+    // they are allocated again only if the number of points changes by an assignment
+    if (!batch_dynamics_.isInitialized() || batch_q_.rows() != rbdl_models_.size())
+    {
+        batch_dynamics_.initialize(rbdl_models_[point_begin], rbdl_models_.size());
+        batch_q_.resize(rbdl_models_.size(), num_joints);
+        batch_q_dot_.resize(rbdl_models_.size(), num_joints);
+        batch_q_ddot_.resize(rbdl_models_.size(), num_joints);
+    }
+    bool use_batch = batch_dynamics_.isSupported();
+    if (passive_forces_.size() != rbdl_models_.size())
+        passive_forces_.resize(rbdl_models_.size());
 
-        const Eigen::VectorXd& q_ddot = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
-                                        ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+    // the points are copied to the vectors allocated once, a plain copy if the trajectory is stored row-major
+    Eigen::VectorXd q(num_joints), q_dot(num_joints), q_ddot(num_joints);
+	for (int point = point_begin; point < point_end; ++point)
+	{
+        q = pos_trajectory->getPoint(point);
+        q_dot = vel_trajectory->getPoint(point);
 
         if (PlanningParameters::getInstance()->getCIEvaluationOnPoints())
         {
@@ -441,18 +689,33 @@ void NewEvalManager::performFullForwardKinematicsAndDynamics(int point_begin, in
         }
 
         // passive forces
-        std::vector<double> passive_forces(num_joints + 1, 0.0);
+        std::vector<double>& passive_forces = passive_forces_[point];
+        passive_forces.assign(num_joints + 1, 0.0);
         computePassiveForces(point, q, q_dot, passive_forces);
 
-        updateFullKinematicsAndDynamics(rbdl_models_[point], q, q_dot, q_ddot, joint_torques_[point], &external_forces_[point], &passive_forces);
+        if (!use_batch)
+        {
+            q_ddot = acc_trajectory->getPoint(point);
+            updateFullKinematicsAndDynamics(rbdl_models_[point], q, q_dot, q_ddot, joint_torques_[point], &external_forces_[point], &passive_forces);
+        }
 	}
 
-	TIME_PROFILER_END_TIMER(FK);
+    if (use_batch)
+    {
+        // points x joints, the joint columns are contiguous
+        batch_q_.topRows(point_end - point_begin) = pos_trajectory->getData().middleRows(point_begin, point_end - point_begin);
+        batch_q_dot_.topRows(point_end - point_begin) = vel_trajectory->getData().middleRows(point_begin, point_end - point_begin);
+        batch_q_ddot_.topRows(point_end - point_begin) = acc_trajectory->getData().middleRows(point_begin, point_end - point_begin);
+        batch_dynamics_.update(rbdl_models_, point_begin, point_end, batch_q_, batch_q_dot_, batch_q_ddot_,
+                               joint_torques_, &external_forces_, &passive_forces_);
+    }
+
+	TIME_PROFILER_END_TIMER(performance_profiler_, FK);
 }
 
 void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin, int point_end, const ItompTrajectoryIndex& index)
 {
-    TIME_PROFILER_START_TIMER(FK);
+    TIME_PROFILER_START_TIMER(performance_profiler_, FK);
 
     bool dynamics_only = (index.sub_component != ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
     int num_contacts = planning_group_->getNumContacts();
@@ -461,12 +724,16 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
     // copy only variables will be updated
     for (int point = point_begin; point < point_end; ++point)
     {
-        rbdl_models_[point].f = ref_evaluation_manager_->rbdl_models_[point].f;
-        rbdl_models_[point].X_lambda = ref_evaluation_manager_->rbdl_models_[point].X_lambda;
-        rbdl_models_[point].X_base = ref_evaluation_manager_->rbdl_models_[point].X_base;
-        rbdl_models_[point].v = ref_evaluation_manager_->rbdl_models_[point].v;
-        rbdl_models_[point].a = ref_evaluation_manager_->rbdl_models_[point].a;
-        rbdl_models_[point].c = ref_evaluation_manager_->rbdl_models_[point].c;
+        RigidBodyDynamics::Model& model = rbdl_models_[getStateIndex(point)];
+        const RigidBodyDynamics::Model& ref_model = ref_evaluation_manager_->rbdl_models_[point];
+        model.f = ref_model.f;
+        model.X_lambda = ref_model.X_lambda;
+        model.X_base = ref_model.X_base;
+        model.v = ref_model.v;
+        model.a = ref_model.a;
+        model.c = ref_model.c;
+        // a slot may have been used by another point
+        model.multdof3_S = ref_model.multdof3_S;
     }
 
     const ElementTrajectoryPtr& pos_trajectory = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
@@ -476,47 +743,50 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
     const ElementTrajectoryPtr& acc_trajectory = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
             ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
 
+    Eigen::VectorXd q(num_joints), q_dot(num_joints), q_ddot(num_joints);
     for (int point = point_begin; point < point_end; ++point)
     {
-        const Eigen::VectorXd& q = pos_trajectory->getTrajectoryPoint(point);
-        const Eigen::VectorXd& q_dot = vel_trajectory->getTrajectoryPoint(point);
-        const Eigen::VectorXd& q_ddot = acc_trajectory->getTrajectoryPoint(point);
+        unsigned int state_index = getStateIndex(point);
+
+        q = pos_trajectory->getPoint(point);
+        q_dot = vel_trajectory->getPoint(point);
+        q_ddot = acc_trajectory->getPoint(point);
 
         if (dynamics_only)
         {
             if (PlanningParameters::getInstance()->getCIEvaluationOnPoints())
             {
                 // compute contact variables
-                itomp_trajectory_->getContactVariables(point, contact_variables_[point]);
+                itomp_trajectory_->getContactVariables(point, contact_variables_[state_index]);
 
                 // compute external forces
                 for (int i = 0; i < num_contacts; ++i)
                 {
-                    const Eigen::Vector3d contact_position = contact_variables_[point][i].getPosition();
-                    const Eigen::Vector3d contact_orientation = contact_variables_[point][i].getOrientation();
+                    const Eigen::Vector3d contact_position = contact_variables_[state_index][i].getPosition();
+                    const Eigen::Vector3d contact_orientation = contact_variables_[state_index][i].getOrientation();
 
                     Eigen::Vector3d contact_normal, proj_position, proj_orientation;
 
                     proj_position = contact_position;
                     proj_orientation = contact_orientation;
 
-                    contact_variables_[point][i].ComputeProjectedPointPositions(proj_position, proj_orientation,
-                            rbdl_models_[point], planning_group_->contact_points_[i]);
+                    contact_variables_[state_index][i].ComputeProjectedPointPositions(proj_position, proj_orientation,
+                            rbdl_models_[state_index], planning_group_->contact_points_[i]);
 
                     for (int c = 0; c < NUM_ENDEFFECTOR_CONTACT_POINTS; ++c)
                     {
-                        Eigen::Vector3d& point_position = contact_variables_[point][i].projected_point_positions_[c];
+                        Eigen::Vector3d& point_position = contact_variables_[state_index][i].projected_point_positions_[c];
                         Eigen::Vector3d point_orientation;
                         GroundManager::getInstance()->getNearestContactPosition(point_position, proj_orientation,
                                 point_position, point_orientation, contact_normal, i < 2);
 
                         int rbdl_point_id = planning_group_->contact_points_[i].getContactPointRBDLIds(c);
 
-                        Eigen::Vector3d contact_force = contact_variables_[point][i].getPointForce(c);
+                        Eigen::Vector3d contact_force = contact_variables_[state_index][i].getPointForce(c);
 
                         Eigen::Vector3d contact_torque = point_position.cross(contact_force);
 
-                        RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[point][rbdl_point_id];
+                        RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[state_index][rbdl_point_id];
                         for (int j = 0; j < 3; ++j)
                         {
                             ext_force(j) = contact_torque(j);
@@ -528,18 +798,18 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
             else
             {
                 // compute contact variables
-                itomp_trajectory_->getContactVariables(point, contact_variables_[point]);
+                itomp_trajectory_->getContactVariables(point, contact_variables_[state_index]);
                 for (int i = 0; i < num_contacts; ++i)
                 {
-                    const Eigen::Vector3d contact_position = contact_variables_[point][i].getPosition();
-                    const Eigen::Vector3d contact_orientation = contact_variables_[point][i].getOrientation();
+                    const Eigen::Vector3d contact_position = contact_variables_[state_index][i].getPosition();
+                    const Eigen::Vector3d contact_orientation = contact_variables_[state_index][i].getOrientation();
 
                     Eigen::Vector3d contact_normal, proj_position, proj_orientation;
                     GroundManager::getInstance()->getNearestContactPosition(contact_position, contact_orientation,
                             proj_position, proj_orientation, contact_normal, i < 2);
 
-                    contact_variables_[point][i].ComputeProjectedPointPositions(proj_position, proj_orientation,
-                            rbdl_models_[point], planning_group_->contact_points_[i]);
+                    contact_variables_[state_index][i].ComputeProjectedPointPositions(proj_position, proj_orientation,
+                            rbdl_models_[state_index], planning_group_->contact_points_[i]);
                 }
 
                 // compute external forces
@@ -549,13 +819,13 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
                     {
                         int rbdl_point_id = planning_group_->contact_points_[i].getContactPointRBDLIds(c);
 
-                        Eigen::Vector3d point_position = contact_variables_[point][i].projected_point_positions_[c];
+                        Eigen::Vector3d point_position = contact_variables_[state_index][i].projected_point_positions_[c];
 
-                        Eigen::Vector3d contact_force = contact_variables_[point][i].getPointForce(c);
+                        Eigen::Vector3d contact_force = contact_variables_[state_index][i].getPointForce(c);
 
                         Eigen::Vector3d contact_torque = point_position.cross(contact_force);
 
-                        RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[point][rbdl_point_id];
+                        RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[state_index][rbdl_point_id];
                         for (int j = 0; j < 3; ++j)
                         {
                             ext_force(j) = contact_torque(j);
@@ -577,7 +847,7 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
             {
                 const int rbdl_id = hands_ids[i];
 
-                RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[point][rbdl_id];
+                RigidBodyDynamics::Math::SpatialVector& ext_force = external_forces_[state_index][rbdl_id];
                 for (int j = 0; j < 3; ++j)
                 {
                     ext_force(j) = 0.0;
@@ -592,26 +862,26 @@ void NewEvalManager::performPartialForwardKinematicsAndDynamics(int point_begin,
             std::vector<double> passive_forces(num_joints + 1, 0.0);
             computePassiveForces(point, q, q_dot, passive_forces);
 
-            updatePartialDynamics(rbdl_models_[point], q, q_dot, q_ddot, joint_torques_[point], &external_forces_[point], &passive_forces);
+            updatePartialDynamics(rbdl_models_[state_index], q, q_dot, q_ddot, joint_torques_[state_index], &external_forces_[state_index], &passive_forces);
         }
         else
         {
-            contact_variables_[point] = ref_evaluation_manager_->contact_variables_[point];
-            joint_torques_[point] = ref_evaluation_manager_->joint_torques_[point];
-            external_forces_[point] = ref_evaluation_manager_->external_forces_[point];
+            contact_variables_[state_index] = ref_evaluation_manager_->contact_variables_[point];
+            joint_torques_[state_index] = ref_evaluation_manager_->joint_torques_[point];
+            external_forces_[state_index] = ref_evaluation_manager_->external_forces_[point];
 
             // passive forces
             std::vector<double> passive_forces(num_joints + 1, 0.0);
             computePassiveForces(point, q, q_dot, passive_forces);
 
-            updatePartialKinematicsAndDynamics(rbdl_models_[point], q, q_dot,
-                                               q_ddot, joint_torques_[point], &external_forces_[point], &passive_forces,
+            updatePartialKinematicsAndDynamics(rbdl_models_[state_index], q, q_dot,
+                                               q_ddot, joint_torques_[state_index], &external_forces_[state_index], &passive_forces,
                                                planning_group_->group_joints_[itomp_trajectory_->getParameterJointIndex(index.element)].rbdl_affected_body_ids_);
 
         }
     }
 
-    TIME_PROFILER_END_TIMER(FK);
+    TIME_PROFILER_END_TIMER(performance_profiler_, FK);
 }
 
 void NewEvalManager::getParameters(ItompTrajectory::ParameterVector& parameters) const
@@ -621,10 +891,21 @@ void NewEvalManager::getParameters(ItompTrajectory::ParameterVector& parameters)
 
 void NewEvalManager::setParameters(const ItompTrajectory::ParameterVector& parameters)
 {
-    itomp_trajectory_->setParameters(parameters, planning_group_);
+    itomp_trajectory_->setParameters(parameters, planning_group_, *phase_manager_, &dirty_points_);
     //itomp_trajectory_->avoidNeighbors(trajectory_constraints_);
 }
 
+double NewEvalManager::getTrajectoryCost(const std::string& cost_name) const
+{
+    const std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
+    for (int c = 0; c < cost_functions.size() && c < evaluation_cost_matrix_.cols(); ++c)
+    {
+        if (cost_functions[c]->getName() == cost_name)
+            return evaluation_cost_matrix_.col(c).sum();
+    }
+    return 0.0;
+}
+
 void NewEvalManager::printTrajectoryCost(int iteration, bool details)
 {
 	double cost = evaluation_cost_matrix_.sum();
@@ -637,7 +918,7 @@ void NewEvalManager::printTrajectoryCost(int iteration, bool details)
 
     //return;
 
-    const std::vector<TrajectoryCostPtr>& cost_functions = TrajectoryCostManager::getInstance()->getCostFunctionVector();
+    const std::vector<TrajectoryCostPtr>& cost_functions = trajectory_cost_manager_->getCostFunctionVector();
 
 	if (!details || !is_best)
 	{
@@ -653,25 +934,8 @@ void NewEvalManager::printTrajectoryCost(int iteration, bool details)
                 max_cost_name_length = cost_functions[c]->getName().size();
 
 
+        // the costs of each point are stored in the phase checkpoints
         cout.precision(3);
-        for (int c = 0; c < cost_functions.size(); ++c)
-        {
-            cout << cost_functions[c]->getName() << " ";
-        }
-        cout << endl;
-        for (int i = 0; i < itomp_trajectory_->getNumPoints(); ++i)
-        {
-            cout << i << " : ";
-            for (int c = 0; c < cost_functions.size(); ++c)
-            {
-                double cost = evaluation_cost_matrix_(i, c);
-                std::cout << fixed << cost << " ";
-            }
-            std::cout << std::endl;
-        }
-
-
-
         for (int c = 0; c < cost_functions.size(); ++c)
         {
             double sub_cost = evaluation_cost_matrix_.col(c).sum();
@@ -709,6 +973,51 @@ void NewEvalManager::initializeContactVariables()
 		contact_variables_[i].resize(num_contacts);
 	}
 
+    // IK toe of the start and goal points
+    int num_points = itomp_trajectory_->getNumPoints();
+    std::vector<unsigned int> ik_points;
+    ik_points.push_back(0);
+    if (num_points > 1)
+        ik_points.push_back(num_points - 1);
+    std::vector<InverseKinematics6DProblem> ik_problems(ik_points.size());
+    std::vector<RigidBodyDynamics::Math::VectorNd> ik_q(ik_points.size());
+    for (int index = 0; index < ik_points.size(); ++index)
+    {
+        int point = ik_points[index];
+        InverseKinematics6DProblem& problem = ik_problems[index];
+
+        ik_q[index] = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+        RigidBodyDynamics::UpdateKinematicsCustom(rbdl_models_[point], &ik_q[index], NULL, NULL);
+
+        for (int i = 2; i < num_contacts; ++i)
+        {
+            int rbdl_body_id = planning_group_->contact_points_[i].getRBDLBodyId();
+
+            Eigen::Vector3d contact_normal, proj_position, proj_orientation;
+            GroundManager::getInstance()->getNearestContactPosition(rbdl_models_[point].X_base[rbdl_body_id].r, exponential_map::RotationToExponentialMap(rbdl_models_[point].X_base[rbdl_body_id].E),
+                    proj_position, proj_orientation, contact_normal);
+
+            proj_position(0) = rbdl_models_[point].X_base[rbdl_body_id].r(0);
+            proj_position(1) = rbdl_models_[point].X_base[rbdl_body_id].r(1);
+
+            problem.body_ids.push_back(rbdl_body_id);
+            problem.target_positions.push_back(RigidBodyDynamics::Math::Vector3d(proj_position));
+            problem.target_orientations.push_back(exponential_map::ExponentialMapToRotation(proj_orientation));
+        }
+    }
+
+    std::vector<int> ik_results;
+    InverseKinematics6DBatch(rbdl_models_, ik_points, ik_problems, ik_q, ik_results);
+    for (int index = 0; index < ik_points.size(); ++index)
+    {
+        if (ik_results[index])
+            itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                               ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(ik_points[index]) = ik_q[index];
+        else
+            ROS_INFO("IK failed");
+    }
+
     for (int point = 0; point < itomp_trajectory_->getNumPoints(); ++point)
 	{
         Eigen::VectorXd q = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
@@ -727,68 +1036,6 @@ void NewEvalManager::initializeContactVariables()
 		std::vector<RigidBodyDynamics::Math::SpatialVector> ext_forces;
         ext_forces.resize(rbdl_models_[point].mBodies.size(), RigidBodyDynamics::Math::SpatialVectorZero);
 
-        if (point == 0 || point == itomp_trajectory_->getNumPoints() - 1)
-        {
-            std::vector<unsigned int> body_ids;
-            std::vector<RigidBodyDynamics::Math::Vector3d> target_positions;
-            std::vector<RigidBodyDynamics::Math::Matrix3d> target_orientations;
-
-            // IK toe
-            for (int i = 2; i < num_contacts; ++i)
-            {
-                int rbdl_body_id = planning_group_->contact_points_[i].getRBDLBodyId();
-
-                Eigen::Vector3d contact_normal, proj_position, proj_orientation;
-                GroundManager::getInstance()->getNearestContactPosition(rbdl_models_[point].X_base[rbdl_body_id].r, exponential_map::RotationToExponentialMap(rbdl_models_[point].X_base[rbdl_body_id].E),
-                        proj_position, proj_orientation, contact_normal);
-
-                proj_position(0) = rbdl_models_[point].X_base[rbdl_body_id].r(0);
-                proj_position(1) = rbdl_models_[point].X_base[rbdl_body_id].r(1);
-
-                /*
-                const Eigen::Vector3d position_bias(-0.2, 0.0, 0.0);
-                proj_position += position_bias;
-                */
-
-                body_ids.push_back(rbdl_body_id);
-                RigidBodyDynamics::Math::Vector3d target_pos(proj_position);
-                target_positions.push_back(target_pos);
-                RigidBodyDynamics::Math::Matrix3d target_orientation = exponential_map::ExponentialMapToRotation(proj_orientation);
-                target_orientations.push_back(target_orientation);
-
-                cout << "body id: " << rbdl_body_id << endl
-                     << "original position:" << endl
-                     << rbdl_models_[point].X_base[rbdl_body_id].r << endl
-                     << "origianl orientation:" << endl
-                     << rbdl_models_[point].X_base[rbdl_body_id].E << endl
-                     << "target position:" << endl
-                     << target_pos << endl
-                     << "target orientation:" << endl
-                     << target_orientation << endl
-                     << "axis:" << endl
-                     << rbdl_models_[point].S[rbdl_body_id] << endl
-                     << endl;
-            }
-
-            // IK hands
-            const int hand_body_ids[] = {
-                rbdl_models_[point]->GetBodyId("lwrist"),
-                rbdl_models_[point]->GetBodyId("rwrist"),
-            };
-            for (int i=0; i<2; i++)
-            {
-            }
-
-            if (itomp_cio_planner::InverseKinematics6D(rbdl_models_[point], q, body_ids, target_positions, target_orientations, q))
-            {
-                updateFullKinematicsAndDynamics(rbdl_models_[point], q, q_dot, q_ddot, tau, NULL, NULL);
-                itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                                   ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point) = q;
-            }
-            else
-                ROS_INFO("IK failed");
-        }
-
 		for (int i = 0; i < num_contacts; ++i)
 		{
             int rbdl_body_id = planning_group_->contact_points_[i].getRBDLBodyId();
@@ -868,16 +1115,31 @@ void NewEvalManager::correctContacts(bool update_kinematics)
 
 void NewEvalManager::correctContacts(int point_begin, int point_end, bool update_kinematics)
 {
+    setDirtyPoints(point_begin, point_end);
+
     int num_contacts = planning_group_->getNumContacts();
-    for (int point = std::max(point_begin, 1); point < std::min((unsigned int)point_end, itomp_trajectory_->getNumPoints() - 1); ++point)
+    int num_points = itomp_trajectory_->getNumPoints();
+    point_begin = std::max(point_begin, 1);
+    point_end = std::min(point_end, num_points - 1);
+    if (point_begin >= point_end)
+        return;
+
+    ecl::QuinticPolynomial poly;
+    poly = ecl::QuinticPolynomial::Interpolation(0, 0.0, 0.0, 0.0,
+                                                 num_points - 1, 1.0, 0.0, 0.0);
+
+    // the fixed contacts of the points are moved between the start and goal contact poses.
+    // the IK of the points are independent
+    int num_ik_points = point_end - point_begin;
+    std::vector<unsigned int> ik_points(num_ik_points);
+    std::vector<InverseKinematics6DProblem> ik_problems(num_ik_points);
+    std::vector<RigidBodyDynamics::Math::VectorNd> ik_q(num_ik_points);
+    for (int point = point_begin; point < point_end; ++point)
     {
-        std::vector<unsigned int> body_ids;
-        std::vector<RigidBodyDynamics::Math::Vector3d> target_positions;
-        std::vector<RigidBodyDynamics::Math::Matrix3d> target_orientations;
+        int index = point - point_begin;
+        InverseKinematics6DProblem& problem = ik_problems[index];
+        ik_points[index] = point;
 
-        ecl::QuinticPolynomial poly;
-        poly = ecl::QuinticPolynomial::Interpolation(0, 0.0, 0.0, 0.0,
-                                                     itomp_trajectory_->getNumPoints() - 1, 1.0, 0.0, 0.0);
         double t = poly(point);
         for (int i = 0; i < num_contacts; ++i)
         {
@@ -885,24 +1147,32 @@ void NewEvalManager::correctContacts(int point_begin, int point_end, bool update
                 continue;
 
             int rbdl_body_id = planning_group_->contact_points_[i].getRBDLBodyId();
-            body_ids.push_back(rbdl_body_id);
+            problem.body_ids.push_back(rbdl_body_id);
 
             RigidBodyDynamics::Math::Vector3d start_pos(rbdl_models_[0].X_base[rbdl_body_id].r);
-            RigidBodyDynamics::Math::Vector3d goal_pos(rbdl_models_[itomp_trajectory_->getNumPoints() - 1].X_base[rbdl_body_id].r);
+            RigidBodyDynamics::Math::Vector3d goal_pos(rbdl_models_[num_points - 1].X_base[rbdl_body_id].r);
             RigidBodyDynamics::Math::Vector3d target_pos(start_pos * (1.0 - t) + goal_pos * t);
-            target_positions.push_back(target_pos);
+            problem.target_positions.push_back(target_pos);
 
             Quaterniond start_ori(rbdl_models_[0].X_base[rbdl_body_id].E);
-            Quaterniond end_ori(rbdl_models_[itomp_trajectory_->getNumPoints() - 1].X_base[rbdl_body_id].E);
+            Quaterniond end_ori(rbdl_models_[num_points - 1].X_base[rbdl_body_id].E);
             RigidBodyDynamics::Math::Matrix3d target_orientation(Eigen::Matrix3d(start_ori.slerp(t, end_ori)));
-            target_orientations.push_back(target_orientation);
+            problem.target_orientations.push_back(target_orientation);
         }
 
-        Eigen::VectorXd q = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                   ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+        ik_q[index] = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                      ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
+    }
+
+    std::vector<int> ik_results;
+    InverseKinematics6DBatch(rbdl_models_, ik_points, ik_problems, ik_q, ik_results);
 
+    // the contact orientations depend on the previous point
+    for (int point = point_begin; point < point_end; ++point)
+    {
+        const Eigen::VectorXd& q = ik_q[point - point_begin];
 
-        if (itomp_cio_planner::InverseKinematics6D(rbdl_models_[point], q, body_ids, target_positions, target_orientations, q))
+        if (ik_results[point - point_begin])
         {
             // repeat above
             itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
@@ -1045,7 +1315,7 @@ void NewEvalManager::computePassiveForces(int point,
 
     for (int i = 1; i <= num_joints; ++i)
     {
-        int q_index = rbdl_models_[point].mJoints[i].q_index;
+        int q_index = rbdl_models_[getStateIndex(point)].mJoints[i].q_index;
 
         if ((q_index >= 3 && q_index <= 5) ||
             (q_index >= 46 && q_index <= 54) ||
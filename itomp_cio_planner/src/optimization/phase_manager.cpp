@@ -5,7 +5,7 @@ namespace itomp_cio_planner
 {
 
 PhaseManager::PhaseManager()
-    : phase_(0), num_points_(0)
+    : phase_(0), warm_start_phase_(0), num_points_(0)
 {
     support_foot_ = 0; // any
     agent_id_ = 0;
@@ -71,7 +71,7 @@ bool PhaseManager::updateParameter(const ItompTrajectoryIndex& index) const
             if (index.point == 0 || index.point == num_points_ -1)
                 return true;
 
-            int contact_id = index.element / 12;
+            int contact_id = index.element / CONTACT_FORCE_GROUP_SIZE;
             if (planning_group_->is_fixed_[contact_id])
                 return true;
         }
@@ -89,7 +89,7 @@ bool PhaseManager::updateParameter(const ItompTrajectoryIndex& index) const
 
         if (index.sub_component == ItompTrajectory::SUB_COMPONENT_TYPE_CONTACT_FORCE)
         {
-            int contact_id = index.element / 12;
+            int contact_id = index.element / CONTACT_FORCE_GROUP_SIZE;
             if (planning_group_->is_fixed_[contact_id])
                 return true;
 
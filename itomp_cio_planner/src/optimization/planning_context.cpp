@@ -0,0 +1,19 @@
+#include <itomp_cio_planner/optimization/planning_context.h>
+
+namespace itomp_cio_planner
+{
+
+PlanningContext::PlanningContext(int trial_index, bool visualize)
+    : trial_index_(trial_index), visualize_(visualize)
+{
+    phase_manager_ = boost::make_shared<PhaseManager>();
+    trajectory_cost_manager_ = boost::make_shared<TrajectoryCostManager>();
+    performance_profiler_ = boost::make_shared<PerformanceProfiler>();
+}
+
+PlanningContext::~PlanningContext()
+{
+
+}
+
+}
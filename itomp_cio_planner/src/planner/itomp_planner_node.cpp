@@ -1,4 +1,5 @@
 #include <itomp_cio_planner/planner/itomp_planner_node.h>
+#include <itomp_cio_planner/planner/trajectory_cache.h>
 #include <itomp_cio_planner/model/itomp_planning_group.h>
 #include <itomp_cio_planner/model/itomp_robot_model_ik.h>
 #include <itomp_cio_planner/trajectory/trajectory_factory.h>
@@ -6,12 +7,14 @@
 #include <itomp_cio_planner/util/joint_state_util.h>
 #include <itomp_cio_planner/visualization/new_viz_manager.h>
 #include <itomp_cio_planner/optimization/phase_manager.h>
+#include <itomp_cio_planner/optimization/checkpoint.h>
 #include <itomp_cio_planner/contact/ground_manager.h>
 #include <kdl/jntarray.hpp>
 #include <angles/angles.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <boost/random/uniform_real.hpp>
 #include <boost/random/variate_generator.hpp>
+#include <boost/thread/mutex.hpp>
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/robot_state/robot_state.h>
 #include <moveit/robot_state/conversions.h>
@@ -22,19 +25,61 @@ using namespace std;
 namespace itomp_cio_planner
 {
 
+namespace
+{
+
+// planTrajectory can be called concurrently by several planner nodes, e.g. for the segments of a path.
+// the parameters and the contact surfaces shared by the nodes are loaded by the first active request
+// and released by the last one. the requests should use the same planning scene
+int num_active_requests = 0;
+// the singletons shared by the nodes are destroyed with the last node
+int num_planner_nodes = 0;
+// the nodes plan in boost threads, the counters and the shared state are guarded by a mutex
+boost::mutex shared_state_mutex;
+
+// returns true for the first active request
+bool acquireSharedState(const planning_scene::PlanningSceneConstPtr& planning_scene)
+{
+    boost::mutex::scoped_lock lock(shared_state_mutex);
+    bool is_first_request = (num_active_requests++ == 0);
+    if (is_first_request)
+    {
+        PlanningParameters::getInstance()->initFromNodeHandle();
+        GroundManager::getInstance()->initialize(planning_scene);
+    }
+    return is_first_request;
+}
+
+void releaseSharedState()
+{
+    boost::mutex::scoped_lock lock(shared_state_mutex);
+    if (--num_active_requests == 0)
+        GroundManager::getInstance()->destroy();
+}
+
+}
+
 ItompPlannerNode::ItompPlannerNode(const robot_model::RobotModelConstPtr& model) :
 	robot_model_(model)
 {
-
+    boost::mutex::scoped_lock lock(shared_state_mutex);
+    ++num_planner_nodes;
 }
 
 ItompPlannerNode::~ItompPlannerNode()
 {
-    NewVizManager::getInstance()->destroy();
-    TrajectoryFactory::getInstance()->destroy();
-    PlanningParameters::getInstance()->destroy();
+    {
+        boost::mutex::scoped_lock lock(shared_state_mutex);
+        if (--num_planner_nodes == 0)
+        {
+            CheckpointWriter::getInstance()->destroy();
+            NewVizManager::getInstance()->destroy();
+            TrajectoryFactory::getInstance()->destroy();
+            TrajectoryCache::getInstance()->destroy();
+            PlanningParameters::getInstance()->destroy();
+        }
+    }
 
-    optimizer_.reset();
     itomp_trajectory_.reset();
     itomp_robot_model_.reset();
 }
@@ -50,6 +95,8 @@ bool ItompPlannerNode::init()
 		return false;
 
 	NewVizManager::getInstance()->initialize(itomp_robot_model_);
+    // created before the planning trials, which may run in parallel
+    CheckpointWriter::getInstance();
 
     TrajectoryFactory::getInstance()->initialize(TrajectoryFactory::TRAJECTORY_CIO);
     itomp_trajectory_.reset(
@@ -69,11 +116,12 @@ bool ItompPlannerNode::planTrajectory(const planning_scene::PlanningSceneConstPt
                                       const planning_interface::MotionPlanRequest &req,
                                       planning_interface::MotionPlanResponse &res)
 {
-	// reload parameters
-	PlanningParameters::getInstance()->initFromNodeHandle();
+	// reload parameters. only the first of concurrent requests is visualized
+    bool visualize = acquireSharedState(planning_scene);
 
 	if (!validateRequest(req))
     {
+        releaseSharedState();
         ROS_INFO("Planning failure - invalid planning request");
         res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
 		return false;
@@ -82,73 +130,57 @@ bool ItompPlannerNode::planTrajectory(const planning_scene::PlanningSceneConstPt
     // set trajectory to zero
     itomp_trajectory_->reset();
 
-    GroundManager::getInstance()->initialize(planning_scene);
-
     double trajectory_start_time = req.start_state.joint_state.header.stamp.toSec();
     robot_state::RobotStatePtr initial_robot_state = planning_scene->getCurrentStateUpdated(req.start_state);
 
 	// generate planning group list
 	vector<string> planning_group_names = getPlanningGroups(req.group_name);
-    planning_info_manager_.reset(PlanningParameters::getInstance()->getNumTrials(), planning_group_names.size());
+    int num_trials = PlanningParameters::getInstance()->getNumTrials();
+    planning_info_manager_.reset(num_trials, planning_group_names.size());
+    bool success = false;
 
-	for (int c = 0; c < PlanningParameters::getInstance()->getNumTrials(); ++c)
-	{
-		double planning_start_time = ros::Time::now().toSec();
-
-        //ROS_INFO("Planning Trial [%d]", c);
-
-		// initialize trajectory with start state
-        itomp_trajectory_->setStartState(req.start_state.joint_state, itomp_robot_model_);
-
-        // read start state
-        //bool read_start_state_from_previous_step = readWaypoint(initial_robot_state);
-
-		// for each planning group
-		for (unsigned int i = 0; i != planning_group_names.size(); ++i)
-		{
-			ros::WallTime create_time = ros::WallTime::now();
-
-            const ItompPlanningGroupConstPtr planning_group = itomp_robot_model_->getPlanningGroup(planning_group_names[i]);
-
-            sensor_msgs::JointState goal_joint_state = getGoalStateFromGoalConstraints(itomp_robot_model_, req);
-
-			/// optimize
-            itomp_trajectory_->setGoalState(goal_joint_state, planning_group, itomp_robot_model_, req.trajectory_constraints);
-
-            robot_state::RobotState goal_state(*initial_robot_state);
-            //robot_state::jointStateToRobotState(goal_joint_state, goal_state);
-            for (unsigned int j = 0; j < goal_joint_state.name.size(); ++j)
-            {
-                if (goal_joint_state.name[j] != "")
-                    goal_state.setVariablePosition(goal_joint_state.name[j], goal_joint_state.position[j]);
-            }
-            goal_state.update(true);
-
-            //if (!adjustStartGoalPositions(*initial_robot_state, goal_state, read_start_state_from_previous_step))
-              //  res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
-
-            optimizer_ = boost::make_shared<ItompOptimizer>(0, itomp_trajectory_,
-						 itomp_robot_model_, planning_scene, planning_group, planning_start_time,
-                         trajectory_start_time, req.trajectory_constraints.constraints);
-
-            optimizer_->optimize();
-
-            const PlanningInfo& planning_info = optimizer_->getPlanningInfo();
-
-            planning_info_manager_.write(c, i, planning_info);
+    if (PlanningParameters::getInstance()->getUseParallelTrials() && num_trials > 1)
+    {
+        // each trial has its own trajectory and planning context. only the first trial is visualized
+        std::vector<ItompTrajectoryPtr> trajectories(num_trials);
+        std::vector<PlanningContextPtr> planning_contexts(num_trials);
+        std::vector<int> trial_success(num_trials);
+        for (int c = 0; c < num_trials; ++c)
+        {
+            trajectories[c] = (c == 0) ? itomp_trajectory_ : ItompTrajectoryPtr(itomp_trajectory_->clone());
+            planning_contexts[c] = boost::make_shared<PlanningContext>(c, visualize && c == 0);
+        }
 
-            ROS_INFO("Optimization of group %s took %f sec", planning_group_names[i].c_str(), (ros::WallTime::now() - create_time).toSec());
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < num_trials; ++c)
+        {
+            trial_success[c] = planTrial(c, trajectories[c], planning_contexts[c], planning_scene, req,
+                                         initial_robot_state, planning_group_names, trajectory_start_time);
+        }
 
-            if (planning_info.cost > PlanningParameters::getInstance()->getFailureCost())
-            {
-                //res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
-                ROS_INFO("Planning failure - cost : %f", planning_info.cost);
-                //return false;
-            }
+        int best_trial = planning_info_manager_.getBestTrial();
+        ROS_INFO("Use the result of trial %d", best_trial);
+        itomp_trajectory_ = trajectories[best_trial];
+        success = trial_success[best_trial];
+    }
+    else
+    {
+        PlanningContextPtr planning_context = boost::make_shared<PlanningContext>(0, visualize);
+        for (int c = 0; c < num_trials; ++c)
+        {
+            success = planTrial(c, itomp_trajectory_, planning_context, planning_scene, req,
+                                initial_robot_state, planning_group_names, trajectory_start_time);
         }
-	}
+    }
+
+    // successful results seed the following requests
+    int warm_start_cache_size = PlanningParameters::getInstance()->getWarmStartCacheSize();
+    if (success && warm_start_cache_size > 0)
+        TrajectoryCache::getInstance()->insert(*itomp_trajectory_, warm_start_cache_size);
     if (PlanningParameters::getInstance()->getPrintPlanningInfo())
         planning_info_manager_.printSummary();
+    // the checkpoints of the request are on disk when it returns
+    CheckpointWriter::getInstance()->flush();
 
     /*
     if (itomp_trajectory_->avoidNeighbors(req.trajectory_constraints.constraints) == false)
@@ -167,11 +199,85 @@ bool ItompPlannerNode::planTrajectory(const planning_scene::PlanningSceneConstPt
 	// return trajectory
     fillInResult(initial_robot_state, res);
 
-    GroundManager::getInstance()->destroy();
+    releaseSharedState();
 
 	return true;
 }
 
+bool ItompPlannerNode::planTrial(int trial, const ItompTrajectoryPtr& itomp_trajectory,
+                                 const PlanningContextPtr& planning_context,
+                                 const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                 const planning_interface::MotionPlanRequest &req,
+                                 const robot_state::RobotStatePtr& initial_robot_state,
+                                 const std::vector<std::string>& planning_group_names,
+                                 double trajectory_start_time)
+{
+    double planning_start_time = ros::Time::now().toSec();
+    bool success = true;
+
+    //ROS_INFO("Planning Trial [%d]", trial);
+
+    // initialize trajectory with start state
+    itomp_trajectory->setStartState(req.start_state.joint_state, itomp_robot_model_);
+
+    // read start state
+    //bool read_start_state_from_previous_step = readWaypoint(initial_robot_state, planning_context);
+
+    // for each planning group
+    for (unsigned int i = 0; i != planning_group_names.size(); ++i)
+    {
+        ros::WallTime create_time = ros::WallTime::now();
+
+        const ItompPlanningGroupConstPtr planning_group = itomp_robot_model_->getPlanningGroup(planning_group_names[i]);
+
+        sensor_msgs::JointState goal_joint_state = getGoalStateFromGoalConstraints(itomp_robot_model_, req);
+
+        /// optimize
+        itomp_trajectory->setGoalState(goal_joint_state, planning_group, itomp_robot_model_, req.trajectory_constraints);
+
+        robot_state::RobotState goal_state(*initial_robot_state);
+        //robot_state::jointStateToRobotState(goal_joint_state, goal_state);
+        for (unsigned int j = 0; j < goal_joint_state.name.size(); ++j)
+        {
+            if (goal_joint_state.name[j] != "")
+                goal_state.setVariablePosition(goal_joint_state.name[j], goal_joint_state.position[j]);
+        }
+        goal_state.update(true);
+
+        // the cached trajectories have all joints, only the first group is warm-started
+        unsigned int warm_start_phase = 0;
+        if (i == 0 && PlanningParameters::getInstance()->getWarmStartCacheSize() > 0 &&
+                TrajectoryCache::getInstance()->seed(*itomp_trajectory, PlanningParameters::getInstance()->getWarmStartMaxDistance()))
+            warm_start_phase = std::max(0, PlanningParameters::getInstance()->getWarmStartPhase());
+        planning_context->getPhaseManager()->setWarmStartPhase(warm_start_phase);
+
+        //if (!adjustStartGoalPositions(*initial_robot_state, goal_state, read_start_state_from_previous_step, planning_context))
+          //  res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+
+        ItompOptimizerPtr optimizer = boost::make_shared<ItompOptimizer>(0, planning_context, itomp_trajectory,
+                                      itomp_robot_model_, planning_scene, planning_group, planning_start_time,
+                                      trajectory_start_time, req.trajectory_constraints.constraints);
+
+        optimizer->optimize();
+
+        const PlanningInfo& planning_info = optimizer->getPlanningInfo();
+
+        planning_info_manager_.write(trial, i, planning_info);
+
+        ROS_INFO("Optimization of group %s took %f sec", planning_group_names[i].c_str(), (ros::WallTime::now() - create_time).toSec());
+
+        if (planning_info.cost > PlanningParameters::getInstance()->getFailureCost())
+        {
+            //res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+            ROS_INFO("Planning failure - cost : %f", planning_info.cost);
+            //return false;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
 bool ItompPlannerNode::validateRequest(const planning_interface::MotionPlanRequest &req)
 {
     ROS_INFO("Received planning request ... planning group : %s", req.group_name.c_str());
@@ -270,7 +376,7 @@ void ItompPlannerNode::fillInResult(const robot_state::RobotStatePtr& robot_stat
 	}
 }
 
-bool ItompPlannerNode::readWaypoint(robot_state::RobotStatePtr& robot_state)
+bool ItompPlannerNode::readWaypoint(robot_state::RobotStatePtr& robot_state, const PlanningContextPtr& planning_context)
 {
     double value;
 
@@ -280,7 +386,7 @@ bool ItompPlannerNode::readWaypoint(robot_state::RobotStatePtr& robot_state)
     node_handle.getParam("agent_id", agent_id);
     node_handle.getParam("agent_trajectory_index", trajectory_index);
 
-    PhaseManager::getInstance()->agent_id_ = agent_id;
+    planning_context->getPhaseManager()->agent_id_ = agent_id;
 
     std::ifstream trajectory_file;
     std::stringstream ss;
@@ -435,7 +541,8 @@ void ItompPlannerNode::writeTrajectory()
     trajectory_file.close();
 }
 
-bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial_state, robot_state::RobotState& goal_state, bool read_start_state_from_previous_step)
+bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial_state, robot_state::RobotState& goal_state, bool read_start_state_from_previous_step,
+        const PlanningContextPtr& planning_context)
 {
     const double MIN_ANKLE_Z_ROTATION_ANGLE = M_PI / 60.0;
     const double GOAL_MOVE_ORIENTATION_BOUND = M_PI / 6.0;
@@ -444,9 +551,9 @@ bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial
     unsigned int mid_index = goal_index / 2;
     ElementTrajectoryPtr& joint_traj = itomp_trajectory_->getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
                                        ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
-    Eigen::MatrixXd::RowXpr traj_start_point = joint_traj->getTrajectoryPoint(0);
-    Eigen::MatrixXd::RowXpr traj_mid_point = joint_traj->getTrajectoryPoint(mid_index);
-    Eigen::MatrixXd::RowXpr traj_goal_point = joint_traj->getTrajectoryPoint(goal_index);
+    ElementTrajectory::Data::RowXpr traj_start_point = joint_traj->getTrajectoryPoint(0);
+    ElementTrajectory::Data::RowXpr traj_mid_point = joint_traj->getTrajectoryPoint(mid_index);
+    ElementTrajectory::Data::RowXpr traj_goal_point = joint_traj->getTrajectoryPoint(goal_index);
 
     bool side_stepping = applySideStepping(initial_state, goal_state);
     if (side_stepping)
@@ -664,7 +771,7 @@ bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial
         initial_support_foot = initial_front_foot;
 
     ROS_INFO("initial_support_foot : %s", (initial_support_foot == 1) ? "left" : "right");
-    PhaseManager::getInstance()->support_foot_ = initial_support_foot;
+    planning_context->getPhaseManager()->support_foot_ = initial_support_foot;
     eFOOT_INDEX initial_back_foot = (initial_support_foot == LEFT_FOOT) ? RIGHT_FOOT : LEFT_FOOT;
     std::map<eFOOT_INDEX, std::string> group_name_map;
     group_name_map[LEFT_FOOT] = "left_leg";
@@ -728,7 +835,7 @@ bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial
                 root_translation(1) = std::sin(move_orientation) * mocap_trajectory(i, 0) + std::cos(move_orientation) * mocap_trajectory(i, 1);
                 root_translation(2) = mocap_trajectory(i, 2);
 
-                Eigen::MatrixXd::RowXpr traj_point = joint_traj->getTrajectoryPoint(i);
+                ElementTrajectory::Data::RowXpr traj_point = joint_traj->getTrajectoryPoint(i);
 
                 if (i <= 20)
                 {
@@ -871,7 +978,7 @@ bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial
                      right_foot_pose.translation()(0), right_foot_pose.translation()(1), right_foot_pose.translation()(2),
                      root_pose.translation()(0), root_pose.translation()(1), root_pose.translation()(2));
 
-        Eigen::MatrixXd::RowXpr traj_point = joint_traj->getTrajectoryPoint(i);
+        ElementTrajectory::Data::RowXpr traj_point = joint_traj->getTrajectoryPoint(i);
         for (int k = 0; k < robot_state.getVariableCount(); ++k)
             traj_point(k) = robot_state.getVariablePosition(k);
 
@@ -886,9 +993,9 @@ bool ItompPlannerNode::adjustStartGoalPositions(robot_state::RobotState& initial
         itomp_trajectory_->interpolate(i - 5, i, ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
     }
 
-    PhaseManager::getInstance()->initial_goal_pos(0) = goal_state.getVariablePosition(0);
-    PhaseManager::getInstance()->initial_goal_pos(1) = goal_state.getVariablePosition(1);
-    PhaseManager::getInstance()->initial_goal_pos(2) = goal_state.getVariablePosition(5);
+    planning_context->getPhaseManager()->initial_goal_pos(0) = goal_state.getVariablePosition(0);
+    planning_context->getPhaseManager()->initial_goal_pos(1) = goal_state.getVariablePosition(1);
+    planning_context->getPhaseManager()->initial_goal_pos(2) = goal_state.getVariablePosition(5);
 
     return true;
 }
@@ -1,5 +1,6 @@
 #include <itomp_cio_planner/planner/planning_info_manager.h>
 #include <ros/ros.h>
+#include <limits>
 
 namespace itomp_cio_planner
 {
@@ -15,6 +16,34 @@ void PlanningInfoManager::write(int trials, int component, const PlanningInfo& i
 	planning_info_[trials][component] = info;
 }
 
+int PlanningInfoManager::getBestTrial() const
+{
+	int best_trial = 0;
+	bool best_success = false;
+	double best_cost = std::numeric_limits<double>::max();
+
+	for (int i = 0; i < planning_info_.size(); ++i)
+	{
+		bool success = true;
+		double cost = 0.0;
+		for (int j = 0; j < planning_info_[i].size(); ++j)
+		{
+			if (planning_info_[i][j].success == 0)
+				success = false;
+			cost += planning_info_[i][j].cost;
+		}
+
+		if ((success && !best_success) || (success == best_success && cost < best_cost))
+		{
+			best_trial = i;
+			best_success = success;
+			best_cost = cost;
+		}
+	}
+
+	return best_trial;
+}
+
 void PlanningInfoManager::printSummary() const
 {
 	int num_plannings = planning_info_.size();
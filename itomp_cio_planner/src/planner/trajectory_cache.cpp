@@ -0,0 +1,164 @@
+#include <itomp_cio_planner/planner/trajectory_cache.h>
+#include <itomp_cio_planner/util/planning_parameters.h>
+#include <ros/ros.h>
+
+namespace itomp_cio_planner
+{
+
+TrajectoryCache::TrajectoryCache()
+{
+
+}
+
+TrajectoryCache::~TrajectoryCache()
+{
+
+}
+
+void TrajectoryCache::insert(const ItompTrajectory& trajectory, unsigned int capacity)
+{
+    Entry entry;
+    computeKey(trajectory, entry.key_);
+    entry.trajectory_.reset(trajectory.clone());
+
+    boost::mutex::scoped_lock lock(entries_mutex_);
+    entries_.push_front(entry);
+    while (entries_.size() > capacity)
+        entries_.pop_back();
+}
+
+bool TrajectoryCache::seed(ItompTrajectory& trajectory, double max_distance)
+{
+    Eigen::VectorXd key;
+    computeKey(trajectory, key);
+
+    // the cached trajectories are not modified, they can be used after the lookup
+    ItompTrajectoryConstPtr source;
+    double distance = max_distance;
+    {
+        boost::mutex::scoped_lock lock(entries_mutex_);
+        std::list<Entry>::iterator closest = entries_.end();
+        for (std::list<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->key_.size() != key.size())
+                continue;
+            double d = (it->key_ - key).norm();
+            if (d <= distance)
+            {
+                distance = d;
+                closest = it;
+            }
+        }
+        if (closest != entries_.end())
+        {
+            source = closest->trajectory_;
+            entries_.splice(entries_.begin(), entries_, closest);
+        }
+    }
+
+    if (!source)
+        return false;
+
+    if (PlanningParameters::getInstance()->getPrintPlanningInfo())
+        ROS_INFO("Warm start from a cached trajectory (distance : %f)", distance);
+
+    warpTrajectory(*source, trajectory);
+
+    return true;
+}
+
+void TrajectoryCache::clear()
+{
+    boost::mutex::scoped_lock lock(entries_mutex_);
+    entries_.clear();
+}
+
+void TrajectoryCache::computeKey(const ItompTrajectory& trajectory, Eigen::VectorXd& key) const
+{
+    const ElementTrajectoryConstPtr joint_trajectory = trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+    int num_joints = joint_trajectory->getNumElements();
+    ElementTrajectory::Data::ConstRowXpr start = joint_trajectory->getTrajectoryPoint(0);
+    ElementTrajectory::Data::ConstRowXpr goal = joint_trajectory->getTrajectoryPoint(trajectory.getNumPoints() - 1);
+
+    // start state and the displacement to the goal. the root position does not matter
+    key.resize(2 * num_joints);
+    key.head(num_joints) = start.transpose();
+    key.tail(num_joints) = (goal - start).transpose();
+    if (PlanningParameters::getInstance()->getHasRoot6d())
+        key.head(3).setZero();
+}
+
+void TrajectoryCache::warpTrajectory(const ItompTrajectory& source, ItompTrajectory& trajectory) const
+{
+    int num_points = trajectory.getNumPoints();
+    int num_source_points = source.getNumPoints();
+
+    double duration = trajectory.getDiscretization() * (num_points - 1);
+    double source_duration = source.getDiscretization() * (num_source_points - 1);
+    double time_scale = source_duration / duration;
+
+    ElementTrajectoryPtr& joint_trajectory = trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
+    const ElementTrajectory::Data& joint_positions = joint_trajectory->getData();
+    Eigen::RowVectorXd start_positions = joint_positions.row(0);
+    Eigen::RowVectorXd goal_positions = joint_positions.row(num_points - 1);
+    Eigen::RowVectorXd start_velocities = trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
+                                          ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0);
+    Eigen::RowVectorXd start_accelerations = trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
+            ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0);
+
+    // resample at the same normalized times. derivatives are scaled for the new duration
+    for (int c = 0; c < ItompTrajectory::COMPONENT_TYPE_NUM; ++c)
+    {
+        double scale = (c == ItompTrajectory::COMPONENT_TYPE_VELOCITY) ? time_scale :
+                       (c == ItompTrajectory::COMPONENT_TYPE_ACCELERATION) ? time_scale * time_scale : 1.0;
+
+        for (int s = 0; s < ItompTrajectory::SUB_COMPONENT_TYPE_NUM; ++s)
+        {
+            const ElementTrajectory::Data& source_data = source.getElementTrajectory(c, s)->getData();
+            ElementTrajectory::Data& data = trajectory.getElementTrajectory(c, s)->getData();
+            if (source_data.cols() != data.cols())
+                continue;
+
+            for (int i = 0; i < num_points; ++i)
+            {
+                double u = (num_points > 1) ? (double)i * (num_source_points - 1) / (num_points - 1) : 0.0;
+                int i0 = std::min((int)u, num_source_points - 1);
+                int i1 = std::min(i0 + 1, num_source_points - 1);
+                double w = u - i0;
+                data.row(i) = scale * ((1.0 - w) * source_data.row(i0) + w * source_data.row(i1));
+            }
+        }
+    }
+
+    // offset the joint positions to the start and goal of the request
+    Eigen::RowVectorXd start_offset = start_positions - joint_positions.row(0);
+    Eigen::RowVectorXd goal_offset = goal_positions - joint_positions.row(num_points - 1);
+    for (int i = 0; i < num_points; ++i)
+    {
+        double w = (num_points > 1) ? (double)i / (num_points - 1) : 0.0;
+        joint_trajectory->getTrajectoryPoint(i) += (1.0 - w) * start_offset + w * goal_offset;
+    }
+    trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_VELOCITY,
+                                    ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0) = start_velocities;
+    trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_ACCELERATION,
+                                    ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0) = start_accelerations;
+
+    // contact positions (7 variables per contact : variable, position, orientation) follow the root
+    if (PlanningParameters::getInstance()->getHasRoot6d())
+    {
+        ElementTrajectory::Data& contact_positions = trajectory.getElementTrajectory(ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                             ItompTrajectory::SUB_COMPONENT_TYPE_CONTACT_POSITION)->getData();
+        int num_contacts = contact_positions.cols() / 7;
+        for (int i = 0; i < num_points; ++i)
+        {
+            double w = (num_points > 1) ? (double)i / (num_points - 1) : 0.0;
+            Eigen::RowVector3d root_offset = (1.0 - w) * start_offset.head(3) + w * goal_offset.head(3);
+            for (int k = 0; k < num_contacts; ++k)
+                contact_positions.block(i, k * 7 + 1, 1, 3) += root_offset;
+        }
+    }
+}
+
+}
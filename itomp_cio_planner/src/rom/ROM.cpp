@@ -1,6 +1,9 @@
 #include <itomp_cio_planner/rom/ROM.h>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <boost/thread/mutex.hpp>
 
 namespace
 {
@@ -62,6 +65,36 @@ Eigen::VectorXd NormalizedResidualRadiusB(const Eigen::MatrixXd& A, const Eigen:
 	}
 	return res;
 }
+
+// same matrix as Eigen::AngleAxisd(angle, unit vector of axis)
+Eigen::Matrix3d ElementaryRotation(const int axis, const double angle)
+{
+	const double c = std::cos(angle);
+	const double s = std::sin(angle);
+	Eigen::Matrix3d res;
+	switch (axis)
+	{
+	case 0:
+		res << 1, 0, 0,
+			   0, c, -s,
+			   0, s, c;
+		break;
+	case 1:
+		res << c, 0, s,
+			   0, 1, 0,
+			   -s, 0, c;
+		break;
+	default:
+		res << c, -s, 0,
+			   s, c, 0,
+			   0, 0, 1;
+		break;
+	}
+	return res;
+}
+
+std::map<std::string, rom::ROM> romCache;
+boost::mutex romCacheMutex;
 }
 
 rom::ROM::ROM(const Eigen::MatrixXd& A, const Eigen::VectorXd& b, const double maxRadius, const double minx, const double miny, const double minz, const double maxx, const double maxy, const double maxz, const int axis1 ,const int axis2, const int axis3)
@@ -79,6 +112,9 @@ rom::ROM::ROM(const Eigen::MatrixXd& A, const Eigen::VectorXd& b, const double m
 	, axis1_(axis1)
 	, axis2_(axis2)
 	, axis3_(axis3)
+	, n1_(ANorm_.col(0))
+	, n2_(ANorm_.col(1))
+	, n3_(ANorm_.col(2))
 {
 	vAxis1_ = Eigen::Vector3d((axis1_ == 0) ? 1. : 0.,
 							  (axis1_ == 1) ? 1. : 0.,
@@ -111,6 +147,9 @@ rom::ROM::ROM(const ROM& parent)
 	, vAxis1_(parent.vAxis1_)
 	, vAxis2_(parent.vAxis2_)
 	, vAxis3_(parent.vAxis3_)
+	, n1_(parent.n1_)
+	, n2_(parent.n2_)
+	, n3_(parent.n3_)
 {
 	// NOTHING
 }
@@ -123,11 +162,33 @@ rom::ROM::~ROM()
 
 double rom::ROM::ResidualRadius(const double x, const double y, const double z) const
 {
-	Eigen::Vector3d var = (Eigen::AngleAxisd(x, vAxis1_)
-						   * Eigen::AngleAxisd(y, vAxis2_)
-						   *  Eigen::AngleAxisd(z, vAxis3_)).matrix().eulerAngles(axis1_,axis2_,axis3_);
-	double res = (bNorm_ - ANorm_ * var).minCoeff();
-	return res < 0 ? -10 * res : res;
+	double res;
+	ResidualRadius(&x, &y, &z, 1, &res);
+	return res;
+}
+
+void rom::ROM::ResidualRadius(const double* x, const double* y, const double* z, const int num_points, double* residuals) const
+{
+	// euler angles of all the configurations, one array per angle
+	Eigen::ArrayXd e1(num_points), e2(num_points), e3(num_points);
+	for(int p=0; p<num_points; ++p)
+	{
+		Eigen::Vector3d var = (ElementaryRotation(axis1_, x[p])
+							   * ElementaryRotation(axis2_, y[p])
+							   * ElementaryRotation(axis3_, z[p])).eulerAngles(axis1_,axis2_,axis3_);
+		e1(p) = var(0);
+		e2(p) = var(1);
+		e3(p) = var(2);
+	}
+
+	// minimum over the faces of the polytope, vectorized over the configurations
+	Eigen::Map<Eigen::ArrayXd> res(residuals, num_points);
+	res.setConstant(std::numeric_limits<double>::max());
+	for(int i=0; i<bNorm_.rows(); ++i)
+	{
+		res = res.min(bNorm_(i) - n1_(i) * e1 - n2_(i) * e2 - n3_(i) * e3);
+	}
+	res = (res < 0).select(-10 * res, res);
 }
 
 double rom::ROM::NormalizedResidualRadius(const double x, const double y, const double z) const
@@ -203,3 +264,13 @@ rom::ROM rom::ROMFromFile(const std::string& filepath)
 	Eigen::VectorXd b_ = res.block(0,3,size_,1);
 	return ROM(A_,b_,maxRadius_,minx, miny, minz, maxx, maxy, maxz, axe1, axe2, axe3);
 }
+
+rom::ROM rom::CachedROMFromFile(const std::string& filepath)
+{
+	// the file is loaded under the lock, so that it is read only once even if several threads miss
+	boost::mutex::scoped_lock lock(romCacheMutex);
+	std::map<std::string, ROM>::iterator it = romCache.find(filepath);
+	if(it == romCache.end())
+		it = romCache.insert(std::make_pair(filepath, ROMFromFile(filepath))).first;
+	return it->second;
+}
@@ -0,0 +1,54 @@
+// converts a binary optimization checkpoint (checkpoint_phase_<phase>.bin) to text or csv.
+//
+// usage : itomp_checkpoint_converter [-c] checkpoint.bin [output]
+//   -c     : write csv (section,name,row,column,value) instead of text
+//   output : output file (default : stdout)
+
+#include <itomp_cio_planner/optimization/checkpoint.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace itomp_cio_planner;
+
+int main(int argc, char** argv)
+{
+    bool csv = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-c") == 0)
+            csv = true;
+        else
+            files.push_back(argv[i]);
+    }
+
+    if (files.empty() || files.size() > 2)
+    {
+        std::cerr << "usage : " << argv[0] << " [-c] checkpoint.bin [output]" << std::endl;
+        return 1;
+    }
+
+    Checkpoint checkpoint;
+    if (!checkpoint.read(files[0]))
+        return 1;
+
+    std::ofstream output_file;
+    if (files.size() == 2)
+    {
+        output_file.open(files[1].c_str());
+        if (!output_file.is_open())
+        {
+            std::cerr << "Could not open " << files[1] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out_stream = output_file.is_open() ? output_file : std::cout;
+
+    if (csv)
+        checkpoint.printCSV(out_stream);
+    else
+        checkpoint.printText(out_stream);
+
+    return 0;
+}
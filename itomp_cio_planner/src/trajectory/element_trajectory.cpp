@@ -34,8 +34,7 @@ void ElementTrajectory::allocate()
 {
     ROS_ASSERT(num_points_ != 0 && num_elements_ != 0);
 
-    trajectory_data_ = Eigen::MatrixXd(num_points_,
-                                       num_elements_);
+    trajectory_data_ = Data(num_points_, num_elements_);
     trajectory_data_.setZero(num_points_, num_elements_);
 }
 
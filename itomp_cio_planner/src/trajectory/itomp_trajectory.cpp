@@ -29,6 +29,8 @@ ItompTrajectory::ItompTrajectory(const std::string& name, unsigned int num_point
     {
         backup_trajectory_[i] = Eigen::MatrixXd(num_points_, 1);
     }
+
+    computeHermiteBasis();
 }
 
 ItompTrajectory::ItompTrajectory(const ItompTrajectory& trajectory)
@@ -38,7 +40,9 @@ ItompTrajectory::ItompTrajectory(const ItompTrajectory& trajectory)
       duration_(trajectory.duration_),
       discretization_(trajectory.discretization_),
       parameter_to_index_map_(trajectory.parameter_to_index_map_),
-      full_to_parameter_joint_index_map_(trajectory.full_to_parameter_joint_index_map_)
+      full_to_parameter_joint_index_map_(trajectory.full_to_parameter_joint_index_map_),
+      point_parameter_offsets_(trajectory.point_parameter_offsets_),
+      point_parameter_indices_(trajectory.point_parameter_indices_)
 {
     for (int i = 0; i < COMPONENT_TYPE_NUM; ++i)
     {
@@ -52,6 +56,7 @@ ItompTrajectory::ItompTrajectory(const ItompTrajectory& trajectory)
     for (int i = 0; i < COMPONENT_TYPE_NUM; ++i)
     {
         backup_trajectory_[i] = trajectory.backup_trajectory_[i];
+        hermite_basis_[i] = trajectory.hermite_basis_[i];
     }
 }
 
@@ -71,7 +76,7 @@ void ItompTrajectory::setStartState(const sensor_msgs::JointState &joint_state,
     if (PlanningParameters::getInstance()->getPrintPlanningInfo())
         ROS_INFO("Set the trajectory start state");
 
-    Eigen::MatrixXd::RowXpr traj_start_point[] =
+    ElementTrajectory::Data::RowXpr traj_start_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0),
@@ -121,8 +126,8 @@ void ItompTrajectory::setGoalState(const sensor_msgs::JointState& joint_goal_sta
 
     // set trajectory goal point
     unsigned int goal_index = getNumPoints() - 1;
-    Eigen::MatrixXd::RowXpr traj_start_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0);
-    Eigen::MatrixXd::RowXpr traj_goal_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(goal_index);
+    ElementTrajectory::Data::RowXpr traj_start_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0);
+    ElementTrajectory::Data::RowXpr traj_goal_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(goal_index);
 
     std::vector<unsigned int> group_rbdl_indices;
     for (unsigned int i = 0; i < planning_group->num_joints_; ++i)
@@ -162,14 +167,14 @@ void ItompTrajectory::interpolateInputJointTrajectory(const std::vector<unsigned
         const ItompPlanningGroupConstPtr& planning_group,
         const moveit_msgs::TrajectoryConstraints& trajectory_constraints)
 {
-    Eigen::MatrixXd::RowXpr traj_start_point[] =
+    ElementTrajectory::Data::RowXpr traj_start_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0),
         getElementTrajectory(COMPONENT_TYPE_ACCELERATION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(0)
     };
     unsigned int goal_index = getNumPoints() - 1;
-    Eigen::MatrixXd::RowXpr traj_goal_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(goal_index);
+    ElementTrajectory::Data::RowXpr traj_goal_point = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(goal_index);
 
     int num_points = getNumPoints();
     int num_input_waypoints = trajectory_constraints.constraints.size();
@@ -208,7 +213,7 @@ void ItompTrajectory::interpolateInputJointTrajectory(const std::vector<unsigned
                     x1, v1, a1);
             for (unsigned int i = 1; i < getNumPoints() - 1; ++i)
             {
-                Eigen::MatrixXd::RowXpr traj_point[] =
+                ElementTrajectory::Data::RowXpr traj_point[] =
                 {
                     getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(i),
                     getElementTrajectory(COMPONENT_TYPE_VELOCITY, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(i),
@@ -242,7 +247,7 @@ void ItompTrajectory::interpolateInputJointTrajectory(const std::vector<unsigned
                         to * discretization_, x1, v1, a1);
                 for (int i = from; i <= to; ++i)
                 {
-                    Eigen::MatrixXd::RowXpr traj_point[] =
+                    ElementTrajectory::Data::RowXpr traj_point[] =
                     {
                         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(i),
                         getElementTrajectory(COMPONENT_TYPE_VELOCITY, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(i),
@@ -260,31 +265,81 @@ void ItompTrajectory::interpolateInputJointTrajectory(const std::vector<unsigned
     }
 }
 
+void ItompTrajectory::computeHermiteBasis()
+{
+    // cubic hermite basis of the points in a keyframe span. row m is the point at cur_keyframe_index + m,
+    // columns are the weights of (cur_pos, cur_vel, next_pos, next_vel)
+    double h = keyframe_interval_ * discretization_;
+    for (int c = 0; c < COMPONENT_TYPE_NUM; ++c)
+        hermite_basis_[c] = Eigen::MatrixXd::Zero(keyframe_interval_ + 1, 4);
+
+    for (unsigned int m = 0; m <= keyframe_interval_; ++m)
+    {
+        double s = (keyframe_interval_ == 0) ? 0.0 : (double)m / keyframe_interval_;
+        double s2 = s * s;
+        double s3 = s2 * s;
+
+        hermite_basis_[COMPONENT_TYPE_POSITION].row(m) << 2 * s3 - 3 * s2 + 1, (s3 - 2 * s2 + s) * h, -2 * s3 + 3 * s2, (s3 - s2) * h;
+        if (h == 0.0)
+            continue;
+        hermite_basis_[COMPONENT_TYPE_VELOCITY].row(m) << (6 * s2 - 6 * s) / h, 3 * s2 - 4 * s + 1, (-6 * s2 + 6 * s) / h, 3 * s2 - 2 * s;
+        hermite_basis_[COMPONENT_TYPE_ACCELERATION].row(m) << (12 * s - 6) / (h * h), (6 * s - 4) / h, (-12 * s + 6) / (h * h), (6 * s - 2) / h;
+    }
+}
+
+void ItompTrajectory::interpolateKeyframeSpan(unsigned int sub_component, unsigned int cur_keyframe_index,
+        const Eigen::MatrixXd& keyframe_values)
+{
+    // no interior points. the unsigned count below would wrap around for an interval of 0
+    if (keyframe_interval_ <= 1)
+        return;
+
+    unsigned int num_interior_points = keyframe_interval_ - 1;
+    for (int c = 0; c < COMPONENT_TYPE_NUM; ++c)
+    {
+        getElementTrajectory(c, sub_component)->getData().block(cur_keyframe_index + 1, 0,
+                num_interior_points, keyframe_values.cols()).noalias() =
+                    hermite_basis_[c].middleRows(1, num_interior_points) * keyframe_values;
+    }
+}
+
 void ItompTrajectory::interpolateKeyframes(const ItompPlanningGroupConstPtr& planning_group)
 {
+    // the joint limits / wrapping are applied to the keyframes for any interval.
+    // interpolateKeyframeSpan skips the interior points when there are none
+
     // cubic interpolation of pos, vel, acc
     // update trajectory between (k, k+1]
     // acc is discontinuous at each keyframe
     for (unsigned int s = 0; s < SUB_COMPONENT_TYPE_NUM; ++s)
     {
-        unsigned int num_sub_component_elements = getElementTrajectory(0, s)->getNumElements();
-        for (unsigned int j = 0; j < num_sub_component_elements; ++j)
+        const ElementTrajectory::Data& positions = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->getData();
+        const ElementTrajectory::Data& velocities = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->getData();
+        unsigned int num_sub_component_elements = positions.cols();
+
+        // rows : cur_pos, cur_vel, next_pos, next_vel of all elements
+        Eigen::MatrixXd keyframe_values(4, num_sub_component_elements);
+        for (unsigned int k = 0; k < num_keyframes_ - 1; ++k)
         {
-            for (unsigned int k = 0; k < num_keyframes_ - 1; ++k)
+            unsigned int cur_keyframe_index = k * keyframe_interval_;
+            unsigned int next_keyframe_index = cur_keyframe_index + keyframe_interval_;
+
+            keyframe_values.row(0) = positions.row(cur_keyframe_index);
+            keyframe_values.row(1) = velocities.row(cur_keyframe_index);
+            keyframe_values.row(2) = positions.row(next_keyframe_index);
+            keyframe_values.row(3) = velocities.row(next_keyframe_index);
+
+            // handle joint limits / wrapping
+            std::vector<unsigned int> changed_elements;
+            if (s == SUB_COMPONENT_TYPE_JOINT)
             {
-                ecl::CubicPolynomial poly;
-                unsigned int cur_keyframe_index = k * keyframe_interval_;
-                unsigned int next_keyframe_index = cur_keyframe_index + keyframe_interval_;
-
-                double cur_pos = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(cur_keyframe_index, j);
-                double cur_vel = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(cur_keyframe_index, j);
-                double next_pos = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(next_keyframe_index, j);
-                double next_vel = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(next_keyframe_index, j);
-
-                // handle joint limits / wrapping
-                bool next_pos_changed = false;
-                if (s == SUB_COMPONENT_TYPE_JOINT && full_to_parameter_joint_index_map_[j] != -1)
+                for (unsigned int j = 0; j < num_sub_component_elements; ++j)
                 {
+                    if (full_to_parameter_joint_index_map_[j] == -1)
+                        continue;
+
+                    double cur_pos = keyframe_values(0, j);
+                    double next_pos = keyframe_values(2, j);
                     double old_next_pos = next_pos;
 
                     const ItompRobotJoint& joint = planning_group->group_joints_[full_to_parameter_joint_index_map_[j]];
@@ -302,24 +357,21 @@ void ItompTrajectory::interpolateKeyframes(const ItompPlanningGroupConstPtr& pla
                     }
 
                     if (next_pos != old_next_pos)
-                        next_pos_changed = true;
+                    {
+                        keyframe_values(2, j) = next_pos;
+                        changed_elements.push_back(j);
+                    }
                 }
+            }
 
-                poly = ecl::CubicPolynomial::DerivativeInterpolation(
-                           (double)cur_keyframe_index * discretization_, cur_pos, cur_vel,
-                           (double)next_keyframe_index * discretization_, next_pos, next_vel);
+            interpolateKeyframeSpan(s, cur_keyframe_index, keyframe_values);
 
-                unsigned int interpolation_end = next_pos_changed ? next_keyframe_index : next_keyframe_index - 1;
-                for (unsigned int i = cur_keyframe_index + 1; i <= interpolation_end; ++i)
-                {
-                    double t = i * discretization_;
-                    getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(i, j) = poly(t);
-                    getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(i, j) = poly.derivative(t);
-                    if (i != next_keyframe_index)
-                        getElementTrajectory(COMPONENT_TYPE_ACCELERATION, s)->at(i, j) = poly.dderivative(t);
-                }
-                if (false)//next_keyframe_index != num_points_ - 1)
-                    getElementTrajectory(COMPONENT_TYPE_ACCELERATION, s)->at(next_keyframe_index, j) = poly.dderivative((double)next_keyframe_index * discretization_);
+            // the changed keyframe positions are also written
+            for (unsigned int c = 0; c < changed_elements.size(); ++c)
+            {
+                unsigned int j = changed_elements[c];
+                getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(next_keyframe_index, j) = keyframe_values(2, j);
+                getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(next_keyframe_index, j) = keyframe_values(3, j);
             }
         }
     }
@@ -335,36 +387,22 @@ void ItompTrajectory::interpolateKeyframes()
     // acc is discontinuous at each keyframe
     for (unsigned int s = 0; s < SUB_COMPONENT_TYPE_NUM; ++s)
     {
-        unsigned int num_sub_component_elements = getElementTrajectory(0, s)->getNumElements();
-        for (unsigned int j = 0; j < num_sub_component_elements; ++j)
-        {
-            for (unsigned int k = 0; k < num_keyframes_ - 1; ++k)
-            {
-                ecl::CubicPolynomial poly;
-                unsigned int cur_keyframe_index = k * keyframe_interval_;
-                unsigned int next_keyframe_index = cur_keyframe_index + keyframe_interval_;
+        const ElementTrajectory::Data& positions = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->getData();
+        const ElementTrajectory::Data& velocities = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->getData();
 
-                double cur_pos = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(cur_keyframe_index, j);
-                double cur_vel = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(cur_keyframe_index, j);
-                double next_pos = getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(next_keyframe_index, j);
-                double next_vel = getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(next_keyframe_index, j);
+        // rows : cur_pos, cur_vel, next_pos, next_vel of all elements
+        Eigen::MatrixXd keyframe_values(4, positions.cols());
+        for (unsigned int k = 0; k < num_keyframes_ - 1; ++k)
+        {
+            unsigned int cur_keyframe_index = k * keyframe_interval_;
+            unsigned int next_keyframe_index = cur_keyframe_index + keyframe_interval_;
 
-                poly = ecl::CubicPolynomial::DerivativeInterpolation(
-                           (double)cur_keyframe_index * discretization_, cur_pos, cur_vel,
-                           (double)next_keyframe_index * discretization_, next_pos, next_vel);
+            keyframe_values.row(0) = positions.row(cur_keyframe_index);
+            keyframe_values.row(1) = velocities.row(cur_keyframe_index);
+            keyframe_values.row(2) = positions.row(next_keyframe_index);
+            keyframe_values.row(3) = velocities.row(next_keyframe_index);
 
-                for (unsigned int i = cur_keyframe_index + 1; i < next_keyframe_index; ++i)
-                {
-                    double t = i * discretization_;
-                    getElementTrajectory(COMPONENT_TYPE_POSITION, s)->at(i, j) = poly(t);
-                    getElementTrajectory(COMPONENT_TYPE_VELOCITY, s)->at(i, j) = poly.derivative(t);
-                    getElementTrajectory(COMPONENT_TYPE_ACCELERATION, s)->at(i, j) = poly.dderivative(t);
-                }
-                if (false)//next_keyframe_index != num_points_ - 1)
-                    getElementTrajectory(COMPONENT_TYPE_ACCELERATION, s)->at(next_keyframe_index, j) = poly.dderivative((double)next_keyframe_index * discretization_);
-                //std::cout << "Acc " << cur_keyframe_index << " : " << poly.dderivative( (double)cur_keyframe_index * discretization_ ) << std::endl;
-                //std::cout << "Acc " << next_keyframe_index << " : " << poly.dderivative( (double)next_keyframe_index * discretization_ ) << std::endl;
-            }
+            interpolateKeyframeSpan(s, cur_keyframe_index, keyframe_values);
         }
     }
 }
@@ -378,52 +416,82 @@ void ItompTrajectory::interpolateTrajectory(unsigned int trajectory_point_begin,
     unsigned int sub_component_index = index.sub_component;
     unsigned int element = index.element;
 
-    // skip the initial position
-    ecl::CubicPolynomial poly;
+    const ElementTrajectory::Data& positions = getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_index)->getData();
+    const ElementTrajectory::Data& velocities = getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_index)->getData();
 
+    // skip the initial position
+    Eigen::Matrix<double, 4, 1> keyframe_values;
     for (unsigned int cur_keyframe_index = trajectory_point_begin,
             next_keyframe_index = cur_keyframe_index + keyframe_interval_;
             next_keyframe_index <= trajectory_point_end;
             cur_keyframe_index += keyframe_interval_, next_keyframe_index += keyframe_interval_)
     {
-        poly = ecl::CubicPolynomial::DerivativeInterpolation(
-                   (double)cur_keyframe_index * discretization_,
-                   getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_index)->at(cur_keyframe_index, element),
-                   getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_index)->at(cur_keyframe_index, element),
-                   (double)next_keyframe_index * discretization_,
-                   getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_index)->at(next_keyframe_index, element),
-                   getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_index)->at(next_keyframe_index, element));
+        keyframe_values << positions(cur_keyframe_index, element), velocities(cur_keyframe_index, element),
+                        positions(next_keyframe_index, element), velocities(next_keyframe_index, element);
 
-        for (unsigned int i = cur_keyframe_index + 1; i < next_keyframe_index; ++i)
+        unsigned int num_interior_points = keyframe_interval_ - 1;
+        for (int c = 0; c < COMPONENT_TYPE_NUM; ++c)
         {
-            double t = i * discretization_;
-            getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_index)->at(i, element) = poly(t);
-            getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_index)->at(i, element) = poly.derivative(t);
-            getElementTrajectory(COMPONENT_TYPE_ACCELERATION, sub_component_index)->at(i, element) = poly.dderivative(t);
+            getElementTrajectory(c, sub_component_index)->getData().block(cur_keyframe_index + 1, element, num_interior_points, 1).noalias() =
+                hermite_basis_[c].middleRows(1, num_interior_points) * keyframe_values;
         }
-        if (false)//next_keyframe_index != num_points_ - 1)
-            getElementTrajectory(COMPONENT_TYPE_ACCELERATION, sub_component_index)->at(next_keyframe_index, element) =
-                poly.dderivative((double)next_keyframe_index * discretization_);
     }
 }
 
-void ItompTrajectory::setParameters(const ParameterVector& parameters, const ItompPlanningGroupConstPtr& planning_group)
+void ItompTrajectory::setParameters(const ParameterVector& parameters, const ItompPlanningGroupConstPtr& planning_group,
+                                    const PhaseManager& phase_manager, std::vector<bool>* changed_points)
 {
     unsigned int num_parameters = getNumParameters();
 
     ROS_ASSERT(num_parameters > 0);
     ROS_ASSERT(num_parameters == parameters.size());
 
-    for (unsigned int i = 0; i < num_parameters; ++i)
+    for (unsigned int point = 0; point < num_points_; ++point)
     {
-        ItompTrajectoryIndex index = parameter_to_index_map_[i];
+        for (unsigned int c = 0; c < COMPONENT_TYPE_NUM; ++c)
+        {
+            for (unsigned int s = 0; s < SUB_COMPONENT_TYPE_NUM; ++s)
+            {
+                ParameterIndexIterator begin = getPointParametersBegin(point, c, s);
+                ParameterIndexIterator end = getPointParametersEnd(point, c, s);
+                if (begin == end)
+                    continue;
 
-        if (PhaseManager::getInstance()->updateParameter(index) == false)
-            continue;
+                ElementTrajectory::Data::RowXpr row = getElementTrajectory(c, s)->getTrajectoryPoint(point);
+                bool changed = false;
+
+                // the parameters of a group are updated or frozen together in a phase
+                unsigned int group_size = phase_manager.getParameterGroupSize(s, end - begin);
+                for (ParameterIndexIterator group_begin = begin; group_begin != end; )
+                {
+                    ParameterIndexIterator group_end = group_begin + std::min(group_size, (unsigned int)(end - group_begin));
+                    bool update = phase_manager.updateParameter(parameter_to_index_map_[*group_begin]);
+                    for (ParameterIndexIterator it = group_begin + 1; it != group_end; ++it)
+                        ROS_ASSERT(phase_manager.updateParameter(parameter_to_index_map_[*it]) == update);
+                    if (update)
+                    {
+                        for (ParameterIndexIterator it = group_begin; it != group_end; ++it)
+                        {
+                            unsigned int element = parameter_to_index_map_[*it].element;
+                            if (row(element) != parameters(*it, 0))
+                            {
+                                row(element) = parameters(*it, 0);
+                                changed = true;
+                            }
+                        }
+                    }
+                    group_begin = group_end;
+                }
 
-        ElementTrajectoryPtr& et = getElementTrajectory(index.component, index.sub_component);
-        Eigen::MatrixXd::RowXpr row = et->getTrajectoryPoint(index.point);
-        row(index.element) = parameters(i, 0);
+                // keyframe interpolation changes the points in (point - keyframe_interval, point + keyframe_interval)
+                if (changed_points != NULL && changed)
+                {
+                    int point_begin = std::max(0, (int)point - (int)keyframe_interval_);
+                    int point_end = std::min(num_points_ - 1, point + keyframe_interval_);
+                    std::fill(changed_points->begin() + point_begin, changed_points->begin() + point_end + 1, true);
+                }
+            }
+        }
     }
     interpolateKeyframes();
 }
@@ -440,12 +508,13 @@ void ItompTrajectory::getParameters(ParameterVector& parameters) const
         ItompTrajectoryIndex index = parameter_to_index_map_[i];
 
         ElementTrajectoryConstPtr et = getElementTrajectory(index.component, index.sub_component);
-        Eigen::MatrixXd::ConstRowXpr row = et->getTrajectoryPoint(index.point);
+        ElementTrajectory::Data::ConstRowXpr row = et->getTrajectoryPoint(index.point);
         parameters(i, 0) = row(index.element);
     }
 }
 
-void ItompTrajectory::directChangeForDerivativeComputation(unsigned int parameter_index, double value,
+void ItompTrajectory::directChangeForDerivativeComputation(const PhaseManager& phase_manager,
+        unsigned int parameter_index, double value,
         unsigned int& trajectory_point_begin, unsigned int& trajectory_point_end,
         bool backup)
 {
@@ -463,7 +532,7 @@ void ItompTrajectory::directChangeForDerivativeComputation(unsigned int paramete
         backupTrajectory(index);
 
     // Do not update joint values of start/goal points
-    if (PhaseManager::getInstance()->updateParameter(index) == false)
+    if (phase_manager.updateParameter(index) == false)
         return;
 
     // set value
@@ -572,13 +641,32 @@ void ItompTrajectory::computeParameterToTrajectoryIndexMap(const ItompRobotModel
             }
         }
     }
+
+    // point -> parameter indices, counting sort of the parameters
+    unsigned int num_groups = num_points_ * COMPONENT_TYPE_NUM * SUB_COMPONENT_TYPE_NUM;
+    point_parameter_offsets_.assign(num_groups + 1, 0);
+    for (unsigned int i = 0; i < parameter_size; ++i)
+    {
+        const ItompTrajectoryIndex& index = parameter_to_index_map_[i];
+        ++point_parameter_offsets_[(index.point * COMPONENT_TYPE_NUM + index.component) * SUB_COMPONENT_TYPE_NUM + index.sub_component + 1];
+    }
+    for (unsigned int i = 0; i < num_groups; ++i)
+        point_parameter_offsets_[i + 1] += point_parameter_offsets_[i];
+
+    std::vector<unsigned int> group_pos(point_parameter_offsets_.begin(), point_parameter_offsets_.end() - 1);
+    point_parameter_indices_.resize(parameter_size);
+    for (unsigned int i = 0; i < parameter_size; ++i)
+    {
+        const ItompTrajectoryIndex& index = parameter_to_index_map_[i];
+        point_parameter_indices_[group_pos[(index.point * COMPONENT_TYPE_NUM + index.component) * SUB_COMPONENT_TYPE_NUM + index.sub_component]++] = i;
+    }
 }
 
 void ItompTrajectory::setContactVariables(int point, const std::vector<ContactVariables>& contact_variables)
 {
-    Eigen::MatrixXd::RowXpr point_contact_positions =
+    ElementTrajectory::Data::RowXpr point_contact_positions =
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_CONTACT_POSITION)->getTrajectoryPoint(point);
-    Eigen::MatrixXd::RowXpr point_contact_forces =
+    ElementTrajectory::Data::RowXpr point_contact_forces =
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_CONTACT_FORCE)->getTrajectoryPoint(point);
 
     int num_contacts = contact_variables.size();
@@ -594,9 +682,9 @@ void ItompTrajectory::getContactVariables(int point, std::vector<ContactVariable
 {
     // footstep
     int contact_point_ref_point = point;// - (point % 20);
-    Eigen::MatrixXd::RowXpr point_contact_positions =
+    ElementTrajectory::Data::RowXpr point_contact_positions =
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_CONTACT_POSITION)->getTrajectoryPoint(contact_point_ref_point);
-    Eigen::MatrixXd::RowXpr point_contact_forces =
+    ElementTrajectory::Data::RowXpr point_contact_forces =
         getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_CONTACT_FORCE)->getTrajectoryPoint(point);
 
     int num_contacts = contact_variables.size();
@@ -619,14 +707,14 @@ void ItompTrajectory::interpolate(int point_start, int point_end, SUB_COMPONENT_
         return;
     }
 
-    Eigen::MatrixXd::RowXpr traj_start_point[] =
+    ElementTrajectory::Data::RowXpr traj_start_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_type)->getTrajectoryPoint(point_start),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_type)->getTrajectoryPoint(point_start),
         getElementTrajectory(COMPONENT_TYPE_ACCELERATION, sub_component_type)->getTrajectoryPoint(point_start)
     };
 
-    Eigen::MatrixXd::RowXpr traj_goal_point[] =
+    ElementTrajectory::Data::RowXpr traj_goal_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_type)->getTrajectoryPoint(point_end),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_type)->getTrajectoryPoint(point_end),
@@ -652,7 +740,7 @@ void ItompTrajectory::interpolate(int point_start, int point_end, SUB_COMPONENT_
         poly = ecl::QuinticPolynomial::Interpolation(0, x0, v0, a0, duration, x1, v1, a1);
         for (unsigned int i = point_start + 1; i < point_end; ++i)
         {
-            Eigen::MatrixXd::RowXpr traj_point[] =
+            ElementTrajectory::Data::RowXpr traj_point[] =
             {
                 getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_type)->getTrajectoryPoint(i),
                 getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_type)->getTrajectoryPoint(i),
@@ -668,14 +756,14 @@ void ItompTrajectory::interpolate(int point_start, int point_end, SUB_COMPONENT_
 void ItompTrajectory::copy(int point_src, int point_dest, SUB_COMPONENT_TYPE sub_component_type,
                            const std::vector<unsigned int>* element_indices)
 {
-    Eigen::MatrixXd::RowXpr copy_src_point[] =
+    ElementTrajectory::Data::RowXpr copy_src_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_type)->getTrajectoryPoint(point_src),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_type)->getTrajectoryPoint(point_src),
         getElementTrajectory(COMPONENT_TYPE_ACCELERATION, sub_component_type)->getTrajectoryPoint(point_src)
     };
 
-    Eigen::MatrixXd::RowXpr copy_dest_point[] =
+    ElementTrajectory::Data::RowXpr copy_dest_point[] =
     {
         getElementTrajectory(COMPONENT_TYPE_POSITION, sub_component_type)->getTrajectoryPoint(point_dest),
         getElementTrajectory(COMPONENT_TYPE_VELOCITY, sub_component_type)->getTrajectoryPoint(point_dest),
@@ -766,27 +854,20 @@ bool ItompTrajectory::avoidNeighbors(const std::vector<moveit_msgs::Constraints>
 
 bool ItompTrajectory::setJointPositions(Eigen::VectorXd& trajectory_data, const ParameterVector& parameters, int point) const
 {
-    bool updated = false;
     trajectory_data = getElementTrajectory(COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
-    for (unsigned int i = 0; i < parameters.size(); ++i)
-    {
-        const ItompTrajectoryIndex& index = getTrajectoryIndex(i);
-        if (index.sub_component == SUB_COMPONENT_TYPE_JOINT && index.component == COMPONENT_TYPE_POSITION && index.point == point)
-        {
-            trajectory_data(index.element) = parameters(i, 0);
-            updated = true;
-        }
-    }
-    return updated;
+
+    ParameterIndexIterator begin = getPointParametersBegin(point, COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT);
+    ParameterIndexIterator end = getPointParametersEnd(point, COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT);
+    for (ParameterIndexIterator it = begin; it != end; ++it)
+        trajectory_data(parameter_to_index_map_[*it].element) = parameters(*it, 0);
+
+    return begin != end;
 }
 void ItompTrajectory::getJointPositions(ParameterVector& parameters, const Eigen::VectorXd& trajectory_data, int point) const
 {
-    for (unsigned int i = 0; i < parameters.size(); ++i)
-    {
-        const ItompTrajectoryIndex& index = getTrajectoryIndex(i);
-        if (index.sub_component == SUB_COMPONENT_TYPE_JOINT && index.component == COMPONENT_TYPE_POSITION && index.point == point)
-            parameters(i, 0) = trajectory_data(index.element);
-    }
+    ParameterIndexIterator end = getPointParametersEnd(point, COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT);
+    for (ParameterIndexIterator it = getPointParametersBegin(point, COMPONENT_TYPE_POSITION, SUB_COMPONENT_TYPE_JOINT); it != end; ++it)
+        parameters(*it, 0) = trajectory_data(parameter_to_index_map_[*it].element);
 }
 
 }
@@ -3,8 +3,10 @@
 #include <itomp_cio_planner/model/rbdl_model_util.h>
 #include "dlib/optimization.h"
 #include <itomp_cio_planner/optimization/phase_manager.h>
+#include <omp.h>
 
-itomp_cio_planner::NewEvalManager* Jacobian::evaluation_manager_ = NULL;
+__thread itomp_cio_planner::NewEvalManager* Jacobian::evaluation_manager_ = NULL;
+__thread NullSpaceProjector* Jacobian::null_space_projector_ = NULL;
 
 Jacobian::Jacobian()
 {
@@ -182,74 +184,131 @@ void Jacobian::ComputeSVD()
 	}
 }
 
-void Jacobian::GetProjection(int point, const Eigen::VectorXd& q, Eigen::VectorXd& a)
+void Jacobian::projectToNullSpace(const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s)
+{
+    null_space_projector_->project(evaluation_manager_, x, s);
+}
+
+NullSpaceProjector::NullSpaceProjector()
+    : active_parameters_(NULL), full_parameters_(NULL)
+{
+}
+
+void NullSpaceProjector::initialize(const itomp_cio_planner::NewEvalManager* evaluation_manager, int num_threads)
+{
+    const RigidBodyDynamics::Model& model = evaluation_manager->getRBDLModel(0);
+
+    workspaces_.resize(num_threads);
+    for (int i = 0; i < num_threads; ++i)
+    {
+        Workspace& workspace = workspaces_[i];
+        workspace.model = model;
+        workspace.q.resize(model.q_size);
+        workspace.a.resize(model.q_size);
+        workspace.G.resize(6, model.qdot_size);
+    }
+}
+
+void NullSpaceProjector::setActiveParameters(const std::vector<long>* active_parameters,
+        const dlib::matrix<double, 0, 1>* full_parameters)
+{
+    active_parameters_ = active_parameters;
+    full_parameters_ = full_parameters;
+}
+
+void NullSpaceProjector::project(const itomp_cio_planner::NewEvalManager* evaluation_manager,
+                                 const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s)
+{
+    if (active_parameters_ == NULL)
+    {
+        projectFull(evaluation_manager, x, s);
+        return;
+    }
+
+    // scatter to the full parameter vector, the frozen parameters of s are zero
+    const std::vector<long>& active_parameters = *active_parameters_;
+    full_x_ = *full_parameters_;
+    full_s_ = dlib::zeros_matrix<double>(full_x_.size(), 1);
+    for (int i = 0; i < active_parameters.size(); ++i)
+    {
+        full_x_(active_parameters[i]) = x(i);
+        full_s_(active_parameters[i]) = s(i);
+    }
+
+    projectFull(evaluation_manager, full_x_, full_s_);
+
+    for (int i = 0; i < active_parameters.size(); ++i)
+        s(i) = full_s_(active_parameters[i]);
+}
+
+void NullSpaceProjector::projectFull(const itomp_cio_planner::NewEvalManager* evaluation_manager,
+                                     const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s)
 {
-	Jacobian j;
+    const itomp_cio_planner::ItompTrajectoryConstPtr& trajectory = evaluation_manager->getTrajectory();
+    const itomp_cio_planner::ItompPlanningGroupConstPtr& planning_group = evaluation_manager->getPlanningGroup();
+    unsigned int phase = evaluation_manager->getPhaseManager()->getPhase();
 
-    RigidBodyDynamics::Model model = evaluation_manager_->getRBDLModel(point);
-    std::vector<unsigned int> body_ids;
-    for (int i = 0; i < evaluation_manager_->getPlanningGroup()->getNumContacts(); ++i)
+    body_ids_.clear();
+    for (int i = 0; i < planning_group->getNumContacts(); ++i)
     {
-        if (itomp_cio_planner::PhaseManager::getInstance()->getPhase() > 2)
+        if (phase > 2)
             continue;
 
-        if (itomp_cio_planner::PhaseManager::getInstance()->getPhase() > 0)
+        if (phase > 0)
         {
-            if (!evaluation_manager_->getPlanningGroup()->is_fixed_[i])
+            if (!planning_group->is_fixed_[i])
                 continue;
         }
 
-        int rbdl_body_id = evaluation_manager_->getPlanningGroup()->contact_points_[i].getRBDLBodyId();
-        body_ids.push_back(rbdl_body_id);
+        body_ids_.push_back(planning_group->contact_points_[i].getRBDLBodyId());
     }
 
-    if (body_ids.size() == 0)
+    if (body_ids_.size() == 0)
         return;
-    Eigen::MatrixXd jacobianMerged = Eigen::MatrixXd::Zero(6 * body_ids.size(), model.qdot_size);
-    UpdateKinematicsCustom (model, &q, NULL, NULL);
 
-    for (unsigned int k = 0; k < body_ids.size(); k++)
+    for (int i = 0; i < workspaces_.size(); ++i)
     {
-        Eigen::MatrixXd G (Eigen::MatrixXd::Zero(6, model.qdot_size));
-        itomp_cio_planner::CalcPointJacobian6D(model, q, body_ids[k], Eigen::Vector3d::Zero(), G, false);
-
-        for (unsigned int j = 0; j < model.qdot_size; j++)
+        Workspace& workspace = workspaces_[i];
+        if (workspace.jacobian_transpose.cols() != 6 * body_ids_.size())
         {
-            for (unsigned int i = 0; i < 6; i++)
-            {
-                unsigned int row = k * 6 + i;
-                jacobianMerged(row, j) = G(i,j);
-            }
+            workspace.jacobian_transpose.resize(workspace.model.qdot_size, 6 * body_ids_.size());
+            workspace.qr = Eigen::ColPivHouseholderQR<Eigen::MatrixXd>(workspace.jacobian_transpose.rows(),
+                           workspace.jacobian_transpose.cols());
         }
     }
 
-    j.SetJacobian(jacobianMerged);
-    a = j.GetNullspace() * a;
+    // only the start and goal points are projected in phase 0
+    int num_points = trajectory->getNumPoints();
+    int num_projection_points = (phase == 0) ? 2 : num_points;
+
+    #pragma omp parallel for schedule(dynamic) num_threads(workspaces_.size())
+    for (int i = 0; i < num_projection_points; ++i)
+    {
+        int point = (phase == 0 && i == 1) ? num_points - 1 : i;
+        Workspace& workspace = workspaces_[omp_get_thread_num()];
+
+        if (!trajectory->setJointPositions(workspace.q, x, point))
+            continue;
+        trajectory->setJointPositions(workspace.a, s, point);
+        projectPoint(workspace);
+        trajectory->getJointPositions(s, workspace.a, point);
+    }
 }
 
-void Jacobian::projectToNullSpace(const dlib::matrix<double, 0, 1>& x, dlib::matrix<double, 0, 1>& s)
+void NullSpaceProjector::projectPoint(Workspace& workspace) const
 {
-    itomp_cio_planner::ItompTrajectoryPtr trajectory = evaluation_manager_->getTrajectoryNonConst();
+    RigidBodyDynamics::UpdateKinematicsCustom(workspace.model, &workspace.q, NULL, NULL);
 
-    Eigen::VectorXd q;
-    Eigen::VectorXd a;
-
-    std::vector<unsigned int> projection_indices;
-    projection_indices.push_back(0);
-    if (itomp_cio_planner::PhaseManager::getInstance()->getPhase() != 0)
+    for (unsigned int k = 0; k < body_ids_.size(); ++k)
     {
-        for (unsigned int i = 1; i < trajectory->getNumPoints() - 1; ++i)
-            projection_indices.push_back(i);
+        workspace.G.setZero();
+        itomp_cio_planner::CalcPointJacobian6D(workspace.model, workspace.q, body_ids_[k], Eigen::Vector3d::Zero(), workspace.G, false);
+        workspace.jacobian_transpose.middleCols(6 * k, 6) = workspace.G.transpose();
     }
-    projection_indices.push_back(trajectory->getNumPoints() - 1);
 
-    for (unsigned int i = 0; i < projection_indices.size(); ++i)
-    {
-        unsigned int index = projection_indices[i];
-        if (!trajectory->setJointPositions(q, x, index))
-            continue;
-        trajectory->setJointPositions(a, s, index);
-        GetProjection(index, q, a);
-        trajectory->getJointPositions(s, a, index);
-    }
+    // the first rank columns of Q span the row space of the jacobian. a = Q * [0; (Q^T * a).tail]
+    workspace.qr.compute(workspace.jacobian_transpose);
+    workspace.qr.householderQ().adjoint().applyThisOnTheLeft(workspace.a, workspace.householder_workspace);
+    workspace.a.head(workspace.qr.rank()).setZero();
+    workspace.qr.householderQ().applyThisOnTheLeft(workspace.a, workspace.householder_workspace);
 }
@@ -47,9 +47,9 @@ sensor_msgs::JointState getGoalStateFromGoalConstraints(
 
 void jointStateToArray(const ItompRobotModelConstPtr& itomp_robot_model,
 					   const sensor_msgs::JointState &joint_state,
-					   Eigen::MatrixXd::RowXpr joint_pos_array,
-					   Eigen::MatrixXd::RowXpr joint_vel_array,
-					   Eigen::MatrixXd::RowXpr joint_acc_array)
+					   ElementTrajectory::Data::RowXpr joint_pos_array,
+					   ElementTrajectory::Data::RowXpr joint_vel_array,
+					   ElementTrajectory::Data::RowXpr joint_acc_array)
 {
 	for (unsigned int i = 0; i < joint_state.name.size(); i++)
 	{
@@ -7,10 +7,97 @@
 
 #include <itomp_cio_planner/util/planning_parameters.h>
 #include <ros/ros.h>
+#include <XmlRpcValue.h>
+#include <boost/scoped_ptr.hpp>
 
 namespace itomp_cio_planner
 {
 
+namespace
+{
+
+// reads the parameters from the parameter server, or from a struct with the same keys
+// when the planner runs without a ros master
+class ParameterReader
+{
+public:
+    ParameterReader(const XmlRpc::XmlRpcValue* parameters)
+    {
+        if (parameters == NULL)
+            node_handle_.reset(new ros::NodeHandle("itomp_planner"));
+        else
+            parameters_ = *parameters;
+    }
+
+    bool hasParam(const std::string& key) const
+    {
+        if (node_handle_)
+            return node_handle_->hasParam(key);
+        return parameters_.getType() == XmlRpc::XmlRpcValue::TypeStruct && parameters_.hasMember(key);
+    }
+
+    bool getParam(const std::string& key, XmlRpc::XmlRpcValue& value)
+    {
+        if (node_handle_)
+            return node_handle_->getParam(key, value);
+        if (!hasParam(key))
+            return false;
+        value = parameters_[key];
+        return true;
+    }
+
+    template<typename T>
+    void param(const std::string& key, T& value, const T& default_value)
+    {
+        if (node_handle_)
+        {
+            node_handle_->param(key, value, default_value);
+            return;
+        }
+        XmlRpc::XmlRpcValue xml_value;
+        if (!getParam(key, xml_value) || !convert(xml_value, value))
+            value = default_value;
+    }
+
+private:
+    static bool convert(XmlRpc::XmlRpcValue& xml_value, int& value)
+    {
+        if (xml_value.getType() != XmlRpc::XmlRpcValue::TypeInt)
+            return false;
+        value = static_cast<int>(xml_value);
+        return true;
+    }
+    static bool convert(XmlRpc::XmlRpcValue& xml_value, double& value)
+    {
+        if (xml_value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+            value = static_cast<int>(xml_value);
+        else if (xml_value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+            value = static_cast<double>(xml_value);
+        else
+            return false;
+        return true;
+    }
+    static bool convert(XmlRpc::XmlRpcValue& xml_value, bool& value)
+    {
+        if (xml_value.getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+            return false;
+        value = static_cast<bool>(xml_value);
+        return true;
+    }
+    static bool convert(XmlRpc::XmlRpcValue& xml_value, std::string& value)
+    {
+        if (xml_value.getType() != XmlRpc::XmlRpcValue::TypeString)
+            return false;
+        value = static_cast<std::string&>(xml_value);
+        return true;
+    }
+
+    boost::scoped_ptr<ros::NodeHandle> node_handle_;
+    XmlRpc::XmlRpcValue parameters_;
+};
+
+}
+
 PlanningParameters::PlanningParameters() :
 	num_time_steps_(0), updateIndex(-1)
 {
@@ -21,11 +108,22 @@ PlanningParameters::~PlanningParameters()
 }
 
 void PlanningParameters::initFromNodeHandle()
+{
+    initialize(NULL);
+}
+
+void PlanningParameters::initFromParameters(const XmlRpc::XmlRpcValue& parameters)
+{
+    initialize(&parameters);
+}
+
+void PlanningParameters::initialize(const XmlRpc::XmlRpcValue* parameters)
 {
 	++updateIndex;
 
-	ros::NodeHandle node_handle("itomp_planner");
+	ParameterReader node_handle(parameters);
 	node_handle.param("num_trials", num_trials_, 1);
+	node_handle.param("use_parallel_trials", use_parallel_trials_, false);
 	node_handle.param("planning_time_limit", planning_time_limit_, 1.0);
 	node_handle.param("max_iterations", max_iterations_, 500);
 	node_handle.param("max_iterations_after_collision_free",
@@ -67,6 +165,9 @@ void PlanningParameters::initFromNodeHandle()
 
 	node_handle.param("animate_path", animate_path_, false);
 	node_handle.param("animate_endeffector", animate_endeffector_, true);
+	node_handle.param("visualization_max_rate", visualization_max_rate_, 10.0);
+	node_handle.param("write_checkpoints", write_checkpoints_, true);
+	node_handle.param<std::string>("restore_checkpoint", restore_checkpoint_, "");
 
 	node_handle.param("print_planning_info", print_planning_info_, true);
 
@@ -319,6 +420,36 @@ void PlanningParameters::initFromNodeHandle()
     node_handle.param("contact_z_plane_only", contact_z_plane_only_, false);
 
     node_handle.param("passive_force_ratio", passive_force_ratio_, 1.0);
+
+    std::string derivative_mode;
+    node_handle.param<std::string>("derivative_mode", derivative_mode, "fd");
+    if (derivative_mode == "analytic")
+        derivative_mode_ = DERIVATIVE_MODE_ANALYTIC;
+    else
+    {
+        if (derivative_mode != "fd")
+            ROS_ERROR("Unknown derivative_mode %s. Use fd", derivative_mode.c_str());
+        derivative_mode_ = DERIVATIVE_MODE_FD;
+    }
+    node_handle.param("validate_derivatives", validate_derivatives_, false);
+
+    std::string obstacle_cost_type;
+    node_handle.param<std::string>("obstacle_cost_type", obstacle_cost_type, "fcl");
+    if (obstacle_cost_type == "distance_field")
+        obstacle_cost_type_ = OBSTACLE_COST_TYPE_DISTANCE_FIELD;
+    else
+    {
+        if (obstacle_cost_type != "fcl")
+            ROS_ERROR("Unknown obstacle_cost_type %s. Use fcl", obstacle_cost_type.c_str());
+        obstacle_cost_type_ = OBSTACLE_COST_TYPE_FCL;
+    }
+    node_handle.param("distance_field_resolution", distance_field_resolution_, 0.02);
+    node_handle.param("distance_field_margin", distance_field_margin_, 0.05);
+
+    // warm start from the previously optimized trajectories. disabled if the cache size is 0
+    node_handle.param("warm_start_cache_size", warm_start_cache_size_, 0);
+    node_handle.param("warm_start_max_distance", warm_start_max_distance_, 1.0);
+    node_handle.param("warm_start_phase", warm_start_phase_, 3);
 }
 
 } // namespace
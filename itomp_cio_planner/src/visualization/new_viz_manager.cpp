@@ -13,11 +13,13 @@ namespace itomp_cio_planner
 {
 
 NewVizManager::NewVizManager()
+    : stop_render_thread_(false)
 {
 }
 
 NewVizManager::~NewVizManager()
 {
+    stopRenderThread();
 }
 
 void NewVizManager::initialize(const ItompRobotModelConstPtr& robot_model)
@@ -40,6 +42,96 @@ void NewVizManager::initialize(const ItompRobotModelConstPtr& robot_model)
 		colors_[i].g = ((i / 2) % 2 == 0) ? 0.0 : 1.0;
 		colors_[i].r = ((i / 4) % 2 == 0) ? 0.0 : 1.0;
 	}
+
+#ifndef ITOMP_HEADLESS
+    if (!render_thread_.joinable())
+    {
+        stop_render_thread_ = false;
+        render_thread_ = boost::thread(&NewVizManager::renderThread, this);
+    }
+#endif
+}
+
+bool NewVizManager::acceptRenderRequest(bool force)
+{
+#ifdef ITOMP_HEADLESS
+    return false;
+#else
+    // not initialized when the planner runs without a ros master
+    if (!render_thread_.joinable())
+        return false;
+
+    double max_rate = PlanningParameters::getInstance()->getVisualizationMaxRate();
+    ros::WallTime now = ros::WallTime::now();
+
+    boost::mutex::scoped_lock lock(render_mutex_);
+    if (!force && max_rate > 0.0 && (now - last_render_request_time_).toSec() < 1.0 / max_rate)
+        return false;
+    last_render_request_time_ = now;
+    return true;
+#endif
+}
+
+void NewVizManager::requestRender(const RenderRequestPtr& request)
+{
+    boost::mutex::scoped_lock lock(render_mutex_);
+    pending_render_request_ = request;
+    render_condition_.notify_one();
+}
+
+void NewVizManager::renderThread()
+{
+    while (true)
+    {
+        RenderRequestPtr request;
+        {
+            boost::mutex::scoped_lock lock(render_mutex_);
+            while (!pending_render_request_ && !stop_render_thread_)
+                render_condition_.wait(lock);
+
+            // the last pending request is rendered before the thread stops
+            if (!pending_render_request_)
+                break;
+            request.swap(pending_render_request_);
+        }
+        render(*request);
+    }
+}
+
+void NewVizManager::stopRenderThread()
+{
+    if (!render_thread_.joinable())
+        return;
+
+    {
+        boost::mutex::scoped_lock lock(render_mutex_);
+        stop_render_thread_ = true;
+        render_condition_.notify_one();
+    }
+    render_thread_.join();
+}
+
+void NewVizManager::render(RenderRequest& request)
+{
+#ifndef ITOMP_HEADLESS
+    if (request.animate_path_)
+    {
+        animatePath(request.trajectory_, request.robot_state_, request.is_best_);
+        displayTrajectory(request.trajectory_);
+    }
+
+    if (request.animate_endeffector_)
+    {
+        animateEndeffectors(request.trajectory_, request.models_, request.is_best_);
+        animateContacts(request.trajectory_, request.contact_variables_, request.models_, request.is_best_);
+    }
+
+    if (request.is_best_)
+    {
+        animateInternalForces(request.trajectory_, request.models_, true, true);
+        animateCenterOfMass(request.trajectory_, request.models_);
+    }
+#endif
 }
 
 void NewVizManager::setPlanningGroup(const ItompPlanningGroupConstPtr& planning_group)
@@ -140,13 +232,13 @@ void NewVizManager::animatePath(const ItompTrajectoryConstPtr& trajectory,
     color.a = 1.0;
 	ros::Duration dur(3600.0);
 
+    Eigen::VectorXd point_buffer;
     for (unsigned int point = 0; point < trajectory->getNumPoints(); ++point)
 	{
 		ma.markers.clear();
-        const Eigen::MatrixXd mat = trajectory->getElementTrajectory(
-                                        ItompTrajectory::COMPONENT_TYPE_POSITION,
-                                        ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getTrajectoryPoint(point);
-		robot_state->setVariablePositions(mat.data());
+        robot_state->setVariablePositions(trajectory->getElementTrajectory(
+                                              ItompTrajectory::COMPONENT_TYPE_POSITION,
+                                              ItompTrajectory::SUB_COMPONENT_TYPE_JOINT)->getPointData(point, point_buffer));
         std::string ns = "frame_" + boost::lexical_cast<std::string>(point);
 		robot_state->getRobotMarkers(ma, link_names, color, ns, dur);
         for (int i = 0; i < ma.markers.size(); ++i)
@@ -294,9 +386,9 @@ void NewVizManager::displayTrajectory(const ItompTrajectoryConstPtr& trajectory)
                 ItompTrajectory::COMPONENT_TYPE_VELOCITY, ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
     const ElementTrajectoryConstPtr& joint_acceleration_trajectory = trajectory->getElementTrajectory(
                 ItompTrajectory::COMPONENT_TYPE_ACCELERATION, ItompTrajectory::SUB_COMPONENT_TYPE_JOINT);
-    const Eigen::MatrixXd& joint_data = joint_trajectory->getData();
-    const Eigen::MatrixXd& joint_vel_data = joint_velocity_trajectory->getData();
-    const Eigen::MatrixXd& joint_acc_data = joint_acceleration_trajectory->getData();
+    const ElementTrajectory::Data& joint_data = joint_trajectory->getData();
+    const ElementTrajectory::Data& joint_vel_data = joint_velocity_trajectory->getData();
+    const ElementTrajectory::Data& joint_acc_data = joint_acceleration_trajectory->getData();
 
     unsigned int num_joints = joint_trajectory->getNumElements();
 
@@ -329,6 +421,14 @@ void NewVizManager::displayTrajectory(const ItompTrajectoryConstPtr& trajectory)
 
 void NewVizManager::renderContactSurface()
 {
+#ifdef ITOMP_HEADLESS
+    return;
+#endif
+
+    // not initialized when the planner runs without a ros master
+    if (!robot_model_)
+        return;
+
     string contact_file = PlanningParameters::getInstance()->getContactModel();
     if (contact_file.empty())
         return;
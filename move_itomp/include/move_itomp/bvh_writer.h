@@ -3,13 +3,57 @@
 
 #include <moveit_msgs/DisplayTrajectory.h>
 #include <moveit/robot_model/robot_model.h>
+#include <cstdio>
 
 namespace bvh_writer
 {
 
 void writeWalkingTrajectoryBVHFile(const robot_model::RobotModelPtr robot_model, const moveit_msgs::DisplayTrajectory& display_trajectory, const std::string& filename);
 
+// writes the motion of robot model joints in BVH order. frames can be appended while the trajectories are planned,
+// the frame count is written when the file is closed.
+// optionally writes the same frames to a binary motion file :
+// "ITOMPMOT", uint32 version, uint32 number of channels, uint32 number of frames, double frame time,
+// followed by the frames as doubles
+class BVHWriter
+{
+public:
+    BVHWriter(const robot_model::RobotModelConstPtr& robot_model, const std::vector<std::string>& joint_names);
+    ~BVHWriter();
+
+    bool open(const std::string& filename, const std::string& binary_filename = "");
+    void writeTrajectory(const trajectory_msgs::JointTrajectory& joint_trajectory);
+    void close();
+
+    int getNumFrames() const;
+
+private:
+    BVHWriter(const BVHWriter&);
+    BVHWriter& operator=(const BVHWriter&);
+
+    void writeFrame(const std::vector<double>& positions);
+    void flush();
+
+    // index in the trajectory joint names for each BVH channel, -1 if the joint is not in the trajectory
+    std::vector<int> channel_joint_indices_;
+    std::vector<double> channel_scales_;
+    unsigned int num_trajectory_joints_;
+
+    FILE* file_;
+    FILE* binary_file_;
+    long frame_count_position_;
+    int num_frames_;
+
+    std::vector<char> buffer_;
+    size_t buffer_size_;
+    std::vector<double> frame_;
+};
+
+inline int BVHWriter::getNumFrames() const
+{
+    return num_frames_;
 }
 
-#endif
+}
 
+#endif
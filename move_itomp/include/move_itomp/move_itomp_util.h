@@ -20,6 +20,12 @@ void initializePlanner(boost::scoped_ptr<pluginlib::ClassLoader<planning_interfa
                        ros::NodeHandle& node_handle,
                        robot_model::RobotModelPtr& robot_model);
 
+// creates an additional planner instance with the loader of initializePlanner
+void createPlannerInstance(boost::scoped_ptr<pluginlib::ClassLoader<planning_interface::PlannerManager> >& planner_plugin_loader,
+                           planning_interface::PlannerManagerPtr& planner_instance,
+                           ros::NodeHandle& node_handle,
+                           robot_model::RobotModelPtr& robot_model);
+
 void loadStaticScene(ros::NodeHandle& node_handle,
                      planning_scene::PlanningScenePtr& planning_scene,
                      robot_model::RobotModelPtr& robot_model,
@@ -38,6 +44,15 @@ void doPlan(const std::string& group_name,
             planning_scene::PlanningScenePtr& planning_scene,
             planning_interface::PlannerManagerPtr& planner_instance);
 
+// same as doPlan, but returns false instead of exiting if planning fails
+bool plan(const std::string& group_name,
+          planning_interface::MotionPlanRequest& req,
+          planning_interface::MotionPlanResponse& res,
+          const robot_state::RobotState& start_state,
+          const robot_state::RobotState& goal_state,
+          const planning_scene::PlanningSceneConstPtr& planning_scene,
+          planning_interface::PlannerManagerPtr& planner_instance);
+
 void visualizeResult(planning_interface::MotionPlanResponse& res,
                      ros::NodeHandle& node_handle,
                      int repeat_last,
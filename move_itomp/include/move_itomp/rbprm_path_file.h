@@ -0,0 +1,122 @@
+#ifndef RBPRM_PATH_FILE_H_
+#define RBPRM_PATH_FILE_H_
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace rbprm_reader
+{
+
+// binary path file, converted from the text format by rbprm_path_converter.
+// the root offset of the text file is already applied to the stored waypoints and contacts
+//
+// PathFileHeader
+// joint names : null-terminated strings, padded to 8 bytes
+// frames : num_frames * num_joints doubles, one waypoint per frame
+// contacts : num_frames * num_effectors * 8 doubles, "hasContact X Y Z qx qy qz qw" per effector
+struct PathFileHeader
+{
+    char magic_[8];
+    uint32_t version_;
+    uint32_t num_joints_;
+    uint32_t num_frames_;
+    uint32_t num_effectors_;
+    uint64_t joint_names_offset_;
+    uint64_t frames_offset_;
+    uint64_t contacts_offset_;
+    uint64_t file_size_;
+};
+
+// memory-mapped binary path file. the views are valid until the file is closed
+class PathFile
+{
+public:
+    typedef Eigen::Map<const Eigen::VectorXd> WaypointMap;
+    typedef Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, 8, Eigen::RowMajor> > ContactMap;
+    // one waypoint per column
+    typedef Eigen::Map<const Eigen::MatrixXd> WaypointMatrixMap;
+
+    PathFile();
+    ~PathFile();
+
+    bool open(const std::string& filepath);
+    void close();
+    bool isOpen() const;
+
+    // true if the file starts with the binary path file magic
+    static bool isPathFile(const std::string& filepath);
+
+    const std::vector<std::string>& getHierarchy() const;
+    unsigned int getNumFrames() const;
+    unsigned int getNumJoints() const;
+    unsigned int getNumEffectors() const;
+
+    WaypointMap getWaypoint(unsigned int frame) const;
+    WaypointMatrixMap getWaypoints() const;
+    // num_effectors x 8
+    ContactMap getContacts(unsigned int frame) const;
+
+private:
+    PathFile(const PathFile&);
+    PathFile& operator=(const PathFile&);
+
+    void* data_;
+    size_t size_;
+    const PathFileHeader* header_;
+    const double* frames_;
+    const double* contacts_;
+    std::vector<std::string> hierarchy_;
+};
+
+bool writePathFile(const std::string& filepath,
+                   const std::vector<std::string>& hierarchy,
+                   const std::vector<Eigen::VectorXd>& waypoints,
+                   const std::vector<Eigen::MatrixXd>& contactPoints);
+
+///////////////////////// inline functions follow //////////////////////
+
+inline bool PathFile::isOpen() const
+{
+    return header_ != NULL;
+}
+
+inline const std::vector<std::string>& PathFile::getHierarchy() const
+{
+    return hierarchy_;
+}
+
+inline unsigned int PathFile::getNumFrames() const
+{
+    return header_->num_frames_;
+}
+
+inline unsigned int PathFile::getNumJoints() const
+{
+    return header_->num_joints_;
+}
+
+inline unsigned int PathFile::getNumEffectors() const
+{
+    return header_->num_effectors_;
+}
+
+inline PathFile::WaypointMap PathFile::getWaypoint(unsigned int frame) const
+{
+    return WaypointMap(frames_ + (size_t)frame * header_->num_joints_, header_->num_joints_);
+}
+
+inline PathFile::WaypointMatrixMap PathFile::getWaypoints() const
+{
+    return WaypointMatrixMap(frames_, header_->num_joints_, header_->num_frames_);
+}
+
+inline PathFile::ContactMap PathFile::getContacts(unsigned int frame) const
+{
+    return ContactMap(contacts_ + (size_t)frame * header_->num_effectors_ * 8, header_->num_effectors_, 8);
+}
+
+}
+
+#endif
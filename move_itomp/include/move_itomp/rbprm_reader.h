@@ -10,18 +10,30 @@
 #include <moveit_msgs/DisplayTrajectory.h>
 #include <moveit_msgs/DisplayRobotState.h>
 #include <moveit_msgs/PlanningScene.h>
+#include <move_itomp/rbprm_path_file.h>
 
 namespace rbprm_reader
 {
 
 std::vector<std::string> InitTrajectoryFromFile(std::vector<Eigen::VectorXd>& waypoints, std::vector<Eigen::MatrixXd>& contactPoints, const std::string& filepath);
 
+// waypoints of a path file, one waypoint per column. a binary path file stays mapped in path_file and is not copied,
+// the waypoints of a text file are read into text_waypoints. the map is valid while both are
+PathFile::WaypointMatrixMap InitWaypointsFromFile(PathFile& path_file, Eigen::MatrixXd& text_waypoints,
+                                                  std::vector<std::string>& hierarchy, const std::string& filepath);
+
 void displayInitialWaypoints(robot_state::RobotState& state,
                              ros::NodeHandle& node_handle,
                              robot_model::RobotModelPtr& robot_model,
                              const std::vector<std::string>& hierarchy,
                              const std::vector<Eigen::VectorXd>& waypoints);
 
+void displayInitialWaypoints(robot_state::RobotState& state,
+                             ros::NodeHandle& node_handle,
+                             robot_model::RobotModelPtr& robot_model,
+                             const std::vector<std::string>& hierarchy,
+                             const PathFile::WaypointMatrixMap& waypoints);
+
 moveit_msgs::Constraints setRootJointConstraint(moveit_msgs::Constraints& c,
                                                 const std::vector<std::string>& hierarchy,
                                                 const Eigen::VectorXd& transform);
@@ -38,6 +50,10 @@ void setRobotStateFrom(robot_state::RobotState& state,
                        const std::vector<std::string>& hierarchy,
                        const std::vector<Eigen::VectorXd>& waypoints,
                        int index);
+
+void setRobotStateFrom(robot_state::RobotState& state,
+                       const std::vector<std::string>& hierarchy,
+                       const Eigen::VectorXd& waypoint);
 }
 #endif
 
@@ -0,0 +1,47 @@
+#ifndef SEGMENT_PLANNER_H_
+#define SEGMENT_PLANNER_H_
+
+#include <move_itomp/move_itomp_util.h>
+#include <move_itomp/rbprm_path_file.h>
+
+namespace segment_planner
+{
+
+// planning problem between two consecutive waypoints of a path
+struct Segment
+{
+    planning_interface::MotionPlanRequest req_;
+    planning_interface::MotionPlanResponse res_;
+    robot_state::RobotStatePtr start_state_;
+    robot_state::RobotStatePtr goal_state_;
+};
+
+// creates the segments between the waypoints (columns) first ... last.
+// the waypoint angles are unwrapped along the path, so the segments can be planned independently.
+// the waypoints are not modified, they can be mapped from a path file
+void createSegments(std::vector<Segment>& segments,
+                    const robot_state::RobotState& default_state,
+                    const std::vector<std::string>& hierarchy,
+                    const rbprm_reader::PathFile::WaypointMatrixMap& waypoints,
+                    unsigned int first, unsigned int last);
+
+// plans the segments concurrently. planner_instances[i] is used by the i-th worker thread only,
+// so the number of planner instances is the number of segments planned at once.
+// the warm start cache of the planner is disabled while planning, it would seed the segments in the order they finish
+bool planSegments(std::vector<Segment>& segments,
+                  const std::string& group_name,
+                  const planning_scene::PlanningSceneConstPtr& planning_scene,
+                  std::vector<planning_interface::PlannerManagerPtr>& planner_instances);
+
+// the segments share the boundary waypoints, but their velocities and accelerations differ there.
+// re-fits seam_window waypoints on each side of a boundary with a minimum jerk (quintic) trajectory
+// matching the position, velocity and acceleration of the segments at the ends of the window.
+// the refit ignores the contacts and the dynamics. a seam is kept as planned if the refit waypoints
+// collide or leave the joint limits where the planned ones did not. returns false if a seam is kept
+bool repairSeams(std::vector<Segment>& segments, unsigned int seam_window,
+                 const std::string& group_name,
+                 const planning_scene::PlanningSceneConstPtr& planning_scene);
+
+}
+
+#endif
@@ -3,6 +3,8 @@
 #include <move_itomp/move_itomp_util.h>
 #include <move_itomp/rbprm_reader.h>
 #include <move_itomp/bvh_writer.h>
+#include <move_itomp/segment_planner.h>
+#include <boost/thread.hpp>
 
 const double INV_SQRT_2 = 1.0 / std::sqrt((long double) 2.0);
 
@@ -44,6 +46,7 @@ int main(int argc, char **argv)
 
     boost::scoped_ptr<pluginlib::ClassLoader<planning_interface::PlannerManager> > planner_plugin_loader;
     planning_interface::PlannerManagerPtr planner_instance;
+    std::vector<planning_interface::PlannerManagerPtr> planner_instances;
     initializePlanner(planner_plugin_loader, planner_instance, node_handle, robot_model);
 
 	loadStaticScene(node_handle, planning_scene, robot_model, planning_scene_diff_publisher);
@@ -52,14 +55,10 @@ int main(int argc, char **argv)
 	ros::WallDuration sleep_time(1.0);
 	sleep_time.sleep();
 
-	std::vector<robot_state::RobotState> robot_states;
-
-	robot_states.push_back(planning_scene->getCurrentStateNonConst());
-    robot_states.push_back(robot_states.back());
-
 	// set trajectory constraints
-    std::vector<Eigen::VectorXd> waypoints;
-    std::vector<Eigen::MatrixXd> contactPoints;
+    // a binary path file stays mapped while the segments are created, its waypoints are not copied
+    PathFile path_file;
+    Eigen::MatrixXd text_waypoints;
     std::vector<std::string> hierarchy;
 
     if(initialpath.empty())
@@ -67,55 +66,67 @@ int main(int argc, char **argv)
         ROS_ERROR("Initial path is empty");
     }
 
-    hierarchy = InitTrajectoryFromFile(waypoints, contactPoints, initialpath);
+    PathFile::WaypointMatrixMap waypoints = InitWaypointsFromFile(path_file, text_waypoints, hierarchy, initialpath);
     robot_state::RobotState rs(planning_scene->getCurrentStateNonConst());
     displayInitialWaypoints(rs, node_handle, robot_model, hierarchy, waypoints);
 
-    moveit_msgs::DisplayTrajectory display_trajectory;
-    unsigned int last = waypoints.size() - 2;
-    for (unsigned int i = 1; i <= last; ++i)
+    if (waypoints.cols() < 3)
     {
-        planning_interface::MotionPlanRequest req;
-        planning_interface::MotionPlanResponse res;
+        ROS_ERROR("The initial path has no segment to plan");
+        return 0;
+    }
 
-        for (unsigned int j = 0; j < waypoints[i].rows(); ++j)
-        {
-            double cur_pos = waypoints[i](j);
-            double next_pos = waypoints[i + 1](j);
-            while (next_pos - cur_pos > M_PI + 0.1)
-                next_pos -= 2 * M_PI;
-            while (next_pos - cur_pos < -M_PI - 0.1)
-                next_pos += 2 * M_PI;
-            waypoints[i + 1](j) = next_pos;
-        }
+    // the segments between consecutive waypoints are planned concurrently, one planner instance per worker
+    std::vector<segment_planner::Segment> segments;
+    segment_planner::createSegments(segments, rs, hierarchy, waypoints, 1, waypoints.cols() - 1);
 
-        for (unsigned int j = i; j <= i + 1; ++j)
-        {
-            moveit_msgs::Constraints constraint;
-            setRootJointConstraint(constraint, hierarchy, waypoints[j]);
-            req.trajectory_constraints.constraints.push_back(constraint);
-        }
-        setRobotStateFrom(robot_states[0], hierarchy, waypoints, i);
-        setRobotStateFrom(robot_states[1], hierarchy, waypoints, i + 1);        
+    int num_segment_planners;
+    node_handle.param("num_segment_planners", num_segment_planners,
+                      (int)std::min<std::size_t>(segments.size(), std::max(1u, boost::thread::hardware_concurrency())));
+    planner_instances.resize(std::max(1, num_segment_planners));
+    planner_instances[0] = planner_instance;
+    for (unsigned int i = 1; i < planner_instances.size(); ++i)
+        createPlannerInstance(planner_plugin_loader, planner_instances[i], node_handle, robot_model);
 
-        displayStates(robot_states[0], robot_states[1], node_handle, robot_model);
-        doPlan("whole_body", req, res, robot_states[0], robot_states[1], planning_scene, planner_instance);
+    displayStates(*segments.front().start_state_, *segments.back().goal_state_, node_handle, robot_model);
+    if (!segment_planner::planSegments(segments, "whole_body", planning_scene, planner_instances))
+    {
+        ROS_ERROR("Could not compute plan successfully");
+        return 0;
+    }
 
-        if (i == last)
-        {
-            for (int j = 0; j < 10; ++j)
-                res.trajectory_->addSuffixWayPoint(res.trajectory_->getLastWayPoint(), 5000);
-        }
+    int seam_window;
+    node_handle.param("seam_window", seam_window, 2);
+    if (!segment_planner::repairSeams(segments, std::max(0, seam_window), "whole_body", planning_scene))
+        ROS_WARN("Some seams are kept as planned");
+
+    robot_trajectory::RobotTrajectoryPtr last_trajectory = segments.back().res_.trajectory_;
+    for (int j = 0; j < 10; ++j)
+        last_trajectory->addSuffixWayPoint(last_trajectory->getLastWayPoint(), 5000);
+
+    // the segments are written to the BVH file (and the binary motion file if given) as they are converted
+    std::string motion_file;
+    node_handle.param<std::string>("motion_file", motion_file, "");
+    boost::scoped_ptr<bvh_writer::BVHWriter> writer;
 
+    moveit_msgs::DisplayTrajectory display_trajectory;
+    for (unsigned int i = 0; i < segments.size(); ++i)
+    {
         moveit_msgs::MotionPlanResponse response;
-        res.getMessage(response);
+        segments[i].res_.getMessage(response);
 
         if (i == 0)
+        {
             display_trajectory.trajectory_start = response.trajectory_start;
 
+            writer.reset(new bvh_writer::BVHWriter(robot_model, response.trajectory.joint_trajectory.joint_names));
+            writer->open("walking_optimized.bvh", motion_file);
+        }
+        writer->writeTrajectory(response.trajectory.joint_trajectory);
+
         display_trajectory.trajectory.push_back(response.trajectory);
     }
-
+    writer->close();
 
     ROS_INFO("Visualizing the trajectory");
     static ros::Publisher display_publisher = node_handle.advertise<moveit_msgs::DisplayTrajectory>("/move_group/display_planned_path", 1, true);
@@ -126,7 +137,5 @@ int main(int argc, char **argv)
 
 	ROS_INFO("Done");
 
-    bvh_writer::writeWalkingTrajectoryBVHFile(robot_model, display_trajectory, "walking_optimized.bvh");
-
 	return 0;
 }
@@ -1,63 +1,180 @@
+
 #include <move_itomp/bvh_writer.h>
 
 #include <string>
-#include <fstream>
+#include <map>
+#include <cstring>
+#include <stdint.h>
+#include <ros/ros.h>
 
 
 namespace bvh_writer
 {
 
-void writeWalkingTrajectoryBVHFile(const robot_model::RobotModelPtr robot_model, const moveit_msgs::DisplayTrajectory& display_trajectory, const std::string& filename)
+namespace
 {
-    std::ofstream out (filename.c_str());
+
+const double FRAME_TIME = 0.0333333;
+const size_t BUFFER_CAPACITY = 1 << 20;
+// a frame value is at most 24 characters with the %g format
+const size_t MAX_VALUE_LENGTH = 32;
+
+const char MOTION_FILE_MAGIC[8] = { 'I', 'T', 'O', 'M', 'P', 'M', 'O', 'T' };
+const uint32_t MOTION_FILE_VERSION = 1;
+// file position of the frame count in the binary motion file header
+const long MOTION_FILE_FRAME_COUNT_POSITION = 16;
+
+}
+
+BVHWriter::BVHWriter(const robot_model::RobotModelConstPtr& robot_model, const std::vector<std::string>& joint_names)
+    : num_trajectory_joints_(joint_names.size()), file_(NULL), binary_file_(NULL), frame_count_position_(0), num_frames_(0),
+      buffer_(BUFFER_CAPACITY), buffer_size_(0)
+{
+    std::map<std::string, int> joint_name_indices;
+    for (int l = 0; l < joint_names.size(); ++l)
+        joint_name_indices.insert(std::make_pair(joint_names[l], l));
 
     const std::vector<std::string>& model_joint_names = robot_model->getJointModelNames();
-    const std::vector<std::string>& joint_names = display_trajectory.trajectory[0].joint_trajectory.joint_names;
+    for (int k = 1; k < model_joint_names.size(); ++k)
+    {
+        if (model_joint_names[k].find("_endeffector_") != std::string::npos ||
+            model_joint_names[k].find("_cp_") != std::string::npos)
+            continue;
 
+        std::map<std::string, int>::const_iterator it = joint_name_indices.find(model_joint_names[k]);
+        channel_joint_indices_.push_back(it == joint_name_indices.end() ? -1 : it->second);
 
-    out << "MOTION" << std::endl;
+        // radian to degree for angles (k=0: virtual joint, k=1~3: base prismatic joints)
+        channel_scales_.push_back(k >= 4 ? 180.0 / M_PI : 1.0);
+    }
+    frame_.resize(channel_joint_indices_.size());
+}
 
-    int num_frames = 0;
-    for (int i=0; i < display_trajectory.trajectory.size(); ++i)
-        num_frames += display_trajectory.trajectory[i].joint_trajectory.points.size();
-    out << "Frames: " << num_frames << std::endl;
+BVHWriter::~BVHWriter()
+{
+    close();
+}
 
-    out << "Frame Time: 0.0333333" << std::endl;
+bool BVHWriter::open(const std::string& filename, const std::string& binary_filename)
+{
+    close();
 
-    for (int i=0; i < display_trajectory.trajectory.size(); ++i)
+    file_ = fopen(filename.c_str(), "wb");
+    if (file_ == NULL)
+    {
+        ROS_ERROR("Can not open BVH file %s", filename.c_str());
+        return false;
+    }
+
+    // the frame count is padded, it is overwritten in close()
+    fprintf(file_, "MOTION\nFrames: ");
+    frame_count_position_ = ftell(file_);
+    fprintf(file_, "%-10d\nFrame Time: %g\n", 0, FRAME_TIME);
+
+    if (!binary_filename.empty())
     {
-        for (int j=0; j < display_trajectory.trajectory[i].joint_trajectory.points.size(); ++j)
+        binary_file_ = fopen(binary_filename.c_str(), "wb");
+        if (binary_file_ == NULL)
+            ROS_ERROR("Can not open motion file %s", binary_filename.c_str());
+        else
         {
-            for (int k=1; k < model_joint_names.size(); ++k)
-            {
-                if (model_joint_names[k].find("_endeffector_") != std::string::npos ||
-                    model_joint_names[k].find("_cp_") != std::string::npos)
-                    continue;
+            uint32_t num_channels = channel_joint_indices_.size();
+            uint32_t num_frames = 0;
+            double frame_time = FRAME_TIME;
+            fwrite(MOTION_FILE_MAGIC, 1, sizeof(MOTION_FILE_MAGIC), binary_file_);
+            fwrite(&MOTION_FILE_VERSION, sizeof(uint32_t), 1, binary_file_);
+            fwrite(&num_channels, sizeof(uint32_t), 1, binary_file_);
+            fwrite(&num_frames, sizeof(uint32_t), 1, binary_file_);
+            fwrite(&frame_time, sizeof(double), 1, binary_file_);
+        }
+    }
+
+    num_frames_ = 0;
+    buffer_size_ = 0;
+
+    return true;
+}
+
+void BVHWriter::writeTrajectory(const trajectory_msgs::JointTrajectory& joint_trajectory)
+{
+    if (file_ == NULL)
+        return;
 
-                double value = 0.0;
+    if (joint_trajectory.joint_names.size() != num_trajectory_joints_)
+    {
+        ROS_ERROR("BVH writer : trajectory has %d joints, %d expected", (int)joint_trajectory.joint_names.size(), num_trajectory_joints_);
+        return;
+    }
 
-                for (int l=0; l < joint_names.size(); ++l)
-                {
-                    if (model_joint_names[k] == joint_names[l])
-                    {
-                        value = display_trajectory.trajectory[i].joint_trajectory.points[j].positions[l];
+    for (int j = 0; j < joint_trajectory.points.size(); ++j)
+        writeFrame(joint_trajectory.points[j].positions);
+}
 
-                        // radian to degree for angles (k=0: virtual joint, k=1~3: base prismatic joints)
-                        if (k >= 4)
-                            value *= 180.0 / M_PI;
+void BVHWriter::writeFrame(const std::vector<double>& positions)
+{
+    for (int c = 0; c < channel_joint_indices_.size(); ++c)
+    {
+        int index = channel_joint_indices_[c];
+        frame_[c] = (index < 0) ? 0.0 : positions[index] * channel_scales_[c];
+    }
 
-                        break;
-                    }
-                }
+    if (buffer_size_ + frame_.size() * MAX_VALUE_LENGTH + 1 > buffer_.size())
+        flush();
+    if (frame_.size() * MAX_VALUE_LENGTH + 1 > buffer_.size())
+        buffer_.resize(frame_.size() * MAX_VALUE_LENGTH + 1);
 
-                out << value << ' ';
-            }
+    char* buffer = &buffer_[0];
+    for (int c = 0; c < frame_.size(); ++c)
+        buffer_size_ += sprintf(buffer + buffer_size_, "%g ", frame_[c]);
+    buffer[buffer_size_++] = '\n';
 
-            out << std::endl;
-        }
+    if (binary_file_ != NULL && !frame_.empty())
+        fwrite(&frame_[0], sizeof(double), frame_.size(), binary_file_);
+
+    ++num_frames_;
+}
+
+void BVHWriter::flush()
+{
+    if (buffer_size_ != 0)
+        fwrite(&buffer_[0], 1, buffer_size_, file_);
+    buffer_size_ = 0;
+}
+
+void BVHWriter::close()
+{
+    if (file_ != NULL)
+    {
+        flush();
+        fseek(file_, frame_count_position_, SEEK_SET);
+        fprintf(file_, "%-10d", num_frames_);
+        fclose(file_);
+        file_ = NULL;
     }
 
-    out.close();
+    if (binary_file_ != NULL)
+    {
+        uint32_t num_frames = num_frames_;
+        fseek(binary_file_, MOTION_FILE_FRAME_COUNT_POSITION, SEEK_SET);
+        fwrite(&num_frames, sizeof(uint32_t), 1, binary_file_);
+        fclose(binary_file_);
+        binary_file_ = NULL;
+    }
+}
+
+void writeWalkingTrajectoryBVHFile(const robot_model::RobotModelPtr robot_model, const moveit_msgs::DisplayTrajectory& display_trajectory, const std::string& filename)
+{
+    if (display_trajectory.trajectory.empty())
+        return;
+
+    BVHWriter writer(robot_model, display_trajectory.trajectory[0].joint_trajectory.joint_names);
+    if (!writer.open(filename))
+        return;
+
+    for (int i=0; i < display_trajectory.trajectory.size(); ++i)
+        writer.writeTrajectory(display_trajectory.trajectory[i].joint_trajectory);
+
+    writer.close();
 }
 
 }
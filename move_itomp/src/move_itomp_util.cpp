@@ -12,10 +12,6 @@ void initializePlanner(boost::scoped_ptr<pluginlib::ClassLoader<planning_interfa
                        ros::NodeHandle& node_handle,
                        robot_model::RobotModelPtr& robot_model)
 {
-    std::string planner_plugin_name;
-
-    if (!node_handle.getParam("planning_plugin", planner_plugin_name))
-        ROS_FATAL_STREAM("Could not find planner plugin name");
     try
     {
         planner_plugin_loader.reset(new pluginlib::ClassLoader<planning_interface::PlannerManager>("moveit_core", "planning_interface::PlannerManager"));
@@ -24,6 +20,18 @@ void initializePlanner(boost::scoped_ptr<pluginlib::ClassLoader<planning_interfa
     {
         ROS_FATAL_STREAM("Exception while creating planning plugin loader " << ex.what());
     }
+    createPlannerInstance(planner_plugin_loader, planner_instance, node_handle, robot_model);
+}
+
+void createPlannerInstance(boost::scoped_ptr<pluginlib::ClassLoader<planning_interface::PlannerManager> >& planner_plugin_loader,
+                           planning_interface::PlannerManagerPtr& planner_instance,
+                           ros::NodeHandle& node_handle,
+                           robot_model::RobotModelPtr& robot_model)
+{
+    std::string planner_plugin_name;
+
+    if (!node_handle.getParam("planning_plugin", planner_plugin_name))
+        ROS_FATAL_STREAM("Could not find planner plugin name");
     try
     {
         cpu_set_t mask;
@@ -113,6 +121,18 @@ void doPlan(const std::string& group_name,
             robot_state::RobotState& goal_state,
             planning_scene::PlanningScenePtr& planning_scene,
             planning_interface::PlannerManagerPtr& planner_instance)
+{
+    if (!plan(group_name, req, res, start_state, goal_state, planning_scene, planner_instance))
+        exit(0);
+}
+
+bool plan(const std::string& group_name,
+          planning_interface::MotionPlanRequest& req,
+          planning_interface::MotionPlanResponse& res,
+          const robot_state::RobotState& start_state,
+          const robot_state::RobotState& goal_state,
+          const planning_scene::PlanningSceneConstPtr& planning_scene,
+          planning_interface::PlannerManagerPtr& planner_instance)
 {
     const robot_state::JointModelGroup* joint_model_group = goal_state.getJointModelGroup("whole_body");
 
@@ -132,8 +152,9 @@ void doPlan(const std::string& group_name,
     if (res.error_code_.val != res.error_code_.SUCCESS)
     {
         ROS_ERROR("Could not compute plan successfully");
-        exit(0);
+        return false;
     }
+    return true;
 }
 
 void visualizeResult(planning_interface::MotionPlanResponse& res, ros::NodeHandle& node_handle, int repeat_last, double sleep_time)
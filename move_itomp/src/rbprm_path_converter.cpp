@@ -0,0 +1,29 @@
+#include <move_itomp/rbprm_reader.h>
+#include <move_itomp/rbprm_path_file.h>
+
+// converts a text path file (.prm/.path) to the binary path file format
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage : %s input_path_file output_path_file\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Eigen::VectorXd> waypoints;
+    std::vector<Eigen::MatrixXd> contactPoints;
+    std::vector<std::string> hierarchy = rbprm_reader::InitTrajectoryFromFile(waypoints, contactPoints, argv[1]);
+    if (hierarchy.empty() || waypoints.empty())
+    {
+        printf("No path in %s\n", argv[1]);
+        return 1;
+    }
+
+    if (!rbprm_reader::writePathFile(argv[2], hierarchy, waypoints, contactPoints))
+        return 1;
+
+    printf("Converted %d frames of %d joints, %d effectors\n", (int)waypoints.size(), (int)hierarchy.size(),
+           contactPoints.empty() ? 0 : (int)contactPoints[0].rows());
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <move_itomp/rbprm_path_file.h>
+#include <ros/ros.h>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace rbprm_reader
+{
+
+namespace
+{
+
+const char PATH_FILE_MAGIC[8] = { 'R', 'B', 'P', 'R', 'M', 'P', 'T', 'H' };
+const uint32_t PATH_FILE_VERSION = 1;
+
+uint64_t alignTo8(uint64_t size)
+{
+    return (size + 7) & ~(uint64_t)7;
+}
+
+}
+
+PathFile::PathFile()
+    : data_(NULL), size_(0), header_(NULL), frames_(NULL), contacts_(NULL)
+{
+}
+
+PathFile::~PathFile()
+{
+    close();
+}
+
+bool PathFile::isPathFile(const std::string& filepath)
+{
+    char magic[8];
+    std::ifstream file(filepath.c_str(), std::ios::binary);
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, PATH_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool PathFile::open(const std::string& filepath)
+{
+    close();
+
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        ROS_ERROR("Can not open path file %s", filepath.c_str());
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(PathFileHeader))
+    {
+        ROS_ERROR("Invalid path file %s", filepath.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    size_ = file_stat.st_size;
+    data_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED)
+    {
+        ROS_ERROR("Can not map path file %s", filepath.c_str());
+        data_ = NULL;
+        size_ = 0;
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data_);
+    const PathFileHeader* header = reinterpret_cast<const PathFileHeader*>(bytes);
+
+    // the offsets are ordered and within the file before the sections are compared with the space between them.
+    // offset + size could wrap around for a crafted header, and so could the section sizes in bytes
+    uint64_t num_frame_values = (uint64_t)header->num_frames_ * header->num_joints_;
+    uint64_t num_contact_values = (uint64_t)header->num_frames_ * header->num_effectors_;
+    if (std::memcmp(header->magic_, PATH_FILE_MAGIC, sizeof(PATH_FILE_MAGIC)) != 0 ||
+            header->version_ != PATH_FILE_VERSION || header->file_size_ != size_ ||
+            header->joint_names_offset_ > header->frames_offset_ ||
+            header->frames_offset_ > header->contacts_offset_ || header->contacts_offset_ > size_ ||
+            header->frames_offset_ % sizeof(double) != 0 || header->contacts_offset_ % sizeof(double) != 0 ||
+            num_frame_values > (header->contacts_offset_ - header->frames_offset_) / sizeof(double) ||
+            num_contact_values > (size_ - header->contacts_offset_) / (8 * sizeof(double)))
+    {
+        ROS_ERROR("Invalid path file %s", filepath.c_str());
+        close();
+        return false;
+    }
+
+    // joint name table
+    const char* name = bytes + header->joint_names_offset_;
+    const char* names_end = bytes + header->frames_offset_;
+    hierarchy_.reserve(header->num_joints_);
+    for (unsigned int i = 0; i < header->num_joints_; ++i)
+    {
+        const char* end = static_cast<const char*>(std::memchr(name, '\0', names_end - name));
+        if (end == NULL)
+        {
+            ROS_ERROR("Invalid joint names in path file %s", filepath.c_str());
+            close();
+            return false;
+        }
+        hierarchy_.push_back(std::string(name, end));
+        name = end + 1;
+    }
+
+    header_ = header;
+    frames_ = reinterpret_cast<const double*>(bytes + header->frames_offset_);
+    contacts_ = reinterpret_cast<const double*>(bytes + header->contacts_offset_);
+
+    return true;
+}
+
+void PathFile::close()
+{
+    if (data_ != NULL)
+        munmap(data_, size_);
+    data_ = NULL;
+    size_ = 0;
+    header_ = NULL;
+    frames_ = NULL;
+    contacts_ = NULL;
+    hierarchy_.clear();
+}
+
+bool writePathFile(const std::string& filepath,
+                   const std::vector<std::string>& hierarchy,
+                   const std::vector<Eigen::VectorXd>& waypoints,
+                   const std::vector<Eigen::MatrixXd>& contactPoints)
+{
+    unsigned int num_joints = hierarchy.size();
+    unsigned int num_frames = waypoints.size();
+    unsigned int num_effectors = contactPoints.empty() ? 0 : contactPoints[0].rows();
+
+    for (unsigned int i = 0; i < num_frames; ++i)
+    {
+        if (waypoints[i].rows() != num_joints)
+        {
+            ROS_ERROR("Waypoint %d has %d values for %d joints", i, (int)waypoints[i].rows(), num_joints);
+            return false;
+        }
+    }
+    if (num_effectors != 0)
+    {
+        if (contactPoints.size() != num_frames)
+        {
+            ROS_ERROR("Not same number of contacts and frames");
+            return false;
+        }
+        for (unsigned int i = 0; i < num_frames; ++i)
+        {
+            if (contactPoints[i].rows() != num_effectors || contactPoints[i].cols() != 8)
+            {
+                ROS_ERROR("Invalid contacts in frame %d", i);
+                return false;
+            }
+        }
+    }
+
+    uint64_t joint_names_size = 0;
+    for (unsigned int i = 0; i < num_joints; ++i)
+        joint_names_size += hierarchy[i].size() + 1;
+
+    PathFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, PATH_FILE_MAGIC, sizeof(PATH_FILE_MAGIC));
+    header.version_ = PATH_FILE_VERSION;
+    header.num_joints_ = num_joints;
+    header.num_frames_ = num_frames;
+    header.num_effectors_ = num_effectors;
+    header.joint_names_offset_ = alignTo8(sizeof(PathFileHeader));
+    header.frames_offset_ = alignTo8(header.joint_names_offset_ + joint_names_size);
+    header.contacts_offset_ = header.frames_offset_ + (uint64_t)num_frames * num_joints * sizeof(double);
+    header.file_size_ = header.contacts_offset_ + (uint64_t)num_frames * num_effectors * 8 * sizeof(double);
+
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        ROS_ERROR("Can not write path file %s", filepath.c_str());
+        return false;
+    }
+
+    const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.joint_names_offset_ - sizeof(header));
+    for (unsigned int i = 0; i < num_joints; ++i)
+        file.write(hierarchy[i].c_str(), hierarchy[i].size() + 1);
+    file.write(padding, header.frames_offset_ - header.joint_names_offset_ - joint_names_size);
+
+    for (unsigned int i = 0; i < num_frames; ++i)
+        file.write(reinterpret_cast<const char*>(waypoints[i].data()), num_joints * sizeof(double));
+
+    // contacts are stored row-major
+    Eigen::Matrix<double, Eigen::Dynamic, 8, Eigen::RowMajor> contacts(num_effectors, 8);
+    for (unsigned int i = 0; i < num_frames && num_effectors != 0; ++i)
+    {
+        contacts = contactPoints[i];
+        file.write(reinterpret_cast<const char*>(contacts.data()), num_effectors * 8 * sizeof(double));
+    }
+
+    return file.good();
+}
+
+}
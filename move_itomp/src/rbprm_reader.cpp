@@ -1,4 +1,5 @@
 #include <move_itomp/rbprm_reader.h>
+#include <move_itomp/rbprm_path_file.h>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -15,9 +16,29 @@ namespace rbprm_reader
 // "X Y Z Rx Ry Rz J1 J2... Jn" one line per state
 // "CONTACT EFFECTORS N"  N is the number of effectors
 // "hasContact X Y Z qx qy qz qw" hasContact 0 or 1, times number effectors one line per state
+// binary path files written by rbprm_path_converter are also accepted
 std::vector<std::string> InitTrajectoryFromFile(std::vector<Eigen::VectorXd>& waypoints, std::vector<Eigen::MatrixXd>& contactPoints, const std::string& filepath)
 {
     std::vector<std::string> res;
+    if (PathFile::isPathFile(filepath))
+    {
+        PathFile path_file;
+        if (path_file.open(filepath))
+        {
+            waypoints.reserve(waypoints.size() + path_file.getNumFrames());
+            for (unsigned int i = 0; i < path_file.getNumFrames(); ++i)
+                waypoints.push_back(path_file.getWaypoint(i));
+            if (path_file.getNumEffectors() != 0)
+            {
+                contactPoints.reserve(contactPoints.size() + path_file.getNumFrames());
+                for (unsigned int i = 0; i < path_file.getNumFrames(); ++i)
+                    contactPoints.push_back(path_file.getContacts(i));
+            }
+            res = path_file.getHierarchy();
+        }
+        return res;
+    }
+
     bool hierarchy = false;
     bool motion = false;
     bool contacts = false;
@@ -51,6 +72,15 @@ std::vector<std::string> InitTrajectoryFromFile(std::vector<Eigen::VectorXd>& wa
             {
                 hierarchy = false;
             }
+            else if(line.find("Frames:") != std::string::npos)
+            {
+                int nbFrames = atoi(line.substr(7).c_str());
+                if (nbFrames > 0)
+                {
+                    waypoints.reserve(waypoints.size() + nbFrames);
+                    contactPoints.reserve(contactPoints.size() + nbFrames);
+                }
+            }
             else if(line.find("Frame Time") != std::string::npos)
             {
                 motion = true;
@@ -125,16 +155,40 @@ std::vector<std::string> InitTrajectoryFromFile(std::vector<Eigen::VectorXd>& wa
     return res;
 }
 
-void displayInitialWaypoints(robot_state::RobotState& state,
-                             ros::NodeHandle& node_handle,
-                             robot_model::RobotModelPtr& robot_model,
-                             const std::vector<std::string>& hierarchy,
-                             const std::vector<Eigen::VectorXd>& waypoints)
+PathFile::WaypointMatrixMap InitWaypointsFromFile(PathFile& path_file, Eigen::MatrixXd& text_waypoints,
+                                                  std::vector<std::string>& hierarchy, const std::string& filepath)
+{
+    if (PathFile::isPathFile(filepath))
+    {
+        hierarchy.clear();
+        if (!path_file.open(filepath))
+            return PathFile::WaypointMatrixMap(NULL, 0, 0);
+        hierarchy = path_file.getHierarchy();
+        return path_file.getWaypoints();
+    }
+
+    std::vector<Eigen::VectorXd> waypoints;
+    std::vector<Eigen::MatrixXd> contactPoints;
+    hierarchy = InitTrajectoryFromFile(waypoints, contactPoints, filepath);
+    text_waypoints.resize(hierarchy.size(), waypoints.size());
+    for (unsigned int i = 0; i < waypoints.size(); ++i)
+        text_waypoints.col(i) = waypoints[i];
+    return PathFile::WaypointMatrixMap(text_waypoints.data(), text_waypoints.rows(), text_waypoints.cols());
+}
+
+namespace
+{
+
+void displayInitialWaypoint(robot_state::RobotState& state,
+                            ros::NodeHandle& node_handle,
+                            const std::vector<std::string>& link_names,
+                            const std::vector<std::string>& hierarchy,
+                            const Eigen::VectorXd& waypoint,
+                            unsigned int point)
 {
     static ros::Publisher vis_marker_array_publisher = node_handle.advertise<visualization_msgs::MarkerArray>("/move_itomp/visualization_marker_array", 10);
 
     visualization_msgs::MarkerArray ma;
-    std::vector<std::string> link_names = robot_model->getLinkModelNames();
     std_msgs::ColorRGBA color;
     color.a = 0.5;
     color.r = 1.0;
@@ -144,21 +198,44 @@ void displayInitialWaypoints(robot_state::RobotState& state,
     //ros::Duration dur(3600.0);
     ros::Duration dur(0.25);
 
-    for (unsigned int point = 0; point < waypoints.size(); ++point)
-    {
-        ma.markers.clear();
+    setRobotStateFrom(state, hierarchy, waypoint);
+
 
-        setRobotStateFrom(state, hierarchy, waypoints, point);
+    double time = 0.05;
+    ros::WallDuration timer(time);
+    timer.sleep();
 
 
-        double time = 0.05;
-        ros::WallDuration timer(time);
-        timer.sleep();
+    std::string ns = "init_" + boost::lexical_cast<std::string>(point);
+    state.getRobotMarkers(ma, link_names, color, ns, dur);
+    vis_marker_array_publisher.publish(ma);
+}
 
+}
+
+void displayInitialWaypoints(robot_state::RobotState& state,
+                             ros::NodeHandle& node_handle,
+                             robot_model::RobotModelPtr& robot_model,
+                             const std::vector<std::string>& hierarchy,
+                             const std::vector<Eigen::VectorXd>& waypoints)
+{
+    std::vector<std::string> link_names = robot_model->getLinkModelNames();
+    for (unsigned int point = 0; point < waypoints.size(); ++point)
+        displayInitialWaypoint(state, node_handle, link_names, hierarchy, waypoints[point], point);
+}
 
-        std::string ns = "init_" + boost::lexical_cast<std::string>(point);
-        state.getRobotMarkers(ma, link_names, color, ns, dur);
-        vis_marker_array_publisher.publish(ma);
+void displayInitialWaypoints(robot_state::RobotState& state,
+                             ros::NodeHandle& node_handle,
+                             robot_model::RobotModelPtr& robot_model,
+                             const std::vector<std::string>& hierarchy,
+                             const PathFile::WaypointMatrixMap& waypoints)
+{
+    std::vector<std::string> link_names = robot_model->getLinkModelNames();
+    Eigen::VectorXd waypoint(waypoints.rows());
+    for (unsigned int point = 0; point < waypoints.cols(); ++point)
+    {
+        waypoint = waypoints.col(point);
+        displayInitialWaypoint(state, node_handle, link_names, hierarchy, waypoint, point);
     }
 }
 
@@ -227,6 +304,13 @@ void setRobotStateFrom(robot_state::RobotState& state,
                        const std::vector<std::string>& hierarchy,
                        const std::vector<Eigen::VectorXd>& waypoints,
                        int index)
+{
+    setRobotStateFrom(state, hierarchy, waypoints[index]);
+}
+
+void setRobotStateFrom(robot_state::RobotState& state,
+                       const std::vector<std::string>& hierarchy,
+                       const Eigen::VectorXd& waypoint)
 {
     std::map<std::string, double> values;
     double jointValue = 0.0;
@@ -238,7 +322,7 @@ void setRobotStateFrom(robot_state::RobotState& state,
     int id = 0;
     for(std::vector<std::string>::const_iterator cit = hierarchy.begin(); cit != hierarchy.end(); ++cit, ++id)
     {
-        jointValue = waypoints[index](id);
+        jointValue = waypoint(id);
         state.setJointPositions(*cit, &jointValue);
     }
 }
@@ -0,0 +1,317 @@
+#include <move_itomp/segment_planner.h>
+#include <move_itomp/rbprm_reader.h>
+#include <moveit/robot_model/revolute_joint_model.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <omp.h>
+
+namespace segment_planner
+{
+
+namespace
+{
+
+// hands out the segments to the worker threads
+class SegmentQueue
+{
+public:
+    SegmentQueue(unsigned int num_segments)
+        : num_segments_(num_segments), next_segment_(0), failed_(false)
+    {
+    }
+
+    bool pop(unsigned int& segment_index)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (failed_ || next_segment_ >= num_segments_)
+            return false;
+        segment_index = next_segment_++;
+        return true;
+    }
+
+    void setFailed()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        failed_ = true;
+    }
+
+    bool hasFailed() const
+    {
+        return failed_;
+    }
+
+private:
+    boost::mutex mutex_;
+    unsigned int num_segments_;
+    unsigned int next_segment_;
+    bool failed_;
+};
+
+void planSegmentsThread(std::vector<Segment>& segments, SegmentQueue& queue,
+                        const std::string& group_name,
+                        const planning_scene::PlanningSceneConstPtr& planning_scene,
+                        planning_interface::PlannerManagerPtr planner_instance,
+                        int num_omp_threads)
+{
+    // the optimizer of a segment uses its share of the processors
+    omp_set_num_threads(num_omp_threads);
+
+    unsigned int segment_index;
+    while (queue.pop(segment_index))
+    {
+        Segment& segment = segments[segment_index];
+
+        ros::WallTime start_time = ros::WallTime::now();
+        if (!move_itomp_util::plan(group_name, segment.req_, segment.res_, *segment.start_state_, *segment.goal_state_,
+                                   planning_scene, planner_instance))
+        {
+            ROS_ERROR("Planning of segment %d failed", segment_index);
+            queue.setFailed();
+        }
+        else
+            ROS_INFO("Segment %d planned in %f sec", segment_index, (ros::WallTime::now() - start_time).toSec());
+    }
+}
+
+// minimum jerk trajectory from (p0, v0, a0) at t = 0 to (p1, v1, a1) at t = duration
+class QuinticPolynomial
+{
+public:
+    QuinticPolynomial(double p0, double v0, double a0, double p1, double v1, double a1, double duration)
+    {
+        double t = duration;
+        double t2 = t * t;
+        double t3 = t2 * t;
+        c_[0] = p0;
+        c_[1] = v0;
+        c_[2] = 0.5 * a0;
+        c_[3] = (20.0 * (p1 - p0) - (8.0 * v1 + 12.0 * v0) * t - (3.0 * a0 - a1) * t2) / (2.0 * t3);
+        c_[4] = (30.0 * (p0 - p1) + (14.0 * v1 + 16.0 * v0) * t + (3.0 * a0 - 2.0 * a1) * t2) / (2.0 * t3 * t);
+        c_[5] = (12.0 * (p1 - p0) - 6.0 * (v1 + v0) * t - (a0 - a1) * t2) / (2.0 * t3 * t2);
+    }
+
+    double getPosition(double t) const
+    {
+        return c_[0] + t * (c_[1] + t * (c_[2] + t * (c_[3] + t * (c_[4] + t * c_[5]))));
+    }
+
+    double getVelocity(double t) const
+    {
+        return c_[1] + t * (2.0 * c_[2] + t * (3.0 * c_[3] + t * (4.0 * c_[4] + t * 5.0 * c_[5])));
+    }
+
+private:
+    double c_[6];
+};
+
+bool isContinuousVariable(const robot_model::RobotModelConstPtr& robot_model, int variable_index)
+{
+    const robot_model::JointModel* joint_model = robot_model->getJointOfVariable(variable_index);
+    return joint_model->getType() == robot_model::JointModel::REVOLUTE &&
+           static_cast<const robot_model::RevoluteJointModel*>(joint_model)->isContinuous();
+}
+
+// angles of continuous joints are taken closest to the reference value
+double getVariablePosition(const robot_state::RobotState& state, int variable_index, bool continuous, double reference)
+{
+    double value = state.getVariablePosition(variable_index);
+    if (continuous)
+    {
+        while (value - reference > M_PI)
+            value -= 2 * M_PI;
+        while (value - reference < -M_PI)
+            value += 2 * M_PI;
+    }
+    return value;
+}
+
+bool isStateValid(const robot_state::RobotState& state, const std::string& group_name,
+                  const planning_scene::PlanningSceneConstPtr& planning_scene)
+{
+    return state.satisfiesBounds() && !planning_scene->isStateColliding(state, group_name);
+}
+
+}
+
+void createSegments(std::vector<Segment>& segments,
+                    const robot_state::RobotState& default_state,
+                    const std::vector<std::string>& hierarchy,
+                    const rbprm_reader::PathFile::WaypointMatrixMap& waypoints,
+                    unsigned int first, unsigned int last)
+{
+    segments.clear();
+    segments.resize(last - first);
+
+    // unwrapped waypoints at the ends of the current segment
+    Eigen::VectorXd cur_waypoint = waypoints.col(first);
+    Eigen::VectorXd next_waypoint(waypoints.rows());
+    for (unsigned int i = first; i < last; ++i)
+    {
+        Segment& segment = segments[i - first];
+
+        next_waypoint = waypoints.col(i + 1);
+        for (unsigned int j = 0; j < next_waypoint.rows(); ++j)
+        {
+            double cur_pos = cur_waypoint(j);
+            double next_pos = next_waypoint(j);
+            while (next_pos - cur_pos > M_PI + 0.1)
+                next_pos -= 2 * M_PI;
+            while (next_pos - cur_pos < -M_PI - 0.1)
+                next_pos += 2 * M_PI;
+            next_waypoint(j) = next_pos;
+        }
+
+        const Eigen::VectorXd* segment_waypoints[2] = { &cur_waypoint, &next_waypoint };
+        for (unsigned int j = 0; j < 2; ++j)
+        {
+            moveit_msgs::Constraints constraint;
+            rbprm_reader::setRootJointConstraint(constraint, hierarchy, *segment_waypoints[j]);
+            segment.req_.trajectory_constraints.constraints.push_back(constraint);
+        }
+
+        segment.start_state_.reset(new robot_state::RobotState(default_state));
+        rbprm_reader::setRobotStateFrom(*segment.start_state_, hierarchy, cur_waypoint);
+        segment.goal_state_.reset(new robot_state::RobotState(default_state));
+        rbprm_reader::setRobotStateFrom(*segment.goal_state_, hierarchy, next_waypoint);
+
+        cur_waypoint.swap(next_waypoint);
+    }
+}
+
+bool planSegments(std::vector<Segment>& segments,
+                  const std::string& group_name,
+                  const planning_scene::PlanningSceneConstPtr& planning_scene,
+                  std::vector<planning_interface::PlannerManagerPtr>& planner_instances)
+{
+    int num_threads = std::min(planner_instances.size(), segments.size());
+    int num_omp_threads = std::max(1, omp_get_num_procs() / std::max(1, num_threads));
+    ROS_INFO("Planning %d segments with %d planners", (int)segments.size(), num_threads);
+
+    // the planner reads its parameters when a request starts
+    ros::NodeHandle itomp_node_handle("itomp_planner");
+    int warm_start_cache_size;
+    itomp_node_handle.param("warm_start_cache_size", warm_start_cache_size, 0);
+    itomp_node_handle.setParam("warm_start_cache_size", 0);
+
+    SegmentQueue queue(segments.size());
+    boost::thread_group threads;
+    for (int i = 0; i < num_threads; ++i)
+        threads.create_thread(boost::bind(&planSegmentsThread, boost::ref(segments), boost::ref(queue),
+                                          boost::cref(group_name), boost::cref(planning_scene),
+                                          planner_instances[i], num_omp_threads));
+    threads.join_all();
+
+    itomp_node_handle.setParam("warm_start_cache_size", warm_start_cache_size);
+
+    return !queue.hasFailed();
+}
+
+bool repairSeams(std::vector<Segment>& segments, unsigned int seam_window,
+                 const std::string& group_name,
+                 const planning_scene::PlanningSceneConstPtr& planning_scene)
+{
+    bool repaired = true;
+    for (unsigned int s = 0; s + 1 < segments.size(); ++s)
+    {
+        robot_trajectory::RobotTrajectory& trajectory_a = *segments[s].res_.trajectory_;
+        robot_trajectory::RobotTrajectory& trajectory_b = *segments[s + 1].res_.trajectory_;
+        int num_a = trajectory_a.getWayPointCount();
+        int num_b = trajectory_b.getWayPointCount();
+
+        // window : [begin, num_a - 1] of a and [0, end] of b. a[num_a - 1] and b[0] are the same waypoint.
+        // the derivatives at the window ends use two more waypoints outside of the window
+        int window = std::min<int>(seam_window, std::min(num_a - 3, num_b - 3));
+        if (window < 1)
+            continue;
+        int begin = num_a - 1 - window;
+        int end = window;
+
+        double dt_a0 = trajectory_a.getWayPointDurationFromPrevious(begin - 1);
+        double dt_a1 = trajectory_a.getWayPointDurationFromPrevious(begin);
+        double dt_b1 = trajectory_b.getWayPointDurationFromPrevious(end + 1);
+        double dt_b2 = trajectory_b.getWayPointDurationFromPrevious(end + 2);
+
+        // times of the window waypoints from a[begin]
+        std::vector<double> times_a(num_a, 0.0);
+        std::vector<double> times_b(end + 1, 0.0);
+        for (int i = begin + 1; i < num_a; ++i)
+            times_a[i] = times_a[i - 1] + trajectory_a.getWayPointDurationFromPrevious(i);
+        times_b[0] = times_a[num_a - 1];
+        for (int i = 1; i <= end; ++i)
+            times_b[i] = times_b[i - 1] + trajectory_b.getWayPointDurationFromPrevious(i);
+        double duration = times_b[end];
+
+        if (dt_a0 <= 0.0 || dt_a1 <= 0.0 || dt_b1 <= 0.0 || dt_b2 <= 0.0 || duration <= 0.0)
+        {
+            ROS_WARN("Seam %d is not repaired : zero waypoint durations", s);
+            continue;
+        }
+
+        // the planned waypoints of the window are restored if the refit is invalid
+        std::vector<robot_state::RobotStatePtr> window_states;
+        for (int i = begin + 1; i < num_a; ++i)
+            window_states.push_back(trajectory_a.getWayPointPtr(i));
+        for (int i = 0; i < end; ++i)
+            window_states.push_back(trajectory_b.getWayPointPtr(i));
+        std::vector<robot_state::RobotState> planned_states;
+        std::vector<bool> planned_valid;
+        for (unsigned int i = 0; i < window_states.size(); ++i)
+        {
+            planned_states.push_back(*window_states[i]);
+            planned_valid.push_back(isStateValid(*window_states[i], group_name, planning_scene));
+        }
+
+        const robot_model::RobotModelConstPtr& robot_model = trajectory_a.getRobotModel();
+        for (int v = 0; v < robot_model->getVariableCount(); ++v)
+        {
+            bool continuous = isContinuousVariable(robot_model, v);
+
+            double p0 = trajectory_a.getWayPoint(begin).getVariablePosition(v);
+            double p_prev = getVariablePosition(trajectory_a.getWayPoint(begin - 1), v, continuous, p0);
+            double p_prev2 = getVariablePosition(trajectory_a.getWayPoint(begin - 2), v, continuous, p_prev);
+            double v0 = (p0 - p_prev) / dt_a1;
+            double a0 = (v0 - (p_prev - p_prev2) / dt_a0) / dt_a1;
+
+            double p1 = getVariablePosition(trajectory_b.getWayPoint(end), v, continuous, p0);
+            double p_next = getVariablePosition(trajectory_b.getWayPoint(end + 1), v, continuous, p1);
+            double p_next2 = getVariablePosition(trajectory_b.getWayPoint(end + 2), v, continuous, p_next);
+            double v1 = (p_next - p1) / dt_b1;
+            double a1 = ((p_next2 - p_next) / dt_b2 - v1) / dt_b1;
+
+            QuinticPolynomial polynomial(p0, v0, a0, p1, v1, a1, duration);
+            for (int i = begin + 1; i < num_a; ++i)
+            {
+                robot_state::RobotStatePtr state = trajectory_a.getWayPointPtr(i);
+                state->setVariablePosition(v, polynomial.getPosition(times_a[i]));
+                if (state->hasVelocities())
+                    state->setVariableVelocity(v, polynomial.getVelocity(times_a[i]));
+            }
+            for (int i = 0; i < end; ++i)
+            {
+                robot_state::RobotStatePtr state = trajectory_b.getWayPointPtr(i);
+                state->setVariablePosition(v, polynomial.getPosition(times_b[i]));
+                if (state->hasVelocities())
+                    state->setVariableVelocity(v, polynomial.getVelocity(times_b[i]));
+            }
+        }
+
+        bool valid = true;
+        for (unsigned int i = 0; i < window_states.size(); ++i)
+        {
+            window_states[i]->update();
+            if (planned_valid[i] && !isStateValid(*window_states[i], group_name, planning_scene))
+                valid = false;
+        }
+        if (!valid)
+        {
+            ROS_WARN("Seam %d is not repaired : the refit waypoints collide or exceed the joint limits", s);
+            for (unsigned int i = 0; i < window_states.size(); ++i)
+                *window_states[i] = planned_states[i];
+            repaired = false;
+        }
+    }
+
+    return repaired;
+}
+
+}